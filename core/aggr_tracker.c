@@ -0,0 +1,114 @@
+#include "aggr_tracker.h"
+
+void aggr_tracker_init(struct aggr_tracker *t)
+{
+    int i, b;
+
+    t->ema = 0;
+    t->alpha = 0.1;
+    t->num_pending = 0;
+    for(i = 0; i < MAX_PARTITION; i++){
+        t->start_time[i] = -1;
+        t->part_ema[i] = 0;
+        t->part_cnt[i] = 0;
+        for(b = 0; b < AGGR_HIST_BUCKETS; b++)
+            t->hist[i][b] = 0;
+    }
+}
+
+// Aggregation of partition p starts on the host (last edge block of column p done on this CSD)
+void aggr_tracker_start(struct aggr_tracker *t, int p)
+{
+    if(p < 0 || p >= MAX_PARTITION)
+        return;
+    if(t->start_time[p] == -1)
+        t->pending[t->num_pending++] = p;
+    t->start_time[p] = ktime_get_ns();
+}
+
+static int aggr_hist_bucket(long long latency)
+{
+    int b = 0;
+    while(latency > 1 && b < AGGR_HIST_BUCKETS - 1){
+        latency >>= 1;
+        b++;
+    }
+    return b;
+}
+
+// Only the watch list is checked, each completion is recorded once
+int aggr_tracker_poll(struct aggr_tracker *t, unsigned long* aggregated, int csd_id)
+{
+    int i = 0, cnt = 0;
+
+    while(i < t->num_pending){
+        int p = t->pending[i];
+        long long latency;
+
+        if(!test_bit(p, aggregated)){
+            i++;
+            continue;
+        }
+        latency = ktime_get_ns() - t->start_time[p];
+        t->ema = (long long) ((t->alpha * latency) + (1.0 - t->alpha) * t->ema);
+        if(t->part_cnt[p] == 0)
+            t->part_ema[p] = latency;
+        else
+            t->part_ema[p] = (long long) ((t->alpha * latency) + (1.0 - t->alpha) * t->part_ema[p]);
+        t->part_cnt[p]++;
+        t->hist[p][aggr_hist_bucket(latency)]++;
+
+        t->start_time[p] = -1;
+        t->pending[i] = t->pending[--t->num_pending];
+        cnt++;
+        printk(KERN_INFO "CSD %d, Partition %d, Aggregation time: %lld ns, EMA: %lld ns, Partition EMA: %lld ns",
+            csd_id, p, latency, t->ema, t->part_ema[p]);
+    }
+    return cnt;
+}
+
+// Predicted aggregation latency of partition p, the global EMA until p has a sample
+long long aggr_tracker_predict(struct aggr_tracker *t, int p)
+{
+    if(p >= 0 && p < MAX_PARTITION && t->part_cnt[p] > 0)
+        return t->part_ema[p];
+    return t->ema;
+}
+
+// Whether the started aggregation of partition p is expected to end before the deadline
+bool aggr_tracker_done_before(struct aggr_tracker *t, int p, long long deadline)
+{
+    long long predicted;
+
+    if(p < 0 || p >= MAX_PARTITION || t->start_time[p] == -1)
+        return false;
+    predicted = aggr_tracker_predict(t, p);
+    if(predicted <= 0)
+        return false;
+    return deadline > t->start_time[p] + predicted;
+}
+
+// Upper bound of the pct-th percentile bucket, p = -1 for all partitions
+long long aggr_tracker_percentile(struct aggr_tracker *t, int p, int pct)
+{
+    long long counts[AGGR_HIST_BUCKETS] = {0};
+    long long total = 0, acc = 0;
+    int i, b;
+
+    for(i = 0; i < MAX_PARTITION; i++){
+        if(p != -1 && i != p)
+            continue;
+        for(b = 0; b < AGGR_HIST_BUCKETS; b++){
+            counts[b] += t->hist[i][b];
+            total += t->hist[i][b];
+        }
+    }
+    if(total == 0)
+        return 0;
+    for(b = 0; b < AGGR_HIST_BUCKETS; b++){
+        acc += counts[b];
+        if(acc * 100 >= total * pct)
+            return 1LL << (b + 1);
+    }
+    return 1LL << AGGR_HIST_BUCKETS;
+}
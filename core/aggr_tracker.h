@@ -0,0 +1,38 @@
+#ifndef AGGR_TRACKER_H
+#define AGGR_TRACKER_H
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include "params.h"
+
+// log2(ns) buckets, up to ~1100 seconds
+#define AGGR_HIST_BUCKETS 40
+
+// Host aggregation latency, per partition (column)
+struct aggr_tracker {
+    // Global EMA over all partitions
+    long long ema;
+    float alpha;
+
+    // Watch list: partitions whose aggregation started and is not seen completed yet
+    long long start_time[MAX_PARTITION];
+    int pending[MAX_PARTITION];
+    int num_pending;
+
+    // Per-partition EMA and latency histogram
+    long long part_ema[MAX_PARTITION];
+    long long part_cnt[MAX_PARTITION];
+    unsigned int hist[MAX_PARTITION][AGGR_HIST_BUCKETS];
+};
+
+void aggr_tracker_init(struct aggr_tracker *t);
+
+void aggr_tracker_start(struct aggr_tracker *t, int p);
+int aggr_tracker_poll(struct aggr_tracker *t, unsigned long* aggregated, int csd_id);
+
+long long aggr_tracker_predict(struct aggr_tracker *t, int p);
+bool aggr_tracker_done_before(struct aggr_tracker *t, int p, long long deadline);
+long long aggr_tracker_percentile(struct aggr_tracker *t, int p, int pct);
+
+#endif // AGGR_TRACKER_H
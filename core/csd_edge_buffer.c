@@ -22,11 +22,7 @@ void edge_buffer_init(struct edge_buffer *buf)
         buf->prefetch_block_hit_cnt_arr[i] = 0;
     }
 
-    buf->ema_aggr = 0;
-    buf->alpha_aggr = 0.1;
-    for(i = 0; i < MAX_PARTITION; i++){
-        buf->aggr_start_time[i] = -1;
-    }
+    aggr_tracker_init(&buf->aggr);
     buf->pr_reverse = false;
 
     printk(KERN_INFO "Edge buffer size: %lld", buf->capacity);
@@ -63,11 +59,7 @@ void edge_buffer_destroy(struct edge_buffer *buf)
         buf->prefetch_block_hit_cnt_arr[i] = 0;
     }
 
-    buf->ema_aggr = 0;
-    buf->alpha_aggr = 0.1;
-    for(i = 0; i < MAX_PARTITION; i++){
-        buf->aggr_start_time[i] = -1;
-    }
+    aggr_tracker_init(&buf->aggr);
     buf->pr_reverse = false;
 
     // Todo: execution time composition to a new header file
@@ -76,7 +68,7 @@ void edge_buffer_destroy(struct edge_buffer *buf)
     INIT_LIST_HEAD(&buf->head);
 }
 
-long long access_edge_block(struct edge_buffer *buf, bool* aggregated, int r, int c, long long size, int is_prefetch)
+long long access_edge_block(struct edge_buffer *buf, unsigned long* aggregated, int r, int c, long long size, int is_prefetch)
 {
     long long curr_size;
     if(size == 0)
@@ -135,7 +127,7 @@ long long access_edge_block(struct edge_buffer *buf, bool* aggregated, int r, in
     }
 }
 
-long long evict_edge_block(struct edge_buffer *buf, bool* aggregated, struct edge_buffer_unit* inserted_unit, int is_prefetch) 
+long long evict_edge_block(struct edge_buffer *buf, unsigned long* aggregated, struct edge_buffer_unit* inserted_unit, int is_prefetch) 
 {
     struct edge_buffer_unit *unit;
     long long size = inserted_unit->size;
@@ -155,7 +147,7 @@ long long evict_edge_block(struct edge_buffer *buf, bool* aggregated, struct edg
                     evict_unit = unit;
                 }
                 // Early stop if we find a unit that is not aggregated or normal task
-                // if(!aggregated[unit->r] || unit->r.is_prefetched_normal){
+                // if(!test_bit(unit->r, aggregated) || unit->r.is_prefetched_normal){
                 //     break;
                 // }
             }
@@ -233,7 +225,7 @@ long long get_edge_block_size(struct edge_buffer *buf, int r, int c)
     return -1;      // Not found
 }
 
-bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, bool* aggregated){
+bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, unsigned long* aggregated){
     // Check if unit < evict_unit, evict unit is earlier in the list
 
     // 1. LIFO for prefetched normal (2 for next iteration, lowest priority)
@@ -243,9 +235,9 @@ bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, b
         return false;
 
     // 2. FIFO for unexecutable future edges (since we process latest future that the row is ready)
-    if(evict_unit->is_prefetched_normal == 0 && !aggregated[evict_unit->r])
+    if(evict_unit->is_prefetched_normal == 0 && !test_bit(evict_unit->r, aggregated))
         return false;
-    if(unit->is_prefetched_normal == 0 && !aggregated[unit->r])
+    if(unit->is_prefetched_normal == 0 && !test_bit(unit->r, aggregated))
         return true; 
     
     // 3. LIFO for prefetched normal
@@ -258,7 +250,7 @@ bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, b
     return false;   
 }
 
-bool lower_reverse(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, bool* aggregated){
+bool lower_reverse(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, unsigned long* aggregated){
     // Check if unit < evict_unit, evict unit is earlier in the list
 
     // 1. LIFO for prefetched normal (2 for next iteration, lowest priority)
@@ -274,9 +266,9 @@ bool lower_reverse(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict
         return false;
     
     // 2. FIFO for unexecutable future edges (since we process latest future that the row is ready)
-    if(evict_unit->is_prefetched_normal == 0 && !aggregated[evict_unit->r])
+    if(evict_unit->is_prefetched_normal == 0 && !test_bit(evict_unit->r, aggregated))
         return false;
-    if(unit->is_prefetched_normal == 0 && !aggregated[unit->r])
+    if(unit->is_prefetched_normal == 0 && !test_bit(unit->r, aggregated))
         return true; 
 
     // 4. FIFO for executable future edges (since we process latest future that the row is ready)
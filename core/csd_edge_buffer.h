@@ -7,6 +7,7 @@
 #include <linux/kernel.h>
 #include <linux/string.h>
 #include "params.h"
+#include "aggr_tracker.h"
 
 struct edge_buffer_unit {
     long long size;
@@ -33,9 +34,7 @@ struct edge_buffer {
     long long prefetch_block_cnt_arr[7], prefetch_block_hit_cnt_arr[7];
 
     // For cost modeling
-    long long ema_aggr;
-    float alpha_aggr; 
-    long long aggr_start_time[MAX_PARTITION];
+    struct aggr_tracker aggr;
     bool pr_reverse;
 
     // Todo: execution time composition to a new header file
@@ -50,14 +49,14 @@ extern unsigned long edge_buffer_size;
 void edge_buffer_init(struct edge_buffer *buf);
 void edge_buffer_destroy(struct edge_buffer *buf);
 
-long long access_edge_block(struct edge_buffer *buf, bool* aggregated, int r, int c, long long size, int is_prefetch);
-long long evict_edge_block(struct edge_buffer *buf, bool* aggregated, struct edge_buffer_unit* inserted_unit, int is_prefetch);
+long long access_edge_block(struct edge_buffer *buf, unsigned long* aggregated, int r, int c, long long size, int is_prefetch);
+long long evict_edge_block(struct edge_buffer *buf, unsigned long* aggregated, struct edge_buffer_unit* inserted_unit, int is_prefetch);
 void invalidate_edge_block(struct edge_buffer *buf, int r, int c);
 void invalidate_edge_block_fifo(struct edge_buffer *buf);
 long long get_edge_block_size(struct edge_buffer *buf, int r, int c);
-bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, bool* aggregated);
+bool lower(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, unsigned long* aggregated);
 
 // For cost modeling
-bool lower_reverse(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, bool* aggregated);
+bool lower_reverse(struct edge_buffer_unit *unit, struct edge_buffer_unit *evict_unit, unsigned long* aggregated);
 
 #endif
\ No newline at end of file
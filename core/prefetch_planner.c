@@ -0,0 +1,348 @@
+#include "prefetch_planner.h"
+
+void prefetch_planner_init(struct prefetch_planner *planner)
+{
+    int i;
+
+    planner->lookahead = clamp(prefetch_lookahead, 1, PREFETCH_MAX_LOOKAHEAD);
+    planner->budget = prefetch_budget;
+    planner->bytes_left = 0;
+    planner->num_cand = 0;
+    planner->num_issued = 0;
+    for(i = 0; i < PREFETCH_NUM_PRIORITIES; i++){
+        planner->issued_cnt[i] = 0;
+        planner->used_cnt[i] = 0;
+        planner->wasted_cnt[i] = 0;
+    }
+
+    printk(KERN_INFO "Prefetch lookahead: %d, budget: %lld", planner->lookahead, planner->budget);
+}
+
+void prefetch_planner_destroy(struct prefetch_planner *planner)
+{
+    prefetch_planner_init(planner);
+}
+
+static void prefetch_planner_issue(struct prefetch_planner *planner, struct edge_buffer *edge_buf, struct PROC_EDGE task, int priority)
+{
+    int i;
+
+    // Forget the issued candidates that were evicted before use
+    for(i = 0; i < planner->num_issued; ){
+        struct prefetch_candidate *issued = &planner->issued[i];
+        if(issued->task.r == task.r && issued->task.c == task.c)
+            return;
+        if(get_edge_block_size(edge_buf, issued->task.r, issued->task.c) == -1){
+            planner->wasted_cnt[issued->priority]++;
+            *issued = planner->issued[--planner->num_issued];
+            continue;
+        }
+        i++;
+    }
+    if(planner->num_issued == PREFETCH_MAX_CANDIDATES){
+        planner->wasted_cnt[planner->issued[0].priority]++;
+        planner->issued[0] = planner->issued[--planner->num_issued];
+    }
+    planner->issued[planner->num_issued].task = task;
+    planner->issued[planner->num_issued].priority = priority;
+    planner->num_issued++;
+    planner->issued_cnt[priority]++;
+}
+
+void prefetch_planner_on_task(struct prefetch_planner *planner, struct edge_buffer *edge_buf, struct PROC_EDGE task)
+{
+    int i;
+
+    if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c){
+        edge_buf->prefetch_block_hit_cnt++;
+        if(edge_buf->prefetched_priority != -1){
+            edge_buf->prefetch_block_hit_cnt_arr[edge_buf->prefetched_priority]++;
+        }
+    }
+    if(edge_buf->prefetched_r != -1 && edge_buf->prefetched_c != -1)
+        edge_buf->total_prefetch_block_cnt++;
+
+    // Per-candidate accuracy
+    for(i = 0; i < planner->num_issued; i++){
+        if(planner->issued[i].task.r == task.r && planner->issued[i].task.c == task.c){
+            planner->used_cnt[planner->issued[i].priority]++;
+            planner->issued[i] = planner->issued[--planner->num_issued];
+            break;
+        }
+    }
+}
+
+static long long prefetch_edge_block(struct prefetch_planner *planner, struct edge_buffer *edge_buf, unsigned long* aggregated,
+    struct PROC_EDGE task_prefetch, long long* edge_proc_time, int is_prefetch, int priority)
+{
+    long long size_in_cache, size_in_cache_new, size_in_cache_old;
+    long long edge_io_time;
+    double ratio;
+
+    if(task_prefetch.edge_block_len == 0 || *edge_proc_time <= 0 || planner->bytes_left <= 0)
+        return 0;
+
+    size_in_cache = get_edge_block_size(edge_buf, task_prefetch.r, task_prefetch.c);
+    if(size_in_cache == task_prefetch.edge_block_len)
+        return 0;
+    if(size_in_cache == -1)
+        size_in_cache = 0;
+
+    edge_io_time = task_prefetch.nsecs_target;
+    ratio = 1.0 * (*edge_proc_time) / edge_io_time;
+    if(ratio > 1.0) ratio = 1.0;
+    // Internal bandwidth budget of the current task
+    if(ratio > 1.0 * planner->bytes_left / task_prefetch.edge_block_len)
+        ratio = 1.0 * planner->bytes_left / task_prefetch.edge_block_len;
+
+    *edge_proc_time -= (long long) (edge_io_time * (1.0 * (task_prefetch.edge_block_len - size_in_cache) / task_prefetch.edge_block_len));
+
+    size_in_cache_old = size_in_cache;
+    size_in_cache = min(size_in_cache + (long long) (task_prefetch.edge_block_len * ratio), (long long)(task_prefetch.edge_block_len));
+    access_edge_block(edge_buf, aggregated, task_prefetch.r, task_prefetch.c, size_in_cache, is_prefetch);
+
+    size_in_cache_new = get_edge_block_size(edge_buf, task_prefetch.r, task_prefetch.c);
+    if(size_in_cache_new == -1)
+        size_in_cache_new = 0;
+    planner->bytes_left -= max(0LL, size_in_cache_new - size_in_cache_old);
+    edge_buf->prefetched_size = max(0, (size_in_cache_new - size_in_cache_old)) / PAGE_SIZE;
+    if(edge_buf->prefetched_size > 0)
+        prefetch_planner_issue(planner, edge_buf, task_prefetch, priority);
+    return edge_buf->prefetched_size;
+}
+
+// The first prefetched block is tracked for the prefetch accuracy stats
+static void prefetch_mark_first(struct edge_buffer *edge_buf, struct PROC_EDGE next_task, int priority, int *found_cnt)
+{
+    if(*found_cnt == 0){
+        edge_buf->prefetched_r = next_task.r;
+        edge_buf->prefetched_c = next_task.c;
+        edge_buf->prefetched_iter = next_task.iter;
+        edge_buf->prefetch_block_cnt_arr[priority]++;
+        edge_buf->prefetched_priority = priority;
+    }
+    (*found_cnt)++;
+}
+
+// Fixed priority ladder (lookahead 1): one candidate per priority class, greedy on the remaining time
+static void prefetch_ladder(struct prefetch_planner *planner, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated,
+    struct PROC_EDGE task, double ratio, long long *tmp_edge_proc_time)
+{
+    struct PROC_EDGE next_task;
+    int found_cnt = 0;
+
+    if(get_queue_size(future_task_queue))
+    {
+        // Executable future tasks
+        struct queue_node *node;
+        list_for_each_entry_reverse(node, &future_task_queue->head, list) {
+            if (test_bit(node->proc_edge_struct.r, aggregated)) {
+                next_task = node->proc_edge_struct;
+                edge_buf->prefetch_priority_cnt[2] += prefetch_edge_block(planner, edge_buf, aggregated, next_task, tmp_edge_proc_time, 1, 2);
+                prefetch_mark_first(edge_buf, next_task, 2, &found_cnt);
+                if(*tmp_edge_proc_time <= 0)
+                    break;
+            }
+        }
+    }
+    if(*tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
+    {
+        bool pr_reverse = false;
+        if(get_queue_size(future_task_queue)){
+            get_queue_front(normal_task_queue, &next_task);
+            // Already calculated edge_proc_time (passed)
+            if(!test_bit(next_task.r, aggregated)){
+                if(aggr_tracker_done_before(&edge_buf->aggr, next_task.r, ktime_get_ns() + (long long) (task.nsecs_target * ratio)))
+                {
+                    // Priority 4 > 3
+                    pr_reverse = true;
+                    edge_buf->pr_reverse = true;
+                }
+            }
+        }
+        if(!pr_reverse){
+            // Normal tasks
+            get_queue_front(normal_task_queue, &next_task);
+
+            if(!(task.is_fvc && !next_task.is_fvc)){
+                edge_buf->prefetch_priority_cnt[3] += prefetch_edge_block(planner, edge_buf, aggregated, next_task, tmp_edge_proc_time, 2, 3);
+                prefetch_mark_first(edge_buf, next_task, 3, &found_cnt);
+            }
+        }
+    }
+    if(*tmp_edge_proc_time > 0 && get_queue_size(future_task_queue))
+    {
+        // Unexecutable future tasks
+        get_queue_front(future_task_queue, &next_task);
+        edge_buf->prefetch_priority_cnt[4] += prefetch_edge_block(planner, edge_buf, aggregated, next_task, tmp_edge_proc_time, 1, 4);
+        prefetch_mark_first(edge_buf, next_task, 4, &found_cnt);
+    }
+
+    // Cost Model
+    edge_buf->pr_reverse = false;
+
+    if(*tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
+    {
+        // Next iteration Normal tasks
+        get_queue_front(normal_task_queue, &next_task);
+        if(task.is_fvc && !next_task.is_fvc){
+            edge_buf->prefetch_priority_cnt[5] += prefetch_edge_block(planner, edge_buf, aggregated, next_task, tmp_edge_proc_time, 3, 5);
+            prefetch_mark_first(edge_buf, next_task, 5, &found_cnt);
+        }
+    }
+}
+
+static void prefetch_add_candidate(struct prefetch_planner *planner, struct PROC_EDGE next_task, int priority, int is_prefetch, int distance)
+{
+    struct prefetch_candidate *cand;
+
+    if(planner->num_cand == PREFETCH_MAX_CANDIDATES || next_task.edge_block_len == 0)
+        return;
+    cand = &planner->cand[planner->num_cand++];
+    cand->task = next_task;
+    cand->priority = priority;
+    cand->is_prefetch = is_prefetch;
+    cand->distance = distance;
+}
+
+// Lookahead K: rank up to K candidates per class across both queues by expected benefit
+static void prefetch_lookahead_plan(struct prefetch_planner *planner, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated,
+    struct PROC_EDGE task, double ratio, long long *tmp_edge_proc_time)
+{
+    struct queue_node *node;
+    long long now = ktime_get_ns(), free_size, planned_size = 0;
+    int K = planner->lookahead;
+    int num_exec = 0, i, j, found_cnt = 0;
+
+    planner->num_cand = 0;
+
+    // Executable future tasks, latest first (same as the future task selection)
+    mutex_lock(&future_task_queue->lock);
+    list_for_each_entry_reverse(node, &future_task_queue->head, list) {
+        if(num_exec == K)
+            break;
+        if(test_bit(node->proc_edge_struct.r, aggregated)){
+            prefetch_add_candidate(planner, node->proc_edge_struct, 2, 1, num_exec);
+            num_exec++;
+        }
+    }
+    mutex_unlock(&future_task_queue->lock);
+
+    // Normal tasks in order, the next iteration ones are used after the whole lookahead window
+    i = 0;
+    mutex_lock(&normal_task_queue->lock);
+    list_for_each_entry(node, &normal_task_queue->head, list) {
+        if(i == K)
+            break;
+        if(task.is_fvc && !node->proc_edge_struct.is_fvc)
+            prefetch_add_candidate(planner, node->proc_edge_struct, 5, 3, num_exec + K + i);
+        else
+            prefetch_add_candidate(planner, node->proc_edge_struct, 3, 2, num_exec + i);
+        i++;
+    }
+    mutex_unlock(&normal_task_queue->lock);
+
+    // Unexecutable future tasks, early if the aggregation is expected to end within the current task
+    i = 0;
+    mutex_lock(&future_task_queue->lock);
+    list_for_each_entry(node, &future_task_queue->head, list) {
+        int r = node->proc_edge_struct.r;
+        bool soon;
+        if(i == K)
+            break;
+        if(test_bit(r, aggregated))
+            continue;
+        soon = aggr_tracker_done_before(&edge_buf->aggr, r, now + (long long) (task.nsecs_target * ratio));
+        prefetch_add_candidate(planner, node->proc_edge_struct, 4, 1, soon ? num_exec + i : num_exec + K + i);
+        i++;
+    }
+    mutex_unlock(&future_task_queue->lock);
+
+    // Benefit: missing bytes, discounted by time-to-use and by the eviction risk
+    free_size = max(0LL, edge_buf->capacity - edge_buf->size);
+    for(i = 0; i < planner->num_cand; i++){
+        struct prefetch_candidate *cand = &planner->cand[i];
+        long long in_cache = get_edge_block_size(edge_buf, cand->task.r, cand->task.c);
+        long long risk = 0;
+
+        if(in_cache == -1)
+            in_cache = 0;
+        cand->missing = cand->task.edge_block_len - in_cache;
+        if(cand->missing > free_size && edge_buf->capacity > 0)
+            risk = min(1000LL, (cand->missing - free_size) * 1000 / edge_buf->capacity);
+        cand->benefit = max(0LL, cand->missing) * (1000 - risk) / 1000 / (1 + cand->distance);
+    }
+
+    // Insertion sort, the candidate list is short
+    for(i = 1; i < planner->num_cand; i++){
+        struct prefetch_candidate key = planner->cand[i];
+        for(j = i - 1; j >= 0 && planner->cand[j].benefit < key.benefit; j--)
+            planner->cand[j + 1] = planner->cand[j];
+        planner->cand[j + 1] = key;
+    }
+
+    for(i = 0; i < planner->num_cand; i++){
+        struct prefetch_candidate *cand = &planner->cand[i];
+        if(*tmp_edge_proc_time <= 0 || planner->bytes_left <= 0)
+            break;
+        if(cand->missing <= 0)
+            continue;
+        // Do not prefetch more than the buffer holds, it would evict the earlier candidates
+        if(planned_size + cand->missing > edge_buf->capacity)
+            continue;
+        planned_size += cand->missing;
+        edge_buf->prefetch_priority_cnt[cand->priority] += prefetch_edge_block(planner, edge_buf, aggregated,
+            cand->task, tmp_edge_proc_time, cand->is_prefetch, cand->priority);
+        prefetch_mark_first(edge_buf, cand->task, cand->priority, &found_cnt);
+    }
+}
+
+double prefetch_planner_run(struct prefetch_planner *planner, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated,
+    struct PROC_EDGE task, long long edge_proc_time, long long size_not_in_cache, double ratio)
+{
+    double pipeline_ratio, prefetch_ratio;
+
+    // Prefetch current edge block (Pipelining)
+    if(task.is_prefetching < 1)
+        return ratio;
+
+    if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c)
+        edge_buf->prefetch_hit_cnt += edge_buf->prefetched_size;
+    edge_buf->total_prefetch_cnt += edge_buf->prefetched_size;
+    edge_buf->prefetched_size = 0;
+
+    if(task.nsecs_target == 0)
+        pipeline_ratio = 0;
+    else
+        pipeline_ratio = 1.0 * edge_proc_time / task.nsecs_target;
+
+    prefetch_ratio = pipeline_ratio - ratio;
+    if(prefetch_ratio < 0) prefetch_ratio = 0;
+
+    // edge_processing_time * ratio is the time that we can prefetch the current edge block
+    edge_buf->hit_cnt += min((long long) (pipeline_ratio * ratio * task.edge_block_len), size_not_in_cache) / PAGE_SIZE;
+    ratio -= pipeline_ratio;
+    if(ratio < 0) ratio = 0;
+
+    // If the remaining edge_proc_time is not zero, we can prefetch the next edge blocks
+    if(task.is_prefetching >= 2)
+    {
+        long long tmp_edge_proc_time = (long long) (prefetch_ratio * task.nsecs_target);
+
+        edge_buf->prefetched_r = -1;
+        edge_buf->prefetched_c = -1;
+        edge_buf->prefetched_iter = -1;
+        planner->bytes_left = planner->budget > 0 ? planner->budget : LLONG_MAX;
+
+        if(tmp_edge_proc_time > 0){
+            if(planner->lookahead <= 1)
+                prefetch_ladder(planner, edge_buf, normal_task_queue, future_task_queue, aggregated, task, ratio, &tmp_edge_proc_time);
+            else
+                prefetch_lookahead_plan(planner, edge_buf, normal_task_queue, future_task_queue, aggregated, task, ratio, &tmp_edge_proc_time);
+        }
+    }
+    return ratio;
+}
@@ -0,0 +1,56 @@
+#ifndef PREFETCH_PLANNER_H
+#define PREFETCH_PLANNER_H
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+#include "proc_edge_struct.h"
+#include "queue.h"
+#include "csd_edge_buffer.h"
+#include "params.h"
+
+#define PREFETCH_MAX_LOOKAHEAD 16
+#define PREFETCH_NUM_PRIORITIES 7
+// Priority 2: executable future, 3: normal, 4: unexecutable future, 5: next iteration normal
+#define PREFETCH_MAX_CANDIDATES (PREFETCH_MAX_LOOKAHEAD * 4)
+
+struct prefetch_candidate {
+    struct PROC_EDGE task;
+    int priority;
+    int is_prefetch;        // access_edge_block() prefetch type
+    int distance;           // Expected number of tasks before the candidate is used
+    long long missing;      // Bytes not in the edge buffer
+    long long benefit;
+};
+
+struct prefetch_planner {
+    // Lookahead depth (candidates per priority class) and per-task internal bandwidth budget
+    int lookahead;
+    long long budget;
+    long long bytes_left;
+
+    struct prefetch_candidate cand[PREFETCH_MAX_CANDIDATES];
+    int num_cand;
+
+    // Prefetched candidates not used yet, for per-candidate accuracy
+    struct prefetch_candidate issued[PREFETCH_MAX_CANDIDATES];
+    int num_issued;
+    long long issued_cnt[PREFETCH_NUM_PRIORITIES];
+    long long used_cnt[PREFETCH_NUM_PRIORITIES];
+    long long wasted_cnt[PREFETCH_NUM_PRIORITIES];
+};
+
+extern int prefetch_lookahead;
+extern unsigned long prefetch_budget;
+
+void prefetch_planner_init(struct prefetch_planner *planner);
+void prefetch_planner_destroy(struct prefetch_planner *planner);
+
+void prefetch_planner_on_task(struct prefetch_planner *planner, struct edge_buffer *edge_buf, struct PROC_EDGE task);
+double prefetch_planner_run(struct prefetch_planner *planner, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated,
+    struct PROC_EDGE task, long long edge_proc_time, long long size_not_in_cache, double ratio);
+
+#endif // PREFETCH_PLANNER_H
@@ -0,0 +1,168 @@
+#include "prefetch_stream.h"
+
+#define PREFETCH_STREAM_SCAN 8
+
+void prefetch_stream_init(struct prefetch_stream *stream)
+{
+    stream->has_inflight = false;
+    stream->is_prefetch = 0;
+    stream->start_time = stream->busy_until = 0;
+    stream->base_size = stream->committed_size = 0;
+    stream->issued_cnt = stream->completed_cnt = stream->cancelled_cnt = 0;
+    stream->prefetched_bytes = 0;
+
+    printk(KERN_INFO "Background prefetch: %d", background_prefetch);
+}
+
+void prefetch_stream_destroy(struct prefetch_stream *stream)
+{
+    prefetch_stream_init(stream);
+}
+
+static long long cached_size(struct edge_buffer *edge_buf, int r, int c)
+{
+    long long size = get_edge_block_size(edge_buf, r, c);
+    return size == -1 ? 0 : size;
+}
+
+// Write the modeled progress of the in-flight block into the edge buffer
+static void prefetch_stream_commit(struct prefetch_stream *stream, struct edge_buffer *edge_buf, unsigned long* aggregated, long long now, bool force)
+{
+    struct PROC_EDGE *task = &stream->inflight;
+    long long len = task->edge_block_len, size, elapsed, duration;
+
+    duration = stream->busy_until - stream->start_time;
+    elapsed = min(now, stream->busy_until) - stream->start_time;
+    if(duration <= 0)
+        size = len;
+    else
+        size = stream->base_size + (len - stream->base_size) * elapsed / duration;
+    size = min(size, len);
+
+    if(size <= stream->committed_size)
+        return;
+    if(!force && size < len && size - stream->committed_size < PREFETCH_STREAM_CHUNK)
+        return;
+
+    access_edge_block(edge_buf, aggregated, task->r, task->c, size, stream->is_prefetch);
+    size = cached_size(edge_buf, task->r, task->c);
+    stream->prefetched_bytes += max(0LL, size - stream->committed_size);
+    stream->committed_size = size;
+}
+
+static bool prefetch_stream_pick(struct prefetch_stream *stream, struct edge_buffer *edge_buf, struct PROC_EDGE cand, int is_prefetch)
+{
+    long long in_cache, missing;
+
+    if(cand.edge_block_len == 0 || cand.is_prefetching < 2)
+        return false;
+    in_cache = cached_size(edge_buf, cand.r, cand.c);
+    missing = cand.edge_block_len - in_cache;
+    // Never evict for a background prefetch
+    if(missing <= 0 || missing > edge_buf->capacity - edge_buf->size)
+        return false;
+
+    stream->inflight = cand;
+    stream->is_prefetch = is_prefetch;
+    stream->base_size = stream->committed_size = in_cache;
+    return true;
+}
+
+static bool prefetch_stream_next(struct prefetch_stream *stream, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated)
+{
+    struct queue_node *node;
+    bool found = false;
+    int i;
+
+    // Executable future tasks, latest first (same as the future task selection)
+    i = 0;
+    mutex_lock(&future_task_queue->lock);
+    list_for_each_entry_reverse(node, &future_task_queue->head, list) {
+        if(i++ == PREFETCH_STREAM_SCAN)
+            break;
+        if(test_bit(node->proc_edge_struct.r, aggregated) && prefetch_stream_pick(stream, edge_buf, node->proc_edge_struct, 1)){
+            found = true;
+            break;
+        }
+    }
+    mutex_unlock(&future_task_queue->lock);
+    if(found)
+        return true;
+
+    // Normal tasks
+    i = 0;
+    mutex_lock(&normal_task_queue->lock);
+    list_for_each_entry(node, &normal_task_queue->head, list) {
+        if(i++ == PREFETCH_STREAM_SCAN)
+            break;
+        if(prefetch_stream_pick(stream, edge_buf, node->proc_edge_struct, 2)){
+            found = true;
+            break;
+        }
+    }
+    mutex_unlock(&normal_task_queue->lock);
+    if(found)
+        return true;
+
+    // Unexecutable future tasks
+    i = 0;
+    mutex_lock(&future_task_queue->lock);
+    list_for_each_entry(node, &future_task_queue->head, list) {
+        if(i++ == PREFETCH_STREAM_SCAN)
+            break;
+        if(!test_bit(node->proc_edge_struct.r, aggregated) && prefetch_stream_pick(stream, edge_buf, node->proc_edge_struct, 1)){
+            found = true;
+            break;
+        }
+    }
+    mutex_unlock(&future_task_queue->lock);
+    return found;
+}
+
+// Called while the compute thread is blocked or spinning
+void prefetch_stream_advance(struct prefetch_stream *stream, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated)
+{
+    long long now;
+
+    if(!background_prefetch)
+        return;
+
+    now = ktime_get_ns();
+    if(stream->has_inflight){
+        prefetch_stream_commit(stream, edge_buf, aggregated, now, now >= stream->busy_until);
+        if(now < stream->busy_until)
+            return;
+        stream->has_inflight = false;
+        stream->completed_cnt++;
+    }
+
+    if(!prefetch_stream_next(stream, edge_buf, normal_task_queue, future_task_queue, aggregated))
+        return;
+
+    // Modeled internal I/O time of the missing part of the block
+    stream->has_inflight = true;
+    stream->start_time = max(now, stream->busy_until);
+    stream->busy_until = stream->start_time + (long long) (stream->inflight.nsecs_target *
+        (1.0 * (stream->inflight.edge_block_len - stream->base_size) / stream->inflight.edge_block_len));
+    stream->issued_cnt++;
+}
+
+// A demand read takes over the internal I/O: keep the progress so far and stop the stream
+void prefetch_stream_demand(struct prefetch_stream *stream, struct edge_buffer *edge_buf, unsigned long* aggregated, struct PROC_EDGE task)
+{
+    long long now;
+
+    if(!stream->has_inflight)
+        return;
+
+    now = ktime_get_ns();
+    prefetch_stream_commit(stream, edge_buf, aggregated, now, true);
+    if(now >= stream->busy_until)
+        stream->completed_cnt++;
+    else if(!(stream->inflight.r == task.r && stream->inflight.c == task.c))
+        stream->cancelled_cnt++;
+    stream->has_inflight = false;
+    stream->busy_until = now;
+}
@@ -0,0 +1,40 @@
+#ifndef PREFETCH_STREAM_H
+#define PREFETCH_STREAM_H
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+#include "proc_edge_struct.h"
+#include "queue.h"
+#include "csd_edge_buffer.h"
+#include "params.h"
+
+// Progress is committed to the edge buffer in chunks, not on every poll
+#define PREFETCH_STREAM_CHUNK (64 * 1024)
+
+// Background prefetch engine with its own modeled internal I/O timeline.
+// It runs while the compute thread spins on aggregation, and yields to demand reads.
+struct prefetch_stream {
+    bool has_inflight;
+    struct PROC_EDGE inflight;
+    int is_prefetch;                // access_edge_block() prefetch type of the in-flight block
+    long long start_time, busy_until;
+    long long base_size;            // Bytes of the block in the buffer when issued
+    long long committed_size;       // Bytes of the block committed to the buffer so far
+
+    long long issued_cnt, completed_cnt, cancelled_cnt;
+    long long prefetched_bytes;
+};
+
+extern int background_prefetch;
+
+void prefetch_stream_init(struct prefetch_stream *stream);
+void prefetch_stream_destroy(struct prefetch_stream *stream);
+
+void prefetch_stream_advance(struct prefetch_stream *stream, struct edge_buffer *edge_buf,
+    struct queue *normal_task_queue, struct queue *future_task_queue, unsigned long* aggregated);
+void prefetch_stream_demand(struct prefetch_stream *stream, struct edge_buffer *edge_buf, unsigned long* aggregated, struct PROC_EDGE task);
+
+#endif // PREFETCH_STREAM_H
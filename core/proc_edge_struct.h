@@ -2,9 +2,23 @@
 #define PROC_EDGE_H
 
 #include <linux/types.h> // For __u64 and __u32 definitions
+#include "params.h"
 #define SYNC 1
 #define ASYNC 2
 #define FLUSH_CSD_DRAM 3
+#define RUN_PLAN 4
+#define REGISTER_RUN 5      // Static fields of the run, for the inline tasks that follow
+
+// Set in the command flag (apptag) of a task carried in the command dwords, see proc_edge_encode()
+#define PROC_EDGE_INLINE 0x8000
+
+// Layout of the per-CSD partial sums after the V values of buf1/buf2
+#define SUM_LAYOUT_CSD_MAJOR 0      // buf[(csd_id + 1) * V + v]
+#define SUM_LAYOUT_INTERLEAVED 1    // buf[V + v * num_csds + csd_id], a partition's sums are one contiguous stream
+
+// Placement of the edge blocks on the CSDs
+#define BLOCK_PLACEMENT_SPLIT 0     // Every block split evenly across the CSDs
+#define BLOCK_PLACEMENT_OWNED 1     // Every block on one CSD, the others hold an empty block
 
 struct PROC_EDGE 
 {
@@ -26,6 +40,109 @@ struct PROC_EDGE
     __u32 num_vertices;
     __u64 nsecs_target;
 
+    // For RUN_PLAN: byte offset of the edge block table (struct run_plan_entry[P][P])
+    __u64 plan_slba;
+
+    // Chunk of the edge block when blocks are split for load balancing, 0 otherwise
+    __u32 chunk;
+
+    // Partial sum layout, SUM_LAYOUT_*
+    __u32 sum_layout;
+
+    // 1: the owner CSD of each column reduces and applies it, see hmb_column_owner()
+    __u32 reduce_scatter;
+
+    // BLOCK_PLACEMENT_*
+    __u32 block_placement;
+
+    // Block order of the dual queue loops, TRAVERSAL_* in traversal.h
+    __u32 traversal;
+
 } __attribute__((packed));
 
+// Inline task: the per-task fields in the free dwords of the command, cdw2, cdw3 and cdw10-cdw15 (dw[0..7]).
+// The other fields are those of the last REGISTER_RUN (or RUN_PLAN) command of the CSD.
+//   dw[0..1] edge_block_slba, dw[2..3] edge_block_len, dw[4] 0 (NLB of a read/write),
+//   dw[5] r | c << 8 | is_fvc << 16 | is_prefetching << 17 | row_overlap << 19,
+//   dw[6] iter | chunk << 16, dw[7] csd_flag | PROC_EDGE_INLINE (apptag)
+#define PROC_EDGE_INLINE_DWORDS 8
+#define PROC_EDGE_INLINE_MAX_ITER 0xFFFF    // Largest iter and chunk, the host rejects runs beyond them
+#define PROC_EDGE_INLINE_MAX_CHUNK 0xFFFF
+
+_Static_assert(MAX_PARTITION <= 256, "r and c of an inline task are 8 bits");
+
+static inline void proc_edge_encode(const struct PROC_EDGE *task, __u32 csd_flag, __u32 *dw)
+{
+    dw[0] = (__u32)task->edge_block_slba;
+    dw[1] = (__u32)(task->edge_block_slba >> 32);
+    dw[2] = (__u32)task->edge_block_len;
+    dw[3] = (__u32)(task->edge_block_len >> 32);
+    dw[4] = 0;
+    dw[5] = (task->r & 0xFF) | (task->c & 0xFF) << 8 | (task->is_fvc & 1) << 16
+        | (task->is_prefetching & 3) << 17 | (task->row_overlap & 3) << 19;
+    dw[6] = (task->iter & 0xFFFF) | (task->chunk & 0xFFFF) << 16;
+    dw[7] = csd_flag | PROC_EDGE_INLINE;
+}
+
+// Overwrites the per-task fields of task, which holds the registered ones, returns the command flag
+static inline __u32 proc_edge_decode(const __u32 *dw, struct PROC_EDGE *task)
+{
+    task->edge_block_slba = dw[0] | (__u64)dw[1] << 32;
+    task->edge_block_len = dw[2] | (__u64)dw[3] << 32;
+    task->r = dw[5] & 0xFF;
+    task->c = (dw[5] >> 8) & 0xFF;
+    task->is_fvc = (dw[5] >> 16) & 1;
+    task->is_prefetching = (dw[5] >> 17) & 3;
+    task->row_overlap = (dw[5] >> 19) & 3;
+    task->iter = dw[6] & 0xFFFF;
+    task->chunk = dw[6] >> 16;
+    return dw[7] & 0xFFFF & ~PROC_EDGE_INLINE;
+}
+
+// One entry per edge block, stored row-major ([r][c]) at plan_slba in the namespace
+struct run_plan_entry {
+    __u64 slba;
+    __u64 len;
+} __attribute__((packed));
+
+// Partial sum of vertex v from a CSD is at base + v * stride
+static inline __u64 partial_sum_base(__u32 sum_layout, __u64 num_vertices, __u32 csd_id)
+{
+    if(sum_layout == SUM_LAYOUT_INTERLEAVED)
+        return num_vertices + csd_id;
+    return (csd_id + 1) * num_vertices;
+}
+
+static inline __u64 partial_sum_stride(__u32 sum_layout, __u32 num_csds)
+{
+    return sum_layout == SUM_LAYOUT_INTERLEAVED ? num_csds : 1;
+}
+
+// Destination vertices [begin, end) of partition p (LUMOS's get_partition_range in partition.hpp)
+static inline void partition_range(__u64 num_vertices, __u32 num_partitions, __u32 p, __u64 *begin, __u64 *end)
+{
+    const __u64 split_partition = num_vertices % num_partitions;
+    const __u64 partition_size = num_vertices / num_partitions + 1;
+    if(p < split_partition){
+        *begin = p * partition_size;
+        *end = (p + 1) * partition_size;
+    }
+    else{
+        const __u64 split_point = split_partition * partition_size;
+        *begin = split_point + (p - split_partition) * (partition_size - 1);
+        *end = split_point + (p - split_partition + 1) * (partition_size - 1);
+    }
+}
+
+// Partition of vertex v, the inverse of partition_range()
+static inline __u32 partition_of(__u64 num_vertices, __u32 num_partitions, __u64 v)
+{
+    const __u64 split_partition = num_vertices % num_partitions;
+    const __u64 partition_size = num_vertices / num_partitions + 1;
+    const __u64 split_point = split_partition * partition_size;
+    if(v < split_point)
+        return v / partition_size;
+    return split_partition + (v - split_point) / (partition_size - 1);
+}
+
 #endif // PROC_EDGE_H
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "reduce_scatter.h"
+
+#include <linux/kthread.h>
+
+void reduce_scatter_init(struct reduce_scatter *rs)
+{
+    rs->active = false;
+    rs->reduce_time = 0;
+    rs->reduced_cnt = 0;
+    rs->hmb_bytes = 0;
+}
+
+void reduce_scatter_destroy(struct reduce_scatter *rs)
+{
+    reduce_scatter_init(rs);
+}
+
+// Every task of a run carries the mode, the latest one describes the graph
+void reduce_scatter_start(struct reduce_scatter *rs, struct PROC_EDGE task)
+{
+    rs->active = task.reduce_scatter && task.num_csds > 0;
+    rs->tmpl = task;
+}
+
+static inline float *sum_of(struct reduce_scatter *rs, float *buf, int csd_id, u64 v)
+{
+    struct PROC_EDGE *t = &rs->tmpl;
+    return buf + partial_sum_base(t->sum_layout, t->num_vertices, csd_id) + v * partial_sum_stride(t->sum_layout, t->num_csds);
+}
+
+// Same update as the host's conv_partition, on the partition of column c
+static void reduce_column(struct reduce_scatter *rs, float *next, int c)
+{
+    struct PROC_EDGE *t = &rs->tmpl;
+    u64 begin, end, v;
+    long long start_time, end_time;
+    int csd_id;
+
+    partition_range(t->num_vertices, t->num_partitions, c, &begin, &end);
+
+    start_time = ktime_get_ns();
+    if(t->algorithm == 0){
+        // Pagerank
+        for(v = begin; v < end; v++){
+            float acc = next[v];
+            for(csd_id = 0; csd_id < t->num_csds; csd_id++){
+                float *sum = sum_of(rs, next, csd_id, v);
+                acc += *sum;
+                *sum = 0.0f;
+            }
+            next[v] = 0.15f + 0.85f * acc;
+        }
+    }
+    else if(t->algorithm == 1){
+        // Label Propagation
+        int freq_src[2], freq_dst[2];
+        for(v = begin; v < end; v++){
+            for(csd_id = 0; csd_id < t->num_csds; csd_id++){
+                float *sum = sum_of(rs, next, csd_id, v);
+                freq_src[0] = (int)*sum & 0xFFFF;
+                freq_src[1] = ((int)*sum >> 16) & 0xFFFF;
+                freq_dst[0] = (int)next[v] & 0xFFFF;
+                freq_dst[1] = ((int)next[v] >> 16) & 0xFFFF;
+                *sum = 0.0f;
+                next[v] = (float)((freq_dst[0] + freq_src[0]) | ((freq_dst[1] + freq_src[1]) << 16));
+            }
+        }
+    }
+    else{
+        // Dispersion
+        for(v = begin; v < end; v++){
+            for(csd_id = 0; csd_id < t->num_csds; csd_id++){
+                float *sum = sum_of(rs, next, csd_id, v);
+                if(*sum == 1.0f)
+                    next[v] = 1.0f;
+                *sum = 0.0f;
+            }
+        }
+    }
+    end_time = ktime_get_ns();
+
+    // Compensation for MCU lower frequency
+    end_time = end_time + (end_time - start_time) * (CPU_MCU_SPEED_RATIO - 1);
+    while(ktime_get_ns() < end_time){
+        if(kthread_should_stop())
+            break;
+        cpu_relax();
+    }
+
+    rs->reduce_time += end_time - start_time;
+    rs->reduced_cnt++;
+    // Values read and written once, every partial sum read and cleared
+    rs->hmb_bytes += (long long)(end - begin) * (2 + 2 * t->num_csds) * VERTEX_SIZE;
+}
+
+// Reduce the owned columns of v_t+1 that every CSD completed, returns the number reduced
+int reduce_scatter_poll(struct reduce_scatter *rs)
+{
+    struct PROC_EDGE *t = &rs->tmpl;
+    u32 epoch, target, expected;
+    float *next;
+    int c, csd_id, cnt = 0;
+
+    if(!rs->active)
+        return 0;
+
+    // The epoch only moves once every column of its v_t+1 is reduced
+    epoch = hmb_epoch();
+    target = epoch + HMB_ROLE_NEXT;
+    expected = hmb_column_expected(target, t->num_partitions);
+    next = hmb_value_buf(HMB_ROLE_NEXT);
+
+    for(c = 0; c < t->num_partitions; c++){
+        // Indexed by the CSDs the HMB was laid out for, as the host polls it, which may exceed the run's
+        u32 *reduced = &hmb_dev.control.virt_addr[hmb_control_reduced(hmb_dev.layout.num_csds, c)];
+
+        if(hmb_column_owner(c, t->num_csds) != t->csd_id || READ_ONCE(*reduced) >= target)
+            continue;
+        for(csd_id = 0; csd_id < t->num_csds; csd_id++){
+            if(READ_ONCE(hmb_dev.done1.counters[hmb_completion_index(csd_id, target, c, t->num_partitions)]) < expected)
+                break;
+        }
+        if(csd_id < t->num_csds)
+            continue;
+
+        // The partial sums were written before the counters were bumped
+        smp_rmb();
+        reduce_column(rs, next, c);
+        smp_wmb();
+        WRITE_ONCE(*reduced, target);
+        hmb_notify();
+        cnt++;
+    }
+    return cnt;
+}
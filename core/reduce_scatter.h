@@ -0,0 +1,28 @@
+#ifndef REDUCE_SCATTER_H
+#define REDUCE_SCATTER_H
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+#include "proc_edge_struct.h"
+#include "params.h"
+
+#include <hmb.h>
+
+// Reduce-scatter of the partial sums: this CSD reduces and applies the columns it owns
+struct reduce_scatter {
+    bool active;
+    struct PROC_EDGE tmpl;  // Graph shape, algorithm and sum layout of the run
+
+    long long reduce_time;  // Modeled MCU time spent reducing
+    long long reduced_cnt;  // Columns reduced
+    long long hmb_bytes;    // Values and partial sums touched in the HMB
+};
+
+void reduce_scatter_init(struct reduce_scatter *rs);
+void reduce_scatter_destroy(struct reduce_scatter *rs);
+
+void reduce_scatter_start(struct reduce_scatter *rs, struct PROC_EDGE task);
+int reduce_scatter_poll(struct reduce_scatter *rs);
+
+#endif // REDUCE_SCATTER_H
@@ -0,0 +1,108 @@
+#include "run_plan.h"
+
+void run_plan_init(struct run_plan *plan)
+{
+    plan->active = false;
+    plan->blocks = NULL;
+    plan->io_delay = plan->io_time = 0;
+    plan->io_unit_size = 1;
+}
+
+void run_plan_destroy(struct run_plan *plan)
+{
+    if(plan->blocks)
+        kvfree(plan->blocks);
+    plan->blocks = NULL;
+    plan->active = false;
+}
+
+int run_plan_load(struct run_plan *plan, struct PROC_EDGE tmpl, void *storage, unsigned long long storage_size)
+{
+    long long num_blocks = (long long)tmpl.num_partitions * tmpl.num_partitions;
+    unsigned long long table_size = num_blocks * sizeof(struct run_plan_entry);
+    long long b;
+
+    // A rejected plan leaves none active
+    run_plan_destroy(plan);
+    if(tmpl.num_partitions == 0 || tmpl.num_partitions > MAX_PARTITION){
+        pr_err("Run plan: invalid number of partitions %u\n", tmpl.num_partitions);
+        return -EINVAL;
+    }
+    if(tmpl.plan_slba > storage_size || table_size > storage_size - tmpl.plan_slba){
+        pr_err("Run plan: block table at %llu past the namespace (%llu bytes)\n", tmpl.plan_slba, storage_size);
+        return -EINVAL;
+    }
+
+    plan->blocks = kvmalloc(num_blocks * sizeof(struct run_plan_entry), GFP_KERNEL);
+    if(!plan->blocks){
+        pr_err("Failed to allocate memory for run plan\n");
+        return -ENOMEM;
+    }
+    // Copy the block table, the host may overwrite the namespace afterwards
+    memcpy(plan->blocks, storage + tmpl.plan_slba, table_size);
+    for(b = 0; b < num_blocks; b++){
+        struct run_plan_entry *entry = &plan->blocks[b];
+        if(entry->slba > storage_size || entry->len > storage_size - entry->slba){
+            pr_err("Run plan: block %lld-%lld (%llu + %llu) past the namespace\n",
+                b / tmpl.num_partitions, b % tmpl.num_partitions, entry->slba, entry->len);
+            run_plan_destroy(plan);
+            return -EINVAL;
+        }
+    }
+
+    traversal_init(&plan->trav, tmpl.traversal, tmpl.num_partitions, tmpl.row_overlap);
+    plan->tmpl = tmpl;
+    plan->tmpl.iter = 0;
+    plan->tmpl.is_fvc = false;
+    plan->active = true;
+    return 0;
+}
+
+int run_plan_enqueue_iter(struct run_plan *plan, struct queue *q, int iter, struct hmb_done_buffer *done)
+{
+    struct PROC_EDGE task;
+    int P, k, cnt = 0;
+
+    if(!plan->active || iter >= plan->tmpl.num_iters)
+        return 0;
+
+    P = plan->tmpl.num_partitions;
+    task = plan->tmpl;
+    task.iter = iter;
+    task.is_fvc = false;
+
+    for(k = 0; k < (int)traversal_len(&plan->trav); k++){
+        struct run_plan_entry *entry;
+        unsigned long long len;
+        int r, c;
+
+        if(!traversal_block(&plan->trav, iter, k, &r, &c))
+            continue;
+        entry = &plan->blocks[r * P + c];
+        // Empty blocks are marked done instead of queued, except the last normal task of the iteration kept for the end-of-iteration handshake
+        if(entry->len == 0 && !traversal_is_sentinel(&plan->trav, iter, r, c)){
+            hmb_set_done(done, task.csd_id, r, c, P);
+            continue;
+        }
+
+        // Already processed as a future task in the previous iteration
+        if(hmb_test_done(done, task.csd_id, r, c, P))
+            continue;
+
+        task.r = r;
+        task.c = c;
+        task.edge_block_slba = entry->slba;
+        task.edge_block_len = entry->len;
+
+        // Still pending as a future task
+        if(queue_find(q, task))
+            continue;
+
+        len = task.algorithm == 2 ? task.edge_block_len * 3 / 2 : task.edge_block_len;
+        task.nsecs_target = plan->io_delay + plan->io_time * max(1ULL, DIV_ROUND_UP(len, plan->io_unit_size));
+
+        queue_enqueue(q, task);
+        cnt++;
+    }
+    return cnt;
+}
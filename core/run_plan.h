@@ -0,0 +1,34 @@
+#ifndef RUN_PLAN_H
+#define RUN_PLAN_H
+
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+
+#include "proc_edge_struct.h"
+#include "traversal.h"
+#include "queue.h"
+#include "params.h"
+
+#include <hmb.h>
+
+// Device-resident run plan: the CSD generates its own normal tasks for every iteration
+struct run_plan {
+    bool active;
+    struct PROC_EDGE tmpl;          // Task template from the RUN_PLAN command
+    struct run_plan_entry *blocks;  // blocks[r * num_partitions + c]
+    struct traversal trav;          // Same block order as the host dual queue loop
+
+    // I/O cost model for generated tasks (same as the dispatcher)
+    unsigned long long io_delay, io_time, io_unit_size;
+};
+
+void run_plan_init(struct run_plan *plan);
+void run_plan_destroy(struct run_plan *plan);
+
+// Fails on a block table or an edge block past the storage_size bytes of the namespace
+int run_plan_load(struct run_plan *plan, struct PROC_EDGE tmpl, void *storage, unsigned long long storage_size);
+// Queues the normal tasks of an iteration, its empty edge blocks are marked done in done
+int run_plan_enqueue_iter(struct run_plan *plan, struct queue *q, int iter, struct hmb_done_buffer *done);
+
+#endif // RUN_PLAN_H
@@ -0,0 +1,235 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <linux/types.h> // For __u32 and __u16 definitions
+#ifndef __KERNEL__
+#include <stdbool.h>
+#endif
+
+#include "params.h"
+
+/*
+ * Order of the edge blocks within an iteration, shared by the host loops and the CSDs.
+ * Even iterations walk the curve forward and odd ones backward, so the source partitions
+ * of the last blocks of an iteration are the first ones needed by the next.
+ *
+ * The columns are aggregated in the order the curve completes them (reversed in odd
+ * iterations). A block becomes a future task of the next iteration when its source partition
+ * is aggregated no later than its own column, by that order. The last normal block of an
+ * iteration is its sentinel: it is sent even if empty, and the CSDs end the iteration after it.
+ */
+#define TRAVERSAL_COLUMN 0      // Column-major, row-major once row_overlap == 3 (the original orders)
+#define TRAVERSAL_ZIGZAG 1      // Column-major, the rows of every other column walked bottom-up
+#define TRAVERSAL_HILBERT 2     // Hilbert curve over the grid, rounded up to a power of two
+#define TRAVERSAL_TILED 3       // TRAVERSAL_TILE x TRAVERSAL_TILE tiles column-major, row-major within a tile
+
+#define TRAVERSAL_TILE 4
+
+// The first iteration processes every block, later even and odd ones the blocks not done as future tasks
+#define TRAVERSAL_FIRST 0
+#define TRAVERSAL_EVEN 1
+#define TRAVERSAL_ODD 2
+#define TRAVERSAL_KINDS 3
+
+struct traversal {
+    __u32 order;
+    __u32 num_partitions;
+    __u32 row_overlap;
+    __u32 side;                 // Side of the curve's grid, at least num_partitions
+
+    __u16 column[MAX_PARTITION];    // Columns in aggregation order of the even iterations
+    __u16 rank[MAX_PARTITION];      // Position of each partition in column[]
+
+    __u16 sentinel_r[TRAVERSAL_KINDS], sentinel_c[TRAVERSAL_KINDS];
+    __s16 column_end[TRAVERSAL_KINDS][MAX_PARTITION];   // Row of the last normal block of each column, -1 if none
+};
+
+static inline int traversal_kind(__u32 iter)
+{
+    if(iter == 0)
+        return TRAVERSAL_FIRST;
+    return iter % 2 == 0 ? TRAVERSAL_EVEN : TRAVERSAL_ODD;
+}
+
+// Block slots of an iteration, some of them out of the grid for TRAVERSAL_HILBERT
+static inline __u32 traversal_len(const struct traversal *t)
+{
+    return t->side * t->side;
+}
+
+// Cell d of the Hilbert curve over a side x side grid, side a power of two
+static inline void traversal_hilbert(__u32 side, __u32 d, __u32 *x, __u32 *y)
+{
+    __u32 s, rx, ry, tmp;
+
+    *x = *y = 0;
+    for(s = 1; s < side; s *= 2){
+        rx = 1 & (d / 2);
+        ry = 1 & (d ^ rx);
+        if(ry == 0){
+            if(rx == 1){
+                *x = s - 1 - *x;
+                *y = s - 1 - *y;
+            }
+            tmp = *x;
+            *x = *y;
+            *y = tmp;
+        }
+        *x += s * rx;
+        *y += s * ry;
+        d /= 4;
+    }
+}
+
+// k-th block of the forward curve
+static inline bool traversal_forward(const struct traversal *t, __u32 k, int *r, int *c)
+{
+    const __u32 P = t->num_partitions;
+    __u32 x, y;
+
+    switch(t->order){
+    case TRAVERSAL_ZIGZAG:
+        *c = k / P;
+        *r = *c % 2 ? P - 1 - k % P : k % P;
+        return true;
+    case TRAVERSAL_HILBERT:
+        traversal_hilbert(t->side, k, &x, &y);
+        *c = x;
+        *r = y;
+        return x < P && y < P;
+    case TRAVERSAL_TILED: {
+        // Every tile column holds P rows, only the last tile row and column are narrower
+        __u32 tc = k / (P * TRAVERSAL_TILE), off = k % (P * TRAVERSAL_TILE);
+        __u32 w = P - tc * TRAVERSAL_TILE < TRAVERSAL_TILE ? P - tc * TRAVERSAL_TILE : TRAVERSAL_TILE;
+        __u32 tr = off / (TRAVERSAL_TILE * w), in = off % (TRAVERSAL_TILE * w);
+        *r = tr * TRAVERSAL_TILE + in / w;
+        *c = tc * TRAVERSAL_TILE + in % w;
+        return true;
+    }
+    default:
+        *c = k / P;
+        *r = k % P;
+        return true;
+    }
+}
+
+// k-th block slot of an iteration, false if the slot is out of the grid
+static inline bool traversal_block(const struct traversal *t, __u32 iter, __u32 k, int *r, int *c)
+{
+    const __u32 P = t->num_partitions;
+    int kind = traversal_kind(iter);
+
+    if(t->order == TRAVERSAL_COLUMN){
+        bool row_exec = t->row_overlap == 3 && kind != TRAVERSAL_FIRST;
+        if(kind != TRAVERSAL_ODD){
+            *r = row_exec ? k / P : k % P;
+            *c = row_exec ? k % P : k / P;
+        }
+        else{
+            *r = row_exec ? P - 1 - k / P : k % P;
+            *c = row_exec ? P - 1 - k % P : P - 1 - k / P;
+        }
+        return true;
+    }
+    if(kind == TRAVERSAL_ODD)
+        k = traversal_len(t) - 1 - k;
+    return traversal_forward(t, k, r, c);
+}
+
+// i-th column aggregated in the iteration
+static inline int traversal_column(const struct traversal *t, __u32 iter, int i)
+{
+    return t->column[iter % 2 == 0 ? i : (int)t->num_partitions - 1 - i];
+}
+
+// Last column aggregated in the iteration, its end of iteration waits for it
+static inline int traversal_last_column(const struct traversal *t, __u32 iter)
+{
+    return traversal_column(t, iter, t->num_partitions - 1);
+}
+
+// Block (r, c) of the iteration is also processed as a future task of the next one
+static inline bool traversal_is_future(const struct traversal *t, __u32 iter, int r, int c)
+{
+    if(iter % 2 == 0)
+        return t->rank[r] <= t->rank[c];
+    return t->rank[r] > t->rank[c];
+}
+
+static inline bool traversal_is_sentinel(const struct traversal *t, __u32 iter, int r, int c)
+{
+    int kind = traversal_kind(iter);
+    return r == t->sentinel_r[kind] && c == t->sentinel_c[kind];
+}
+
+/*
+ * Block (r, c) is a normal task of the iteration, unless done as a future task in the previous one.
+ * The future copy of an even sentinel only marks the end of its iteration, the next one runs it.
+ */
+static inline bool traversal_is_normal(const struct traversal *t, __u32 iter, int r, int c)
+{
+    if(iter == 0 || !traversal_is_future(t, iter - 1, r, c))
+        return true;
+    return iter % 2 == 1 && traversal_is_sentinel(t, iter - 1, r, c);
+}
+
+// Block (r, c) is the last normal block of its column in the iteration
+static inline bool traversal_is_column_end(const struct traversal *t, __u32 iter, int r, int c)
+{
+    return t->column_end[traversal_kind(iter)][c] == r;
+}
+
+static inline void traversal_init(struct traversal *t, __u32 order, __u32 num_partitions, __u32 row_overlap)
+{
+    __u32 k, n = 0;
+    int kind, r, c, i;
+    bool seen[MAX_PARTITION];
+
+    if(num_partitions == 0 || num_partitions > MAX_PARTITION)
+        num_partitions = 1;
+    t->order = order;
+    t->num_partitions = num_partitions;
+    t->row_overlap = row_overlap;
+    t->side = num_partitions;
+    if(order == TRAVERSAL_HILBERT){
+        t->side = 1;
+        while(t->side < num_partitions)
+            t->side *= 2;
+    }
+
+    // Columns in the order the first iteration completes them: the last block of each column, backward
+    for(c = 0; c < (int)num_partitions; c++)
+        seen[c] = false;
+    for(k = traversal_len(t); k-- > 0; ){
+        if(!traversal_block(t, 0, k, &r, &c) || seen[c])
+            continue;
+        seen[c] = true;
+        t->column[num_partitions - 1 - n++] = c;
+    }
+    for(i = 0; i < (int)num_partitions; i++)
+        t->rank[t->column[i]] = i;
+
+    // Sentinel and column ends of every kind of iteration, over its normal blocks
+    for(kind = 0; kind < TRAVERSAL_KINDS; kind++){
+        __u32 iter = kind == TRAVERSAL_FIRST ? 0 : kind == TRAVERSAL_EVEN ? 2 : 1;
+        bool found = false;
+
+        for(c = 0; c < (int)num_partitions; c++)
+            t->column_end[kind][c] = -1;
+        for(k = 0; k < traversal_len(t); k++){
+            if(!traversal_block(t, iter, k, &r, &c) || !traversal_is_normal(t, iter, r, c))
+                continue;
+            t->sentinel_r[kind] = r;
+            t->sentinel_c[kind] = c;
+            t->column_end[kind][c] = r;
+            found = true;
+        }
+        // A single partition has no odd normal block, its only block ends the iteration
+        if(!found){
+            t->sentinel_r[kind] = num_partitions - 1;
+            t->sentinel_c[kind] = 0;
+        }
+    }
+}
+
+#endif // TRAVERSAL_H
@@ -0,0 +1,30 @@
+# Experiment grids for run_experiments.sh, one section per former test_*.sh script.
+# Buffer sizes are for LiveJournal (526M of edges, 18M of vertex values), the vertex buffer 2 x 5% of its values.
+# Ex: bash run_experiments.sh experiments.spec experiments/LiveJournal
+
+defaults dataset=LiveJournal.pl algorithm=PR iters=10 reps=5 warmup=1 partial_edge_eviction=1 invalidation=1 vertex_buffer=2M
+
+# Normal, GraFu, dual queue and dual queue with prefetching (run_normal_grafu_dq)
+run csds=8 mode=normal,grafu
+run csds=8 mode=dq prefetch=0 row_overlap=0
+run csds=8 mode=dq prefetch=2 row_overlap=2
+
+# Composition: number of CSDs with the priority cache (test_composition.sh)
+run csds=1,2,4,8,16 cache_policy=PRIORITY edge_buffer=1G mode=dq
+
+# Scalability (test_scalibity.sh)
+run csds=8 cache_policy=LIFO edge_buffer=1G algorithm=PR,LP mode=dq
+run csds=8 cache_policy=LIFO edge_buffer=666M algorithm=DP mode=dq
+
+# Edge buffer size (test_memory.sh)
+run csds=8 cache_policy=LIFO edge_buffer=100M,500M,1G mode=dq
+
+# Prefetching and row overlap (test_row_overlap.sh)
+run csds=8 cache_policy=PRIORITY edge_buffer=100M mode=dq prefetch=0,2 row_overlap=0,2
+
+# Aggregation latency, priority against the default cache (test_aggr.sh)
+run csds=8 cache_policy=PRIORITY edge_buffer=1G mode=dq aggregation_time=10000,20000,30000
+run csds=8 edge_buffer=1G mode=dq aggregation_time=10000,20000,30000
+
+# Correctness against the host-only reference, with runs ending on v_t in buf2 (iters % 3 == 2)
+run csds=8 edge_buffer=1G algorithm=PR,LP,DP mode=normal,dq,planned iters=2,5 verify=8
@@ -2,98 +2,256 @@
 #include <linux/fs.h>
 #include <linux/device.h>
 #include <linux/io.h>
+#include <linux/mman.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
 #include "hmb.h"
+#include "../core/params.h"
 
-#define MEM_START 528 * 1024 * 1024 * 1024UL
-struct hmb_device hmb_dev = {
-    .buf0 = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START + HMB_SIZE * 2,  /* MEM_START = 7GB, Size = 256MB */
-        .size = HMB_SIZE / 4
-    },
-    .buf1 = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START,  /* MEM_START = 7GB + 256MB, Size = 256MB */
-        .size = HMB_SIZE
-    },
-    .buf2 = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START + HMB_SIZE,  /* MEM_START = 7GB + 512MB, Size = 256MB */
-        .size = HMB_SIZE
-    },
-    .done1 = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START + HMB_SIZE * 2 + HMB_SIZE / 4,  
-        .size = HMB_SIZE / 4    /* num_csd * num_partition ^ 2 * 2 (Normal, future) */ 
-    },
-    .done2 = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START + HMB_SIZE * 2 + HMB_SIZE * 2 / 4,  
-        .size = HMB_SIZE / 4    /* num_csd * num_partition ^ 2 * 2 (Normal, future) */ 
-    },
-    .done_partition = {
-        .virt_addr = NULL,
-        .phys_addr = MEM_START + HMB_SIZE * 2 + HMB_SIZE * 3 / 4,  
-        .size = HMB_SIZE / 4
-    }
+/* Reserved physical memory of the HMB */
+static unsigned long hmb_base = 528 * 1024 * 1024 * 1024UL;
+static unsigned long hmb_size = 3 * HMB_SIZE;
+/* Graph shape the regions are sized for, 0: fit the largest graph in hmb_size */
+static unsigned long num_vertices = 0;
+static unsigned int num_csds = MAX_NUM_CSDS;
+static unsigned int num_partitions = MAX_PARTITION;
+/*
+ * Map with PMD/PUD entries where the user address and the region line up.
+ * Needs CONFIG_TRANSPARENT_HUGEPAGE with THP set to always or madvise, otherwise every fault
+ * falls back to 4KB entries.
+ */
+static bool huge_pages = true;
+
+static int set_parse_mem_param(const char *val, const struct kernel_param *kp)
+{
+    unsigned long *arg = (unsigned long *)kp->arg;
+    *arg = memparse(val, NULL);
+    return 0;
+}
+
+static struct kernel_param_ops ops_parse_mem_param = {
+    .set = set_parse_mem_param,
+    .get = param_get_ulong,
 };
+
+module_param_cb(hmb_base, &ops_parse_mem_param, &hmb_base, 0444);
+MODULE_PARM_DESC(hmb_base, "HMB reserved memory address");
+module_param_cb(hmb_size, &ops_parse_mem_param, &hmb_size, 0444);
+MODULE_PARM_DESC(hmb_size, "HMB reserved memory size");
+module_param(num_vertices, ulong, 0444);
+MODULE_PARM_DESC(num_vertices, "Number of vertices (0: largest graph that fits in hmb_size)");
+module_param(num_csds, uint, 0444);
+MODULE_PARM_DESC(num_csds, "Number of CSDs");
+module_param(num_partitions, uint, 0444);
+MODULE_PARM_DESC(num_partitions, "Number of partitions");
+module_param(huge_pages, bool, 0444);
+MODULE_PARM_DESC(huge_pages, "Map the HMB with 2MB/1GB pages, needs THP always or madvise (0: 4KB pages with remap_pfn_range)");
+
+struct hmb_device hmb_dev;
 EXPORT_SYMBOL(hmb_dev);
 
 static int major_number;
 static struct class *hmb_class;
 
+static unsigned long hmb_get_unmapped_area(struct file *file, unsigned long addr,
+    unsigned long len, unsigned long pgoff, unsigned long flags);
+static ssize_t hmb_read(struct file *file, char __user *buf, size_t count, loff_t *ppos);
+
 /* File operations */
 static struct file_operations hmb_fops = {
     .owner = THIS_MODULE,
     .mmap = hmb_mmap,
+    .get_unmapped_area = hmb_get_unmapped_area,
+    .read = hmb_read,
+    .llseek = noop_llseek,
 };
 
+/*
+ * Completion notification: the CSDs bump hmb_dev.events after every flag they set.
+ * The host reads the count, checks its flags once more, then sleeps in read() with that
+ * count, see struct hmb_wait. Nothing is kept per file, every waiter passes its own count.
+ */
+void hmb_notify(void)
+{
+    /* Fully ordered, so the flag is visible before the count changes */
+    atomic_inc_return(&hmb_dev.events);
+    if (wq_has_sleeper(&hmb_dev.wait))
+        wake_up_interruptible_all(&hmb_dev.wait);
+}
+EXPORT_SYMBOL(hmb_notify);
+
+static ssize_t hmb_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct hmb_wait w;
+    size_t len = sizeof(w.seen);
+    long ret;
+
+    if (count < sizeof(w.seen))
+        return -EINVAL;
+    if (count >= sizeof(w)) {
+        if (copy_from_user(&w, buf, sizeof(w)))
+            return -EFAULT;
+        ret = wait_event_interruptible_timeout(hmb_dev.wait, (u32)atomic_read(&hmb_dev.events) != w.seen,
+                                               msecs_to_jiffies(w.timeout_ms));
+        if (ret < 0)
+            return ret;
+        len = sizeof(w);
+    }
+    w.seen = atomic_read(&hmb_dev.events);
+    if (copy_to_user(buf, &w.seen, sizeof(w.seen)))
+        return -EFAULT;
+    return len;
+}
+
+static void *hmb_region(int id)
+{
+    switch (id) {
+    case HMB_REGION_BUF0: return &hmb_dev.buf0;
+    case HMB_REGION_BUF1: return &hmb_dev.buf1;
+    case HMB_REGION_BUF2: return &hmb_dev.buf2;
+    case HMB_REGION_DONE: return &hmb_dev.done;
+    case HMB_REGION_DONE_PARTITION: return &hmb_dev.done_partition;
+    case HMB_REGION_COMPLETION: return &hmb_dev.completion;
+    case HMB_REGION_CONTROL: return &hmb_dev.control;
+    }
+    return NULL;
+}
+
+/* Physical page behind a user address, the mmap offset is the offset in the HMB */
+static unsigned long hmb_vma_pfn(struct vm_area_struct *vma, unsigned long addr)
+{
+    return (hmb_base >> PAGE_SHIFT) + vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT);
+}
+
+static vm_fault_t hmb_vm_fault(struct vm_fault *vmf)
+{
+    unsigned long addr = vmf->address & PAGE_MASK;
+    return vmf_insert_pfn(vmf->vma, addr, hmb_vma_pfn(vmf->vma, addr));
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* A huge entry needs the whole page inside the vma and a physical address aligned like the user one */
+static bool hmb_huge_fits(struct vm_area_struct *vma, unsigned long addr, unsigned long page_size)
+{
+    if (addr < vma->vm_start || addr + page_size > vma->vm_end)
+        return false;
+    return !(hmb_vma_pfn(vma, addr) & ((page_size >> PAGE_SHIFT) - 1));
+}
+
+static vm_fault_t hmb_vm_fault_pmd(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    unsigned long addr = vmf->address & PMD_MASK;
+
+    if (!hmb_huge_fits(vma, addr, PMD_SIZE))
+        return VM_FAULT_FALLBACK;
+    return vmf_insert_pfn_pmd(vmf, __pfn_to_pfn_t(hmb_vma_pfn(vma, addr), PFN_DEV), vmf->flags & FAULT_FLAG_WRITE);
+}
+
+static vm_fault_t hmb_vm_fault_pud(struct vm_fault *vmf)
+{
+#ifdef CONFIG_HAVE_ARCH_TRANSPARENT_HUGEPAGE_PUD
+    struct vm_area_struct *vma = vmf->vma;
+    unsigned long addr = vmf->address & PUD_MASK;
+
+    if (!hmb_huge_fits(vma, addr, PUD_SIZE))
+        return VM_FAULT_FALLBACK;
+    return vmf_insert_pfn_pud(vmf, __pfn_to_pfn_t(hmb_vma_pfn(vma, addr), PFN_DEV), vmf->flags & FAULT_FLAG_WRITE);
+#else
+    return VM_FAULT_FALLBACK;
+#endif
+}
+
+/* The entry size is a page order from 6.6, an enum page_entry_size before */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+static vm_fault_t hmb_vm_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+    if (order == PMD_SHIFT - PAGE_SHIFT)
+        return hmb_vm_fault_pmd(vmf);
+    if (order == PUD_SHIFT - PAGE_SHIFT)
+        return hmb_vm_fault_pud(vmf);
+    return VM_FAULT_FALLBACK;
+}
+#else
+static vm_fault_t hmb_vm_huge_fault(struct vm_fault *vmf, enum page_entry_size pe_size)
+{
+    if (pe_size == PE_SIZE_PMD)
+        return hmb_vm_fault_pmd(vmf);
+    if (pe_size == PE_SIZE_PUD)
+        return hmb_vm_fault_pud(vmf);
+    return VM_FAULT_FALLBACK;
+}
+#endif
+#endif
+
+static const struct vm_operations_struct hmb_vm_ops = {
+    .fault = hmb_vm_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    .huge_fault = hmb_vm_huge_fault,
+#endif
+};
+
+/*
+ * Place mappings so that the user address and the physical address share their offset
+ * in a huge page, otherwise no PMD/PUD entry can ever be used
+ */
+static unsigned long hmb_get_unmapped_area(struct file *file, unsigned long addr,
+    unsigned long len, unsigned long pgoff, unsigned long flags)
+{
+    unsigned long page_size = hmb_layout_page_size(len);
+    unsigned long phys = hmb_base + (pgoff << PAGE_SHIFT);
+    unsigned long ret;
+
+    if (!huge_pages || addr || (flags & MAP_FIXED) || page_size == PAGE_SIZE || len + page_size < len)
+        return current->mm->get_unmapped_area(file, addr, len, pgoff, flags);
+
+    ret = current->mm->get_unmapped_area(file, 0, len + page_size, pgoff, flags);
+    if (IS_ERR_VALUE(ret))
+        return ret;
+    return ret + ((phys - ret) & (page_size - 1));
+}
+
 int hmb_mmap(struct file *file, struct vm_area_struct *vma)
 {
     unsigned long size = vma->vm_end - vma->vm_start;
     unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
-    struct hmb_buffer *buf = NULL;
-    struct hmb_bitmap_buffer *done = NULL;
+    struct hmb_layout *layout = &hmb_dev.layout;
+    int i;
 
-    /* Select which buffer based on offset */
+    /* Layout header at offset 0, then one region per offset published in it */
     if (offset == 0) {
-        buf = &hmb_dev.buf1;
-    } else if (offset == HMB_SIZE) {
-        buf = &hmb_dev.buf2;
-    } else if (offset == HMB_SIZE * 2) {
-        buf = &hmb_dev.buf0;
-    } else if (offset == HMB_SIZE * 2 + HMB_SIZE / 4){
-        done = &hmb_dev.done1;
-    } else if (offset == HMB_SIZE * 2 + HMB_SIZE * 2 / 4){
-        done = &hmb_dev.done2;
-    } else if (offset == HMB_SIZE * 2 + HMB_SIZE * 3 / 4){
-        done = &hmb_dev.done_partition;
-    } 
-    else {
-        return -EINVAL;
-    }
-
-    if(buf != NULL){
-        if (size > buf->size)
+        if (size > HMB_LAYOUT_HEADER_SIZE)
             return -EINVAL;
-        // pr_info("HMB: gg float");
-        return remap_pfn_range(vma, 
-                            vma->vm_start,
-                            buf->phys_addr >> PAGE_SHIFT,
-                            size,
-                            vma->vm_page_prot);
-    }
-    else if(done != NULL){
-        if (size > done->size)
+    } else {
+        for (i = 0; i < HMB_NUM_REGIONS; i++) {
+            if (offset == layout->regions[i].offset)
+                break;
+        }
+        if (i == HMB_NUM_REGIONS || size > layout->regions[i].size)
             return -EINVAL;
-        // pr_info("HMB: gg boolean");
-        return remap_pfn_range(vma, 
+    }
+
+    if (!huge_pages)
+        return remap_pfn_range(vma,
                             vma->vm_start,
-                            done->phys_addr >> PAGE_SHIFT,
+                            (hmb_base + offset) >> PAGE_SHIFT,
                             size,
                             vma->vm_page_prot);
-    }
-    return -1;
+
+    /*
+     * Populated on fault, with the largest page that fits. The fault path only calls ->huge_fault
+     * on THP-eligible vmas: VM_HUGEPAGE is what makes this one eligible in madvise mode (5.15)
+     * and for non-DAX vmas (6.1 to 6.11).
+     */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE);
+#else
+    vma->vm_flags |= VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE;
+#endif
+    vma->vm_ops = &hmb_vm_ops;
+    return 0;
 }
 
 int hmb_init_buffer(struct hmb_buffer *buf, phys_addr_t phys_addr)
@@ -132,13 +290,35 @@ void hmb_cleanup_bitmap_buffer(struct hmb_bitmap_buffer *buf)
     }
 }
 
+int hmb_init_counter_buffer(struct hmb_counter_buffer *buf, phys_addr_t phys_addr)
+{
+    buf->phys_addr = phys_addr;
+    buf->virt_addr = memremap(buf->phys_addr, buf->size, MEMREMAP_WB);
+    if (!buf->virt_addr)
+        return -ENOMEM;
+    memset(buf->virt_addr, 0, buf->size);
+    return 0;
+}
+
+void hmb_cleanup_counter_buffer(struct hmb_counter_buffer *buf)
+{
+    if (buf->virt_addr) {
+        memunmap(buf->virt_addr);
+        buf->virt_addr = NULL;
+    }
+}
+
 int hmb_setup_device(void)
 {
     major_number = register_chrdev(0, DEVICE_NAME, &hmb_fops);
     if (major_number < 0)
         return major_number;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    hmb_class = class_create(DEVICE_NAME);
+#else
     hmb_class = class_create(THIS_MODULE, DEVICE_NAME);
+#endif
     if (IS_ERR(hmb_class)) {
         unregister_chrdev(major_number, DEVICE_NAME);
         return PTR_ERR(hmb_class);
@@ -162,63 +342,123 @@ void hmb_cleanup_device(void)
     unregister_chrdev(major_number, DEVICE_NAME);
 }
 
-static int __init hmb_init(void)
+static void hmb_cleanup_regions(void)
 {
-    int ret;
+    hmb_cleanup_buffer(&hmb_dev.buf0);
+    hmb_cleanup_buffer(&hmb_dev.buf1);
+    hmb_cleanup_buffer(&hmb_dev.buf2);
+    hmb_cleanup_counter_buffer(&hmb_dev.done);
+    hmb_cleanup_bitmap_buffer(&hmb_dev.done_partition);
+    hmb_cleanup_counter_buffer(&hmb_dev.completion);
+    hmb_cleanup_counter_buffer(&hmb_dev.control);
+    hmb_cleanup_bitmap_buffer(&hmb_dev.header);
+}
 
-    ret = hmb_init_buffer(&hmb_dev.buf0, hmb_dev.buf0.phys_addr);
-    if (ret < 0)
-        return ret;
-    
-    ret = hmb_init_buffer(&hmb_dev.buf1, hmb_dev.buf1.phys_addr);
-    if (ret < 0){
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        return ret;
+/* Largest graph whose regions still fit in hmb_size */
+static unsigned long hmb_max_vertices(void)
+{
+    struct hmb_layout layout;
+    unsigned long fixed, per_buffer, lo, hi;
+
+    /* Upper bound: everything but the vertices, ignoring the huge page alignment */
+    hmb_layout_compute(&layout, 0, num_csds, num_partitions);
+    fixed = layout.total_size;
+
+    if (hmb_size <= fixed)
+        return 0;
+    per_buffer = (hmb_size - fixed) / 3 / sizeof(float);
+    if (per_buffer <= (unsigned long)HMB_STAT_FLOATS_PER_CSD * num_csds)
+        return 0;
+    hi = (per_buffer - HMB_STAT_FLOATS_PER_CSD * num_csds) / HMB_VALUE_SLOTS(num_csds);
+
+    /* The aligned layout grows with the vertices, search the largest one that fits */
+    lo = 0;
+    while (lo < hi) {
+        unsigned long mid = lo + (hi - lo + 1) / 2;
+        hmb_layout_compute(&layout, mid, num_csds, num_partitions);
+        if (layout.total_size <= hmb_size)
+            lo = mid;
+        else
+            hi = mid - 1;
     }
+    return lo;
+}
 
-    ret = hmb_init_buffer(&hmb_dev.buf2, hmb_dev.buf2.phys_addr);
-    if (ret < 0) {
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        hmb_cleanup_buffer(&hmb_dev.buf1);
-        return ret;
+static int hmb_init_layout(void)
+{
+    struct hmb_layout *layout = &hmb_dev.layout;
+    int ret;
+
+    if (num_csds == 0 || num_csds > MAX_NUM_CSDS || num_partitions == 0 || num_partitions > MAX_PARTITION) {
+        pr_err("HMB: Invalid num_csds %u or num_partitions %u\n", num_csds, num_partitions);
+        return -EINVAL;
     }
+    if (num_vertices == 0)
+        num_vertices = hmb_max_vertices();
 
-    ret = hmb_init_bitmap_buffer(&hmb_dev.done1, hmb_dev.done1.phys_addr);
-    if (ret < 0) {
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        hmb_cleanup_buffer(&hmb_dev.buf1);
-        hmb_cleanup_buffer(&hmb_dev.buf2);
-        return ret;
+    hmb_layout_compute(layout, num_vertices, num_csds, num_partitions);
+    if (num_vertices == 0 || layout->total_size > hmb_size) {
+        pr_err("HMB: Layout needs %llu bytes, only %lu reserved\n", layout->total_size, hmb_size);
+        return -ENOMEM;
     }
 
-    ret = hmb_init_bitmap_buffer(&hmb_dev.done2, hmb_dev.done2.phys_addr);
-    if (ret < 0) {
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        hmb_cleanup_buffer(&hmb_dev.buf1);
-        hmb_cleanup_buffer(&hmb_dev.buf2);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done1);
+    /* Publish the layout for the host */
+    hmb_dev.header.size = HMB_LAYOUT_HEADER_SIZE;
+    ret = hmb_init_bitmap_buffer(&hmb_dev.header, hmb_base);
+    if (ret < 0)
         return ret;
-    }
+    memcpy(hmb_dev.header.virt_addr, layout, sizeof(*layout));
 
-    ret = hmb_init_bitmap_buffer(&hmb_dev.done_partition, hmb_dev.done_partition.phys_addr);
-    if (ret < 0) {
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        hmb_cleanup_buffer(&hmb_dev.buf1);
-        hmb_cleanup_buffer(&hmb_dev.buf2);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done1);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done2);
+    pr_info("HMB: %llu bytes at 0x%lx for %llu vertices, %u CSDs, %u partitions, %s pages\n",
+        layout->total_size, hmb_base, layout->num_vertices, layout->num_csds, layout->num_partitions,
+        huge_pages ? "huge" : "4KB");
+    return 0;
+}
+
+static int __init hmb_init(void)
+{
+    struct hmb_layout *layout = &hmb_dev.layout;
+    int ret, i;
+
+    ret = hmb_init_layout();
+    if (ret < 0)
         return ret;
+
+    for (i = 0; i < HMB_NUM_REGIONS; i++) {
+        phys_addr_t phys_addr = hmb_base + layout->regions[i].offset;
+
+        if (i <= HMB_REGION_BUF2) {
+            struct hmb_buffer *buf = hmb_region(i);
+            buf->size = layout->regions[i].size;
+            ret = hmb_init_buffer(buf, phys_addr);
+        } else if (i == HMB_REGION_DONE || i == HMB_REGION_COMPLETION || i == HMB_REGION_CONTROL) {
+            struct hmb_counter_buffer *buf = hmb_region(i);
+            buf->size = layout->regions[i].size;
+            ret = hmb_init_counter_buffer(buf, phys_addr);
+        } else {
+            struct hmb_bitmap_buffer *buf = hmb_region(i);
+            buf->size = layout->regions[i].size;
+            ret = hmb_init_bitmap_buffer(buf, phys_addr);
+        }
+        if (ret < 0) {
+            hmb_cleanup_regions();
+            return ret;
+        }
     }
 
+    /* done1 and done2 are the done region seen for v_t+1 and v_t+2 */
+    hmb_dev.done1.iters = hmb_dev.done2.iters = hmb_dev.done.virt_addr;
+    hmb_dev.done1.counters = hmb_dev.done2.counters = hmb_dev.completion.virt_addr;
+    hmb_dev.done1.role = HMB_ROLE_NEXT;
+    hmb_dev.done2.role = HMB_ROLE_FUTURE;
+
+    init_waitqueue_head(&hmb_dev.wait);
+    atomic_set(&hmb_dev.events, 0);
+
     /* Setup device */
     ret = hmb_setup_device();
     if (ret < 0) {
-        hmb_cleanup_buffer(&hmb_dev.buf0);
-        hmb_cleanup_buffer(&hmb_dev.buf1);
-        hmb_cleanup_buffer(&hmb_dev.buf2);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done1);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done2);
-        hmb_cleanup_bitmap_buffer(&hmb_dev.done_partition);
+        hmb_cleanup_regions();
         return ret;
     }
 
@@ -229,9 +469,7 @@ static int __init hmb_init(void)
 static void __exit hmb_exit(void)
 {
     hmb_cleanup_device();
-    hmb_cleanup_buffer(&hmb_dev.buf0);
-    hmb_cleanup_buffer(&hmb_dev.buf1);
-    hmb_cleanup_buffer(&hmb_dev.buf2);
+    hmb_cleanup_regions();
     pr_info("HMB: Cleaned up\n");
 }
 
@@ -239,4 +477,4 @@ module_init(hmb_init);
 module_exit(hmb_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Benny");
-MODULE_DESCRIPTION("Host Memory Buffer Driver starting at 11GB");
\ No newline at end of file
+MODULE_DESCRIPTION("Host Memory Buffer Driver with a runtime-sized layout");
@@ -3,11 +3,16 @@
 
 #include <linux/types.h>
 #include <linux/mm.h>
+#include <linux/bitops.h>
+#include <linux/atomic.h>
+#include <linux/wait.h>
+
+#include "hmb_layout.h"
 
 #define DEVICE_NAME "hmb_mem"
 #define MB_256 (256 * 1024 * 1024UL)
 #define GB_80 (80LL * 1024 * 1024 * 1024)
-#define HMB_SIZE GB_80
+#define HMB_SIZE GB_80  /* Default reservation is 3 * HMB_SIZE, see hmb_size */
 
 /* Structure for a single HMB buffer */
 struct hmb_buffer {
@@ -17,18 +22,38 @@ struct hmb_buffer {
 };
 
 struct hmb_bitmap_buffer {
-    bool *virt_addr;         /* Kernel virtual address of mapped memory */
+    unsigned long *virt_addr;   /* Kernel virtual address of mapped memory, one bit per flag */
+    phys_addr_t phys_addr;  /* Physical address of memory region */
+    size_t size;           /* Size of memory region */
+};
+
+struct hmb_counter_buffer {
+    u32 *virt_addr;         /* Kernel virtual address of mapped memory */
     phys_addr_t phys_addr;  /* Physical address of memory region */
     size_t size;           /* Size of memory region */
 };
 
+/* done1 or done2: the done region seen for the iteration of v_t+1 or v_t+2 */
+struct hmb_done_buffer {
+    u32 *iters;             /* Iteration each (csd, r, c) was last completed for, see hmb_done_index() */
+    u32 *counters;          /* Column counters in the completion area */
+    int role;               /* HMB_ROLE_NEXT or HMB_ROLE_FUTURE */
+};
+
 /* Structure for HMB device */
 struct hmb_device {
-    struct hmb_buffer buf0;  /* First 256MB buffer (v_t) */
-    struct hmb_buffer buf1;  /* Second 256MB buffer (v_t+1) */
-    struct hmb_buffer buf2;  /* Third 256MB buffer (v_t+2)*/
-    struct hmb_bitmap_buffer done1, done2;  /* Aggregation from CSDs: num_csd * num_partition ^ 2 * 2 (Normal, future) */ 
+    struct hmb_buffer buf0;  /* Value buffers, see hmb_value_buf() for v_t, v_t+1 and v_t+2 */
+    struct hmb_buffer buf1;
+    struct hmb_buffer buf2;
+    struct hmb_counter_buffer done;     /* Aggregation from CSDs, seen through done1 and done2 */
+    struct hmb_done_buffer done1, done2;
     struct hmb_bitmap_buffer done_partition;    /* Aggregation done to notify CSDs*/
+    struct hmb_counter_buffer completion;   /* Completed edge blocks per CSD and column */
+    struct hmb_counter_buffer control;  /* Epoch of the value buffer ring and flush counters */
+    struct hmb_bitmap_buffer header;    /* Layout header published at offset 0 */
+    struct hmb_layout layout;
+    wait_queue_head_t wait;     /* Host threads sleeping in read() on /dev/hmb_mem */
+    atomic_t events;            /* Completions signalled by the CSDs, see hmb_notify() */
     spinlock_t lock;
 };
 
@@ -44,6 +69,11 @@ int hmb_init_buffer(struct hmb_buffer *buf, phys_addr_t phys_addr);
 void hmb_cleanup_buffer(struct hmb_buffer *buf);
 int hmb_init_bitmap_buffer(struct hmb_bitmap_buffer *buf, phys_addr_t phys_addr);
 void hmb_cleanup_bitmap_buffer(struct hmb_bitmap_buffer *buf);
+int hmb_init_counter_buffer(struct hmb_counter_buffer *buf, phys_addr_t phys_addr);
+void hmb_cleanup_counter_buffer(struct hmb_counter_buffer *buf);
+
+/* Wake the host waiting for a completion, after the flag is visible in the HMB */
+void hmb_notify(void);
 
 /* Module init and exit */
 static int hmb_init(void);
@@ -52,4 +82,62 @@ static void hmb_exit(void);
 /* Global variable declaration */
 extern struct hmb_device hmb_dev;
 
+static inline u32 hmb_epoch(void)
+{
+    return READ_ONCE(hmb_dev.control.virt_addr[HMB_CONTROL_EPOCH]);
+}
+
+/* Iteration that done1 or done2 stands for in the current epoch */
+static inline u32 hmb_done_target(struct hmb_done_buffer *done)
+{
+    return hmb_epoch() + done->role;
+}
+
+/* Completion of edge block (r, c) on a CSD, in done1 or done2 */
+static inline bool hmb_test_done(struct hmb_done_buffer *done, int csd_id, int r, int c, int num_partitions)
+{
+    return READ_ONCE(done->iters[hmb_done_index(csd_id, r, c, num_partitions)]) >= hmb_done_target(done);
+}
+
+/* The column counter only counts the first completion of a block for an iteration */
+static inline void hmb_set_done(struct hmb_done_buffer *done, int csd_id, int r, int c, int num_partitions)
+{
+    u32 *iter = &done->iters[hmb_done_index(csd_id, r, c, num_partitions)];
+    u32 target = hmb_done_target(done);
+    u32 old = READ_ONCE(*iter);
+
+    while (old < target) {
+        u32 prev = cmpxchg(iter, old, target);
+        if (prev == old) {
+            atomic_inc((atomic_t *)&done->counters[hmb_completion_index(csd_id, target, c, num_partitions)]);
+            hmb_notify();
+            return;
+        }
+        old = prev;
+    }
+}
+
+/* The host waits on this counter, see hmb_control_words() */
+static inline void hmb_set_flushed(int csd_id)
+{
+    atomic_inc((atomic_t *)&hmb_dev.control.virt_addr[HMB_CONTROL_FLUSH + csd_id]);
+    hmb_notify();
+}
+
+/* Stat i of a CSD on flush, see hmb_stat_index() */
+static inline float *hmb_stat(int csd_id, int i)
+{
+    return &hmb_dev.buf2.virt_addr[hmb_stat_index(hmb_dev.layout.num_csds, hmb_dev.layout.num_vertices, csd_id, i)];
+}
+
+/* Value buffer playing v_t + role in the current epoch */
+static inline float *hmb_value_buf(int role)
+{
+    switch (hmb_value_buf_index(hmb_epoch(), role)) {
+    case 0: return hmb_dev.buf0.virt_addr;
+    case 1: return hmb_dev.buf1.virt_addr;
+    }
+    return hmb_dev.buf2.virt_addr;
+}
+
 #endif /* _HMB_H_ */
\ No newline at end of file
@@ -0,0 +1,210 @@
+#ifndef _HMB_LAYOUT_H_
+#define _HMB_LAYOUT_H_
+
+#include <linux/types.h> // For __u64 and __u32 definitions
+
+/*
+ * Layout of the HMB, shared by hmb.ko and the host program.
+ * The header sits at offset 0 of the HMB and every region offset is also its mmap offset.
+ */
+#define HMB_LAYOUT_MAGIC 0x484d424cU   /* "HMBL" */
+#define HMB_LAYOUT_VERSION 7
+#define HMB_LAYOUT_ALIGN 4096ULL
+#define HMB_LAYOUT_HEADER_SIZE HMB_LAYOUT_ALIGN
+/* Regions of at least 2MB start on a PMD boundary, so hmb.ko can map them with PMD/PUD entries */
+#define HMB_LAYOUT_PMD_ALIGN (2ULL << 20)
+#define HMB_LAYOUT_PUD_ALIGN (1ULL << 30)
+
+/*
+ * Value buffers: V values, V partial sums per CSD, then one V-sized slot whose first
+ * num_csds floats are the last column of each CSD (HMB window), plus the per-CSD stats on flush
+ */
+#define HMB_VALUE_SLOTS(num_csds) ((num_csds) + 2)
+#define HMB_STAT_FLOATS_PER_CSD 16
+
+/*
+ * Stat i of a CSD on flush, after the value slots of buf2 so it never overwrites vertex values
+ * whichever role buf2 plays in the last epoch. num_csds and num_vertices are those of the layout.
+ */
+static inline __u64 hmb_stat_index(__u32 num_csds, __u64 num_vertices, __u32 csd_id, int i)
+{
+    return HMB_VALUE_SLOTS(num_csds) * num_vertices + (__u64)i * num_csds + csd_id;
+}
+
+enum hmb_region_id {
+    HMB_REGION_BUF0 = 0,        /* Value buffers, each one plays v_t, v_t+1 or v_t+2 depending on the epoch */
+    HMB_REGION_BUF1,
+    HMB_REGION_BUF2,
+    HMB_REGION_DONE,            /* Aggregation from CSDs: iteration each (csd, r, c) was last completed for */
+    HMB_REGION_DONE_PARTITION,  /* Aggregation done to notify CSDs, then end of iteration handshake, bitmap */
+    HMB_REGION_COMPLETION,      /* Completed edge blocks per CSD and column over all iterations */
+    HMB_REGION_CONTROL,         /* Control words written by the host, see enum hmb_control_word */
+    HMB_NUM_REGIONS
+};
+
+struct hmb_region_desc {
+    __u64 offset;
+    __u64 size;
+};
+
+struct hmb_layout {
+    __u32 magic;
+    __u32 version;
+    __u64 num_vertices;
+    __u32 num_csds;
+    __u32 num_partitions;
+    __u64 total_size;
+    struct hmb_region_desc regions[HMB_NUM_REGIONS];
+};
+
+/*
+ * Completion wait on /dev/hmb_mem: read() of a __u32 returns the event count, read() of a
+ * struct hmb_wait sleeps until the count differs from seen or timeout_ms passes and returns
+ * the count in seen. Each waiter keeps its own count, so threads sharing the fd all wake up.
+ */
+struct hmb_wait {
+    __u32 seen;
+    __u32 timeout_ms;
+};
+
+static inline __u64 hmb_layout_align(__u64 size)
+{
+    return (size + HMB_LAYOUT_ALIGN - 1) / HMB_LAYOUT_ALIGN * HMB_LAYOUT_ALIGN;
+}
+
+/* Largest page size a region of this size can be mapped with */
+static inline __u64 hmb_layout_page_size(__u64 size)
+{
+    if (size >= HMB_LAYOUT_PUD_ALIGN)
+        return HMB_LAYOUT_PUD_ALIGN;
+    if (size >= HMB_LAYOUT_PMD_ALIGN)
+        return HMB_LAYOUT_PMD_ALIGN;
+    return HMB_LAYOUT_ALIGN;
+}
+
+/*
+ * Completion tracking only moves forward, nothing is reset between iterations.
+ * Edge block (r, c) of a CSD holds the last iteration it was completed for: epoch + 1 for
+ * a normal task (v_t+1, done1), epoch + 2 for a future task (v_t+2, done2), so it is done
+ * for a target iteration once it reaches it.
+ * Column counters count first completions, split by the parity of the target iteration
+ * since a column of v_t+2 fills while the host waits for the same column of v_t+1.
+ * Each CSD's entries and counters start on their own cache line.
+ */
+#define HMB_CACHE_LINE 64
+#define HMB_BITS_PER_WORD 64
+#define HMB_DONE_PARITIES 2
+
+static inline __u64 hmb_done_stride(__u32 num_partitions)
+{
+    __u64 line_entries = HMB_CACHE_LINE / sizeof(__u32);
+    return ((__u64)num_partitions * num_partitions + line_entries - 1) / line_entries * line_entries;
+}
+
+/* Entry of edge block (r, c) of a CSD in the done region */
+static inline __u64 hmb_done_index(int csd_id, int r, int c, __u32 num_partitions)
+{
+    return csd_id * hmb_done_stride(num_partitions) + (__u64)r * num_partitions + c;
+}
+
+/* Counters per CSD: num_partitions columns for even targets, then for odd ones */
+static inline __u64 hmb_completion_stride(__u32 num_partitions)
+{
+    __u64 line_counters = HMB_CACHE_LINE / sizeof(__u32);
+    return ((__u64)HMB_DONE_PARITIES * num_partitions + line_counters - 1) / line_counters * line_counters;
+}
+
+static inline __u64 hmb_completion_index(int csd_id, __u32 target, int c, __u32 num_partitions)
+{
+    return csd_id * hmb_completion_stride(num_partitions) + (__u64)(target % HMB_DONE_PARITIES) * num_partitions + c;
+}
+
+/* Counter value of a column once all of its rows are done for target, the targets start at 1 */
+static inline __u32 hmb_column_expected(__u32 target, __u32 num_partitions)
+{
+    return (target + 1) / HMB_DONE_PARITIES * num_partitions;
+}
+
+/* done_partition: bit p for partition p, bit num_partitions + csd_id + 1 for the end of iteration handshake */
+static inline __u64 hmb_done_partition_bits(__u32 num_partitions, __u32 num_csds)
+{
+    return num_partitions + num_csds + 1;
+}
+
+/*
+ * The three value buffers are a ring: at epoch e, role r (v_t+r) lives in buffer (e + r) % 3.
+ * The host bumps the epoch at the end of an iteration instead of copying v_t+1 and v_t+2 down,
+ * partial sums and columns stay where the CSDs wrote them.
+ */
+#define HMB_NUM_VALUE_BUFS 3
+#define HMB_ROLE_CURR 0     /* v_t, source of normal tasks */
+#define HMB_ROLE_NEXT 1     /* v_t+1, destination of normal tasks, source of future tasks */
+#define HMB_ROLE_FUTURE 2   /* v_t+2, destination of future tasks */
+
+enum hmb_control_word {
+    HMB_CONTROL_EPOCH = 0,      /* Number of end of iteration rotations */
+    HMB_CONTROL_FLUSH,          /* One per CSD: flushes completed */
+    /* Then one per partition: iteration the column was last reduced for, see hmb_control_reduced() */
+};
+
+/*
+ * Reduce-scatter: column c is owned by CSD c % num_csds, which adds up the partial sums of
+ * every CSD into v_t+1 once the column is complete and applies the algorithm's update.
+ * Like the done entries, the marker holds the target iteration and only moves forward.
+ */
+static inline int hmb_column_owner(int c, __u32 num_csds)
+{
+    return c % num_csds;
+}
+
+/* num_csds is the one of the layout on both sides, not the run's, which may be smaller */
+static inline __u64 hmb_control_reduced(__u32 num_csds, int c)
+{
+    return HMB_CONTROL_FLUSH + num_csds + c;
+}
+
+static inline __u64 hmb_control_words(__u32 num_csds, __u32 num_partitions)
+{
+    return hmb_control_reduced(num_csds, num_partitions);
+}
+
+static inline int hmb_value_buf_index(__u32 epoch, int role)
+{
+    return (epoch % HMB_NUM_VALUE_BUFS + role) % HMB_NUM_VALUE_BUFS;
+}
+
+/* Region sizes from the graph shape, regions are packed after the header */
+static inline void hmb_layout_compute(struct hmb_layout *layout, __u64 num_vertices, __u32 num_csds, __u32 num_partitions)
+{
+    __u64 done_size = num_csds * hmb_done_stride(num_partitions) * sizeof(__u32);
+    __u64 done_partition_words = (hmb_done_partition_bits(num_partitions, num_csds) + HMB_BITS_PER_WORD - 1) / HMB_BITS_PER_WORD;
+    __u64 value_size = (HMB_VALUE_SLOTS(num_csds) * num_vertices + (__u64)HMB_STAT_FLOATS_PER_CSD * num_csds) * sizeof(float);
+    __u64 size[HMB_NUM_REGIONS];
+    __u64 offset = HMB_LAYOUT_HEADER_SIZE;
+    int i;
+
+    size[HMB_REGION_BUF0] = value_size;
+    size[HMB_REGION_BUF1] = value_size;
+    size[HMB_REGION_BUF2] = value_size;
+    size[HMB_REGION_DONE] = done_size;
+    size[HMB_REGION_DONE_PARTITION] = done_partition_words * sizeof(__u64);
+    size[HMB_REGION_COMPLETION] = num_csds * hmb_completion_stride(num_partitions) * sizeof(__u32);
+    size[HMB_REGION_CONTROL] = hmb_control_words(num_csds, num_partitions) * sizeof(__u32);
+
+    layout->magic = HMB_LAYOUT_MAGIC;
+    layout->version = HMB_LAYOUT_VERSION;
+    layout->num_vertices = num_vertices;
+    layout->num_csds = num_csds;
+    layout->num_partitions = num_partitions;
+    for (i = 0; i < HMB_NUM_REGIONS; i++) {
+        /* A PMD aligned start is enough, the 1GB pages inside a region can still be mapped with PUD entries */
+        __u64 align = hmb_layout_page_size(size[i]) < HMB_LAYOUT_PMD_ALIGN ? HMB_LAYOUT_ALIGN : HMB_LAYOUT_PMD_ALIGN;
+        offset = (offset + align - 1) / align * align;
+        layout->regions[i].offset = offset;
+        layout->regions[i].size = hmb_layout_align(size[i]);
+        offset += layout->regions[i].size;
+    }
+    layout->total_size = offset;
+}
+
+#endif /* _HMB_LAYOUT_H_ */
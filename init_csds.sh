@@ -16,7 +16,7 @@ done
 make clean
 
 # Parse command-line options
-while getopts n:c:p:i:e:v: flag; do
+while getopts n:c:p:i:e:v:b:s:V:P:H:NM: flag; do
     case "${flag}" in
         n) num_csds=${OPTARG};;  # Number of CSDs
         c) cache_eviction_policy=${OPTARG};;  # Cache policy (FIFO, LRU, etc.)
@@ -24,6 +24,13 @@ while getopts n:c:p:i:e:v: flag; do
         i) invalidation_at_future_value=${OPTARG};; 
         e) edge_buffer_size=${OPTARG};;  # Edge buffer size
         v) vertex_buffer_size=${OPTARG};;  # Vertex buffer size
+        b) hmb_base=${OPTARG};;  # HMB reserved memory address
+        s) hmb_size=${OPTARG};;  # HMB reserved memory size
+        V) hmb_num_vertices=${OPTARG};;  # HMB sized for this many vertices (default: fit hmb_size)
+        P) hmb_num_partitions=${OPTARG};;  # HMB sized for this many partitions
+        H) hmb_huge_pages=${OPTARG};;  # Map the HMB with huge pages (default: 1)
+        N) numa_placement=1;;  # Place each CSD's storage and threads on one NUMA node
+        M) numa_memmap_base=${OPTARG};;  # Per-node reserved memory base in GB, comma separated (with -N)
     esac
 done
 
@@ -43,16 +50,58 @@ memmap_start=()
 memmap_size=()
 cpus=()
 base_start_gb=128
-for ((i = 0; i < num_csds; i++)); do
-    start_gb=$((base_start_gb + i * memmap_size_gb))
-    memmap_start+=("${start_gb}G")
-    memmap_size+=("${memmap_size_gb}G")
-    
-    # Assign CPU pairs: (2i+1, 2i+2)
-    cpu1=$((2 * i + 1))
-    cpu2=$((2 * i + 2))
-    cpus+=("${cpu1},${cpu2}")
-done
+
+# Expand a sysfs cpulist (e.g. 0-3,8-11) into one CPU per line
+expand_cpulist() {
+    local range
+    for range in ${1//,/ }; do
+        seq ${range%-*} ${range#*-}
+    done
+}
+
+if [ -n "$numa_placement" ]; then
+    # CSD i lives on node i % nodes: its storage slice comes from the node's reserved
+    # memory (-M, one base per node) and its dispatcher and worker from the node's CPUs.
+    # The HMB stays one region (-b); reserve it on the node with the host threads.
+    num_nodes=$(ls -d /sys/devices/system/node/node[0-9]* | wc -l)
+    IFS=',' read -r -a node_base_gb <<< "$numa_memmap_base"
+    if [ ${#node_base_gb[@]} -lt $num_nodes ]; then
+        echo "-N needs a reserved memory base per NUMA node (-M), got ${#node_base_gb[@]} for $num_nodes nodes"
+        exit 1
+    fi
+    csds_per_node=$(((num_csds + num_nodes - 1) / num_nodes))
+    memmap_size_gb=$((total_mem_gb / num_csds))
+    node_cpus=()
+    for ((node = 0; node < num_nodes; node++)); do
+        # Skip CPU 0, as the default placement does
+        node_cpus[$node]=$(expand_cpulist "$(cat /sys/devices/system/node/node$node/cpulist)" | grep -vx 0 | tr '\n' ' ')
+    done
+    for ((i = 0; i < num_csds; i++)); do
+        node=$((i % num_nodes))
+        slot=$((i / num_nodes))
+        start_gb=$((node_base_gb[node] + slot * memmap_size_gb))
+        memmap_start+=("${start_gb}G")
+        memmap_size+=("${memmap_size_gb}G")
+
+        read -r -a list <<< "${node_cpus[$node]}"
+        if [ ${#list[@]} -lt $((2 * csds_per_node)) ]; then
+            echo "Node $node has ${#list[@]} CPUs, need $((2 * csds_per_node))"
+            exit 1
+        fi
+        cpus+=("${list[$((2 * slot))]},${list[$((2 * slot + 1))]}")
+    done
+else
+    for ((i = 0; i < num_csds; i++)); do
+        start_gb=$((base_start_gb + i * memmap_size_gb))
+        memmap_start+=("${start_gb}G")
+        memmap_size+=("${memmap_size_gb}G")
+
+        # Assign CPU pairs: (2i+1, 2i+2)
+        cpu1=$((2 * i + 1))
+        cpu2=$((2 * i + 2))
+        cpus+=("${cpu1},${cpu2}")
+    done
+fi
 
 # Output results
 echo "memmap_start=(${memmap_start[*]})"
@@ -67,7 +116,13 @@ for ID in $(seq 0 $((num_csds - 1))); do
     # Load HMB module before first nvmev module
     if [ $ID -eq 0 ]; then
         echo "Loading HMB kernel module..."
-        sudo insmod hmb/hmb.ko
+        hmb_params="num_csds=${num_csds}"
+        [ -n "$hmb_base" ] && hmb_params+=" hmb_base=$hmb_base"
+        [ -n "$hmb_size" ] && hmb_params+=" hmb_size=$hmb_size"
+        [ -n "$hmb_num_vertices" ] && hmb_params+=" num_vertices=$hmb_num_vertices"
+        [ -n "$hmb_num_partitions" ] && hmb_params+=" num_partitions=$hmb_num_partitions"
+        [ -n "$hmb_huge_pages" ] && hmb_params+=" huge_pages=$hmb_huge_pages"
+        sudo insmod hmb/hmb.ko $hmb_params
     fi
 
     # Construct optional parameters dynamically
@@ -17,6 +17,7 @@
 
 #include <linux/jiffies.h>
 #include <linux/random.h>
+#include <linux/topology.h>
 
 #include "nvmev.h"
 #include "dma.h"
@@ -24,6 +25,8 @@
 #include "core/queue.h"
 #include "core/csd_edge_buffer.h"
 #include "core/csd_vertex_buffer.h"
+#include "core/prefetch_planner.h"
+#include "core/prefetch_stream.h"
 #include "core/params.h"
 #include <hmb.h>
 
@@ -74,8 +77,8 @@ void get_integer_and_fraction(float x, int* integer_part, int* fraction_part)
 void print_vertex_info(int csd_id, int* outdegree, int u, int v)
 {
 	unsigned int i_src, f_src, i_dst, f_dst;
-	get_integer_and_fraction(hmb_dev.buf0.virt_addr[u], &i_src, &f_src);
-	get_integer_and_fraction(hmb_dev.buf1.virt_addr[v], &i_dst, &f_dst);
+	get_integer_and_fraction(hmb_value_buf(HMB_ROLE_CURR)[u], &i_src, &f_src);
+	get_integer_and_fraction(hmb_value_buf(HMB_ROLE_NEXT)[v], &i_dst, &f_dst);
 	NVMEV_INFO("[CSD %d] src_vtx[%d]: %u.%06u, outdegree[%d]: %d, dst_vtx[%d]: %u.%06u\n", csd_id, u, i_src, f_src, u, outdegree[u], v, i_dst, f_dst);
 }
 
@@ -91,7 +94,30 @@ unsigned short fast_pseudo_rand(unsigned int *state) {
 }
 
 
-void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
+// End of a run or controller reset: inline tasks need a new REGISTER_RUN
+void nvmev_run_unregister(void)
+{
+	nvmev_vdev->run_registered = false;
+	memset(&nvmev_vdev->run_params, 0, sizeof(nvmev_vdev->run_params));
+}
+
+// Bytes touched by the CSD thread, split by whether they came from its own NUMA node
+void nvmev_account_numa(unsigned long long storage_bytes, unsigned long long hmb_bytes)
+{
+	int node = numa_node_id();
+
+	if (nvmev_vdev->storage_node == NUMA_NO_NODE || nvmev_vdev->storage_node == node)
+		nvmev_vdev->numa_local_bytes += storage_bytes;
+	else
+		nvmev_vdev->numa_remote_bytes += storage_bytes;
+
+	if (nvmev_vdev->hmb_node == NUMA_NO_NODE || nvmev_vdev->hmb_node == node)
+		nvmev_vdev->numa_local_bytes += hmb_bytes;
+	else
+		nvmev_vdev->numa_remote_bytes += hmb_bytes;
+}
+
+void __proc_edge(struct PROC_EDGE task, float* dst, float* src, struct hmb_done_buffer *done)
 {
 	int csd_id = task.csd_id;
 	long long num_vertices = task.num_vertices;
@@ -103,21 +129,22 @@ void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
 	int* e_end = e + task.edge_block_len / VERTEX_SIZE;
 	
 	long long start_time, end_time;
-	long long hmb_offset, max_partition_offset;
-	int u = -1, v = -1, id;
+	long long hmb_offset, sum_stride, max_partition_offset;
+	int u = -1, v = -1;
 
 	// Update the maximum partition for hmb window
 	max_partition_offset = (long long)(task.num_csds + 2) * num_vertices + csd_id;
 	dst[max_partition_offset] = task.c;
 
 	// Process the edges
-	hmb_offset = (long long)(csd_id + 1) * num_vertices;
+	hmb_offset = partial_sum_base(task.sum_layout, num_vertices, csd_id);
+	sum_stride = partial_sum_stride(task.sum_layout, task.num_csds);
 	start_time = ktime_get_ns();
 	if(task.algorithm == 0){	
 		// Pagerank
 		for(; e < e_end; e += EDGE_SIZE / VERTEX_SIZE) {	
 			u = *e, v = *(e + 1);
-			dst[v + hmb_offset] += src[u] / outdegree[u];
+			dst[hmb_offset + v * sum_stride] += src[u] / outdegree[u];
 		}
 	}
 	else if(task.algorithm == 1){
@@ -128,8 +155,8 @@ void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
 			u = *e, v = *(e + 1);
 			freq_src[0] = (int)src[u] & 0xFFFF;
 			freq_src[1] = ((int)src[u] >> 16) & 0xFFFF;
-			freq_dst[0] = (int)dst[v + hmb_offset] & 0xFFFF;
-			freq_dst[1] = ((int)dst[v + hmb_offset] >> 16) & 0xFFFF;
+			freq_dst[0] = (int)dst[hmb_offset + v * sum_stride] & 0xFFFF;
+			freq_dst[1] = ((int)dst[hmb_offset + v * sum_stride] >> 16) & 0xFFFF;
 			if(freq_src[0] > freq_src[1]){
 				freq_dst[0]++;
 			}
@@ -142,7 +169,7 @@ void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
 				else
 					freq_dst[1]++;
 			}
-			dst[v + hmb_offset] = (float)(freq_dst[0] | (freq_dst[1] << 16));
+			dst[hmb_offset + v * sum_stride] = (float)(freq_dst[0] | (freq_dst[1] << 16));
 		}
 	}
 	else{
@@ -151,11 +178,15 @@ void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
 		for(; e < e_end; e += EDGE_SIZE / VERTEX_SIZE) {
 			u = *e, v = *(e + 1);
 			if(src[u] == 1 && fast_pseudo_rand(&state) < hash_edge(u, v))
-				dst[v + hmb_offset] = 1;
+				dst[hmb_offset + v * sum_stride] = 1;
 		}
 	}
 	end_time = ktime_get_ns();
 
+	// Per edge: the edge and outdegree[u] from storage, src[u] and a read-modify-write of the partial sum in the HMB
+	nvmev_account_numa(task.edge_block_len + task.edge_block_len / EDGE_SIZE * VERTEX_SIZE,
+			   task.edge_block_len / EDGE_SIZE * VERTEX_SIZE * 3);
+
 	// NVMEV_INFO("gg1: %x %x %x %lld", storage, outdegree, e_end, (long long)(csd_id + 1) * num_vertices);
 
 	// Compensation for MCU lower frequency
@@ -164,73 +195,25 @@ void __proc_edge(struct PROC_EDGE task, float* dst, float* src, bool* done)
 		if (kthread_should_stop())
 			return;
 		// For cost model
-		if(task.cost_modeling){
-			int i;
-			for(i = 0; i < MAX_PARTITION; i++){
-				if(edge_buf->aggr_start_time[i] != -1 && hmb_dev.done_partition.virt_addr[i]){
-					long long aggr_time = ktime_get_ns() - edge_buf->aggr_start_time[i];
-					edge_buf->ema_aggr = (long long) ((edge_buf->alpha_aggr * aggr_time) + (1.0 - edge_buf->alpha_aggr) * edge_buf->ema_aggr);
-					edge_buf->aggr_start_time[i] = -1;
-					NVMEV_INFO("CSD %d, Partition %d, Aggregation time: %lld ns, EMA: %lld ns", task.csd_id, i, aggr_time, edge_buf->ema_aggr);
-				}
-			}
-		}
+		if(task.cost_modeling)
+			aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
 	}
 	
 	// For task.csd_id, Edge task.r, task.c is finished
-	id = task.csd_id * task.num_partitions * task.num_partitions + task.r * task.num_partitions + task.c;
-	done[id] = 1;
+	hmb_set_done(done, task.csd_id, task.r, task.c, task.num_partitions);
 
 	// For cost model
 	if(task.cost_modeling){
 		if(!task.is_fvc){
-			if(task.iter == 0 && task.r == task.num_partitions - 1
-			|| task.iter != 0 && task.iter % 2 == 0 && task.r == task.c
-			|| task.iter != 0 && task.iter % 2 == 1 && task.r == task.num_partitions - 1){
+			if(traversal_is_column_end(&nvmev_vdev->traversal, task.iter, task.r, task.c)){
 				// Aggregation start
-				edge_buf->aggr_start_time[task.c] = ktime_get_ns();
+				aggr_tracker_start(&edge_buf->aggr, task.c);
 			}
 		}
 	}
 }
 
-long long prefetch_edge_block(struct edge_buffer *edge_buf, struct PROC_EDGE task_prefetch, long long* edge_proc_time, int is_prefetch)
-{
-	long long size_in_cache, size_in_cache_new, size_in_cache_old;
-	long long edge_io_time;
-	double ratio;
-
-	if(task_prefetch.edge_block_len == 0 || *edge_proc_time <= 0)
-		return 0;
-
-	size_in_cache = get_edge_block_size(edge_buf, task_prefetch.r, task_prefetch.c);
-	if(size_in_cache == task_prefetch.edge_block_len)
-		return 0;
-	if(size_in_cache == -1)
-		size_in_cache = 0;
-	
-	edge_io_time = task_prefetch.nsecs_target;
-	ratio = 1.0 * (*edge_proc_time) / edge_io_time;
-	if(ratio > 1.0) ratio = 1.0;
-
-	// NVMEV_INFO("Prefetching edge block %d-%d, size_in_cache: %lld, edge_block_len: %lld, edge_proc_time: %lld, edge_io_time: %lld",
-	// 	task_prefetch.r, task_prefetch.c, size_in_cache, task_prefetch.edge_block_len, *edge_proc_time, edge_io_time);
-	*edge_proc_time -= (long long) (edge_io_time * (1.0 * (task_prefetch.edge_block_len - size_in_cache) / task_prefetch.edge_block_len));
-
-	size_in_cache_old = size_in_cache;
-	size_in_cache = min(size_in_cache + (long long) (task_prefetch.edge_block_len * ratio), (long long)(task_prefetch.edge_block_len));
-	// NVMEV_INFO("After Prefetching edge block %d-%d, size_in_cache: %lld, edge_block_len: %lld, edge_proc_time: %lld, edge_io_time: %lld",
-	// 	task_prefetch.r, task_prefetch.c, size_in_cache, task_prefetch.edge_block_len, *edge_proc_time, edge_io_time);
-	access_edge_block(edge_buf, hmb_dev.done_partition.virt_addr, task_prefetch.r, task_prefetch.c, size_in_cache, is_prefetch);
-	
-	size_in_cache_new = get_edge_block_size(edge_buf, task_prefetch.r, task_prefetch.c);
-	if(size_in_cache_new == -1)
-		size_in_cache_new = 0;
-	edge_buf->prefetched_size = max(0, (size_in_cache_new - size_in_cache_old)) / PAGE_SIZE;
-	return edge_buf->prefetched_size;
-}
-
-bool find_next_future_task(struct queue *future_task_queue, bool* aggregated, struct PROC_EDGE *task, bool is_dequeue)
+bool find_next_future_task(struct queue *future_task_queue, unsigned long* aggregated, struct PROC_EDGE *task, bool is_dequeue)
 {
 	struct queue_node *node;
 	bool found = false;
@@ -248,7 +231,7 @@ bool find_next_future_task(struct queue *future_task_queue, bool* aggregated, st
 	else if(task->row_overlap == 1)
 	{
 		list_for_each_entry(node, &future_task_queue->head, list) {
-			if (aggregated[node->proc_edge_struct.r]) {
+			if (test_bit(node->proc_edge_struct.r, aggregated)) {
 				*task = node->proc_edge_struct;
 				found = true;
 				break;
@@ -258,7 +241,7 @@ bool find_next_future_task(struct queue *future_task_queue, bool* aggregated, st
 	else if(task->row_overlap == 2)
 	{
 		list_for_each_entry_reverse(node, &future_task_queue->head, list) {
-			if (aggregated[node->proc_edge_struct.r]) {
+			if (test_bit(node->proc_edge_struct.r, aggregated)) {
 				*task = node->proc_edge_struct;
 				found = true;
 				break;
@@ -284,12 +267,25 @@ bool find_next_future_task(struct queue *future_task_queue, bool* aggregated, st
 	return found;
 }
 
+// Reduce-scatter: reduce the columns this CSD owns as soon as every CSD completed them
+static void __reduce_scatter_poll(void)
+{
+	struct reduce_scatter *rs = &nvmev_vdev->reduce_scatter;
+	long long hmb_bytes = rs->hmb_bytes;
+
+	if (reduce_scatter_poll(rs))
+		nvmev_account_numa(0, rs->hmb_bytes - hmb_bytes);
+}
+
 void __do_perform_edge_proc(void)
 {
 	struct queue *normal_task_queue = &(nvmev_vdev->normal_task_queue);
 	struct queue *future_task_queue = &(nvmev_vdev->future_task_queue);
 	struct edge_buffer *edge_buf = &nvmev_vdev->edge_buf;
 	struct vertex_buffer *vertex_buf = &nvmev_vdev->vertex_buf;
+	struct prefetch_planner *planner = &nvmev_vdev->prefetch_planner;
+	struct prefetch_stream *stream = &nvmev_vdev->prefetch_stream;
+	struct traversal *trav = &nvmev_vdev->traversal;
 	extern int invalidation_at_future_value;
 
 	// Execution composition
@@ -304,24 +300,24 @@ void __do_perform_edge_proc(void)
 		if (kthread_should_stop())
 			return;
 
+		__reduce_scatter_poll();
+
 		if(get_queue_size(future_task_queue))
 		{
 			get_queue_front(future_task_queue, &task);
 			
 			// End of the iteration update
-			// Fake task for even and last iter
+			// Future copy of an even sentinel, fake task for odd and last iter
 			if(task.iter == task.num_iters
-			|| ((task.iter - 1) % 2 == 0 && task.r == task.num_partitions - 1)
-			|| ((task.iter - 1) % 2 == 1 && task.r == 0))
+			|| ((task.iter - 1) % 2 == 0 && traversal_is_sentinel(trav, task.iter - 1, task.r, task.c))
+			|| ((task.iter - 1) % 2 == 1 && task.r == traversal_last_column(trav, task.iter - 1)))
 			{
-				int csd_id;
-				long long num_vertices;
-				long long offset, v;
 				unsigned long timeout;
+				int last_column = traversal_last_column(trav, task.iter - 1);
 
 				// Waiting for last column aggregation end
 				timeout = jiffies + msecs_to_jiffies(60000); // 60 second timeout
-				while(!hmb_dev.done_partition.virt_addr[task.r]){
+				while(!test_bit(last_column, hmb_dev.done_partition.virt_addr)){
 					if (kthread_should_stop())
 						return;
 					// Check if we've timed out
@@ -329,6 +325,10 @@ void __do_perform_edge_proc(void)
 						pr_warn("Timeout waiting for aggregation completion\n");
 						break;
 					}
+					prefetch_stream_advance(stream, edge_buf, normal_task_queue, future_task_queue, hmb_dev.done_partition.virt_addr);
+					__reduce_scatter_poll();
+					if(task.cost_modeling)
+						aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
 					cpu_relax();
 					cond_resched();
 				}
@@ -338,12 +338,21 @@ void __do_perform_edge_proc(void)
 				// All normal task must be done --> swap normal queue and future queue
 				queue_swap(normal_task_queue, future_task_queue);
 				// NVMEV_INFO("CSD %d, %s, Swap queues, Queue sizes: %d, %d", task.csd_id, __func__, get_queue_size(normal_task_queue), get_queue_size(future_task_queue));
-				
+
+				// Run plan: generate the next iteration before the host rotates the epoch (done2 becomes done1)
+				if(nvmev_vdev->run_plan.active){
+					if(task.iter < task.num_iters)
+						run_plan_enqueue_iter(&nvmev_vdev->run_plan, normal_task_queue, task.iter, &hmb_dev.done2);
+					else
+						run_plan_destroy(&nvmev_vdev->run_plan);
+				}
+
 				// Ensuring all CSDs are ready for end-of-iter update to avoid race condition
-				hmb_dev.done_partition.virt_addr[task.num_partitions + task.csd_id + 1] = true;
+				set_bit(task.num_partitions + task.csd_id + 1, hmb_dev.done_partition.virt_addr);
+				hmb_notify();
 				
 				timeout = jiffies + msecs_to_jiffies(60000); // 60 second timeout
-				while(hmb_dev.done_partition.virt_addr[task.num_partitions + task.csd_id + 1]) {
+				while(test_bit(task.num_partitions + task.csd_id + 1, hmb_dev.done_partition.virt_addr)) {
 					if (kthread_should_stop())
 						return;
 					// Check if we've timed out
@@ -351,18 +360,15 @@ void __do_perform_edge_proc(void)
 						pr_warn("Timeout waiting for partition completion\n");
 						break;
 					}
+					prefetch_stream_advance(stream, edge_buf, normal_task_queue, future_task_queue, hmb_dev.done_partition.virt_addr);
+					__reduce_scatter_poll();
+					if(task.cost_modeling)
+						aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
 					cpu_relax();
 					cond_resched();
 				}
 
-				// End of iter vertices value update
-				csd_id = task.csd_id;
-				num_vertices = task.num_vertices;
-				offset = (task.csd_id + 1) * num_vertices;
-				for(v = 0; v < num_vertices; v++){
-				    hmb_dev.buf1.virt_addr[v + offset] = hmb_dev.buf2.virt_addr[v + offset];
-				    hmb_dev.buf2.virt_addr[v + offset] = 0.0;
-				}
+				// No copy of the partial sums here: the host rotated the value buffers, v_t+2 is now v_t+1 in place
 			}
 
 			// To use a row of edges that are aggregated to overlap
@@ -372,7 +378,7 @@ void __do_perform_edge_proc(void)
 				bool found = false;
 				mutex_lock(&future_task_queue->lock);
 				list_for_each_entry(node, &future_task_queue->head, list) {
-					if (hmb_dev.done_partition.virt_addr[node->proc_edge_struct.r]) {
+					if (test_bit(node->proc_edge_struct.r, hmb_dev.done_partition.virt_addr)) {
 						found = true;
 						break;
 					}
@@ -383,7 +389,7 @@ void __do_perform_edge_proc(void)
 				mutex_unlock(&future_task_queue->lock);
 			}
 			// Future task ready
-			future_aggr_ready = hmb_dev.done_partition.virt_addr[task.r];
+			future_aggr_ready = test_bit(task.r, hmb_dev.done_partition.virt_addr);
 		}
 		
 		if(future_aggr_ready && get_queue_size(future_task_queue))
@@ -400,25 +406,19 @@ void __do_perform_edge_proc(void)
 			// 	task.csd_id,
 			// 	edge_buf->prefetched_r, edge_buf->prefetched_c, edge_buf->prefetched_iter,
 			// 	task.r, task.c, task.iter);
-			if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c){
-				edge_buf->prefetch_block_hit_cnt++;
-				if(edge_buf->prefetched_priority != -1){
-					edge_buf->prefetch_block_hit_cnt_arr[edge_buf->prefetched_priority]++;
-				}
-			}
-			if(edge_buf->prefetched_r != -1 && edge_buf->prefetched_c != -1)
-				edge_buf->total_prefetch_block_cnt++;
+			prefetch_planner_on_task(planner, edge_buf, task);
 			
 			num_vertices = task.num_vertices;
 		
 		EXEC_START_TIME = ktime_get_ns();
-			__proc_edge(task, hmb_dev.buf2.virt_addr, hmb_dev.buf1.virt_addr, hmb_dev.done2.virt_addr);
+			__proc_edge(task, hmb_value_buf(HMB_ROLE_FUTURE), hmb_value_buf(HMB_ROLE_NEXT), &hmb_dev.done2);
 		EXEC_END_TIME = ktime_get_ns();
 		edge_buf->edge_proc_time += (EXEC_END_TIME - EXEC_START_TIME);	
 		edge_proc_time = EXEC_END_TIME - EXEC_START_TIME;
 			
 		EXEC_START_TIME = ktime_get_ns();
 			// Edge I/O
+			prefetch_stream_demand(stream, edge_buf, hmb_dev.done_partition.virt_addr, task);
 			size_not_in_cache = access_edge_block(edge_buf, hmb_dev.done_partition.virt_addr, task.r, task.c, task.edge_block_len, false);
 			if(invalidation_at_future_value){
         		invalidate_edge_block(edge_buf, task.r, task.c);
@@ -428,151 +428,18 @@ void __do_perform_edge_proc(void)
 			else
 				ratio = (1.0 * size_not_in_cache / task.edge_block_len);
 			
-			// Prefetch current edge block (Pipelining)
-			if(task.is_prefetching >= 1)
-			{
-				double pipeline_ratio, prefetch_ratio;
-
-				if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c)
-					edge_buf->prefetch_hit_cnt += edge_buf->prefetched_size;
-				edge_buf->total_prefetch_cnt += edge_buf->prefetched_size;
-				edge_buf->prefetched_size = 0;
-
-				if(task.nsecs_target == 0)
-					pipeline_ratio = 0;
-				else
-					pipeline_ratio = 1.0 * edge_proc_time / task.nsecs_target;
-
-				prefetch_ratio = pipeline_ratio - ratio;
-				if(prefetch_ratio < 0) prefetch_ratio = 0;
-
-				// edge_processing_time * ratio is the time that we can prefetch the current edge block
-				edge_buf->hit_cnt += min((long long) (pipeline_ratio * ratio * task.edge_block_len), size_not_in_cache) / PAGE_SIZE;
-				ratio -= pipeline_ratio;
-				if(ratio < 0) ratio = 0;
-					
-				// If the remaining edge_proc_time is not zero, we can prefetch the next edge block
-				if(task.is_prefetching >= 2)
-				{
-					long long tmp_edge_proc_time = (long long) (prefetch_ratio * task.nsecs_target);
-
-					edge_buf->prefetched_r = -1;
-					edge_buf->prefetched_c = -1;
-					edge_buf->prefetched_iter = -1;
-
-					if(tmp_edge_proc_time > 0){
-						struct PROC_EDGE next_task;
-						int found_cnt = 0;
-						if(get_queue_size(future_task_queue))
-						{	
-							// Executable future tasks
-							struct queue_node *node;
-							list_for_each_entry_reverse(node, &future_task_queue->head, list) {
-								if (hmb_dev.done_partition.virt_addr[node->proc_edge_struct.r]) {
-									next_task = node->proc_edge_struct;
-									edge_buf->prefetch_priority_cnt[2] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 1);
-									if(found_cnt == 0){
-										edge_buf->prefetched_r = next_task.r;
-										edge_buf->prefetched_c = next_task.c;
-										edge_buf->prefetched_iter = next_task.iter;
-										edge_buf->prefetch_block_cnt_arr[2]++;
-										edge_buf->prefetched_priority = 2;
-									}
-									found_cnt++;
-									if(tmp_edge_proc_time <= 0)
-										break;
-								}
-							}
-						}
-						if(tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
-						{
-							bool pr_reverse = false;
-							if(get_queue_size(future_task_queue)){
-								get_queue_front(normal_task_queue, &next_task);
-								// Already calculated edge_proc_time (passed)
-								if(!hmb_dev.done_partition.virt_addr[next_task.r]){
-									if(edge_buf->ema_aggr > 0 && (
-										ktime_get_ns() + task.nsecs_target * ratio > 
-										edge_buf->aggr_start_time[next_task.r] + edge_buf->ema_aggr))
-									{
-										// Priority 4 > 3
-										pr_reverse = true;
-										edge_buf->pr_reverse = true;
-									}
-								}
-							}
-							if(!pr_reverse){
-								// Normal tasks
-								get_queue_front(normal_task_queue, &next_task);
-
-								if(!(task.is_fvc && !next_task.is_fvc)){
-									edge_buf->prefetch_priority_cnt[3] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 2);
-									if(found_cnt == 0){
-										edge_buf->prefetched_r = next_task.r;
-										edge_buf->prefetched_c = next_task.c;
-										edge_buf->prefetched_iter = next_task.iter;
-										edge_buf->prefetch_block_cnt_arr[3]++;
-										edge_buf->prefetched_priority = 3;
-										found_cnt++;
-									}
-								}
-							}
-						}
-						if(tmp_edge_proc_time > 0 && get_queue_size(future_task_queue))
-						{
-							// Unexecutable future tasks
-							get_queue_front(future_task_queue, &next_task);
-							edge_buf->prefetch_priority_cnt[4] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 1);
-							if(found_cnt == 0){
-								edge_buf->prefetched_r = next_task.r;
-								edge_buf->prefetched_c = next_task.c;
-								edge_buf->prefetched_iter = next_task.iter;
-								edge_buf->prefetch_block_cnt_arr[4]++;
-								edge_buf->prefetched_priority = 4;
-								found_cnt++;
-							}
-						}
-
-						// Cost Model
-						edge_buf->pr_reverse = false;
-
-						if(tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
-						{
-							// Next iteration Normal tasks
-							get_queue_front(normal_task_queue, &next_task);
-							if(task.is_fvc && !next_task.is_fvc){
-								edge_buf->prefetch_priority_cnt[5] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 3);
-								if(found_cnt == 0){
-									edge_buf->prefetched_r = next_task.r;
-									edge_buf->prefetched_c = next_task.c;
-									edge_buf->prefetched_iter = next_task.iter;
-									edge_buf->prefetch_block_cnt_arr[5]++;
-									edge_buf->prefetched_priority = 5;
-									found_cnt++;
-								}
-							}
-						}
-					}
-				}
-			}
+			// Prefetch current edge block (Pipelining) and the next edge blocks
+			ratio = prefetch_planner_run(planner, edge_buf, normal_task_queue, future_task_queue, hmb_dev.done_partition.virt_addr,
+				task, edge_proc_time, size_not_in_cache, ratio);
 			
 			end_time = ktime_get_ns() + (long long) (task.nsecs_target * ratio);
-			NVMEV_INFO("[CSD %d, %s(), iter: %d]: Processing edge-block-%u-%u with time span %lld, Future. EMA: %lld", task.csd_id, __func__, task.iter, task.r, task.c, (long long) (task.nsecs_target * ratio), edge_buf->ema_aggr);
+			NVMEV_INFO("[CSD %d, %s(), iter: %d]: Processing edge-block-%u-%u with time span %lld, Future. EMA: %lld", task.csd_id, __func__, task.iter, task.r, task.c, (long long) (task.nsecs_target * ratio), edge_buf->aggr.ema);
 			while(ktime_get_ns() < end_time){
 				if (kthread_should_stop())
 					return;
 				// For cost model
-				if(task.cost_modeling){
-					int i;
-					for(i = 0; i < MAX_PARTITION; i++){
-						if(edge_buf->aggr_start_time[i] != -1 && hmb_dev.done_partition.virt_addr[i]){
-							long long aggr_time = ktime_get_ns() - edge_buf->aggr_start_time[i];
-							edge_buf->ema_aggr = (long long) ((edge_buf->alpha_aggr * aggr_time) + (1.0 - edge_buf->alpha_aggr) * edge_buf->ema_aggr);
-							edge_buf->aggr_start_time[i] = -1;
-							NVMEV_INFO("CSD %d, Partition %d, Aggregation time: %lld ns, EMA: %lld ns", task.csd_id, i, aggr_time, edge_buf->ema_aggr);
-						}
-					}
-				}
+				if(task.cost_modeling)
+					aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
 			}
 		EXEC_END_TIME = ktime_get_ns();
 		edge_buf->edge_internal_io_time += (EXEC_END_TIME - EXEC_START_TIME);
@@ -583,19 +450,18 @@ void __do_perform_edge_proc(void)
 				partition_size = 0;
 				NVMEV_INFO("Error: partition size is zero");
 			}
+			else if(task.block_placement == BLOCK_PLACEMENT_OWNED && task.edge_block_len == 0)
+				partition_size = 0;	// Block owned by another CSD, no source vertices to read
 			else
 				partition_size = (long long) num_vertices * VERTEX_SIZE / task.num_partitions;
 			size_not_in_cache = access_partition(vertex_buf, task.r, task.iter, partition_size);
 		EXEC_END_TIME = ktime_get_ns();
 		edge_buf->edge_external_io_time += (EXEC_END_TIME - EXEC_START_TIME);
 			
-			// Fake E_00 task: for even iter end of iteration
-			// If row_overlap, then the last normal task in even iter is E_10
-			if(task.iter % 2 == 0 && 
-				((task.row_overlap != 3 && task.r == task.num_partitions - 1 && task.c == 0)
-				|| (task.row_overlap == 3 && task.r == 1 && task.c == 0))
-			){
-				task.r = task.c = 0;
+			// Fake task: for even iter end of iteration, after the future copy of the odd sentinel
+			// (E_P-1,0, or E_10 with row_overlap 3, for the column-major traversal)
+			if(task.iter % 2 == 0 && traversal_is_sentinel(trav, task.iter - 1, task.r, task.c)){
+				task.r = task.c = traversal_last_column(trav, task.iter - 1);
 				queue_enqueue(future_task_queue, task);
 			}
 		}
@@ -611,28 +477,22 @@ void __do_perform_edge_proc(void)
 			// 	task.csd_id,
 			// 	edge_buf->prefetched_r, edge_buf->prefetched_c, edge_buf->prefetched_iter,
 			// 	task.r, task.c, task.iter);
-			if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c){
-				edge_buf->prefetch_block_hit_cnt++;
-				if(edge_buf->prefetched_priority != -1){
-					edge_buf->prefetch_block_hit_cnt_arr[edge_buf->prefetched_priority]++;
-				}
-			}
-			if(edge_buf->prefetched_r != -1 && edge_buf->prefetched_c != -1)
-				edge_buf->total_prefetch_block_cnt++;
+			prefetch_planner_on_task(planner, edge_buf, task);
 
 			num_vertices = task.num_vertices;
 
 		EXEC_START_TIME = ktime_get_ns();
-			__proc_edge(task, hmb_dev.buf1.virt_addr, hmb_dev.buf0.virt_addr, hmb_dev.done1.virt_addr);
+			__proc_edge(task, hmb_value_buf(HMB_ROLE_NEXT), hmb_value_buf(HMB_ROLE_CURR), &hmb_dev.done1);
 		EXEC_END_TIME = ktime_get_ns();
 		edge_buf->edge_proc_time += (EXEC_END_TIME - EXEC_START_TIME);	
 		edge_proc_time = EXEC_END_TIME - EXEC_START_TIME;
 		
 		EXEC_START_TIME = ktime_get_ns();
 			// Edge read I/O
+			prefetch_stream_demand(stream, edge_buf, hmb_dev.done_partition.virt_addr, task);
 			size_not_in_cache = access_edge_block(edge_buf, hmb_dev.done_partition.virt_addr, task.r, task.c, task.edge_block_len, false);
 			if(invalidation_at_future_value){
-        		if((task.iter == 0 && task.r > task.c) || task.is_fvc)	// lower triangle
+        		if((task.iter == 0 && !traversal_is_future(trav, 0, task.r, task.c)) || task.is_fvc)	// lower triangle
         			invalidate_edge_block(edge_buf, task.r, task.c);
 			}
 			if(task.edge_block_len == 0)
@@ -640,149 +500,19 @@ void __do_perform_edge_proc(void)
 			else
 				ratio = (1.0 * size_not_in_cache / task.edge_block_len);
 
-			// Prefetch current edge block (Pipelining)
-			if(task.is_prefetching >= 1)
-			{
-				double pipeline_ratio, prefetch_ratio;
-
-				if(edge_buf->prefetched_r == task.r && edge_buf->prefetched_c == task.c)
-					edge_buf->prefetch_hit_cnt += edge_buf->prefetched_size;
-				edge_buf->total_prefetch_cnt += edge_buf->prefetched_size;
-				edge_buf->prefetched_size = 0;
-
-				if(task.nsecs_target == 0)
-					pipeline_ratio = 0;
-				else
-					pipeline_ratio = 1.0 * edge_proc_time / task.nsecs_target;
-
-				prefetch_ratio = pipeline_ratio - ratio;
-				if(prefetch_ratio < 0) prefetch_ratio = 0;
-
-				edge_buf->hit_cnt += min((long long) (pipeline_ratio * ratio * task.edge_block_len), size_not_in_cache) / PAGE_SIZE;
-				ratio -= pipeline_ratio;
-				if(ratio < 0) ratio = 0;
-					
-				// If the remaining edge_proc_time is not zero, we can prefetch the next edge block
-				if(task.is_prefetching >= 2){
-					long long tmp_edge_proc_time = (long long) prefetch_ratio * task.nsecs_target;
-					edge_buf->prefetched_r = -1;
-					edge_buf->prefetched_c = -1;
-					edge_buf->prefetched_iter = -1;
-					if(tmp_edge_proc_time > 0){
-						struct PROC_EDGE next_task;
-						int found_cnt = 0;
-						if(get_queue_size(future_task_queue))
-						{	
-							// Executable future tasks
-							struct queue_node *node;
-							list_for_each_entry_reverse(node, &future_task_queue->head, list) {
-								if (hmb_dev.done_partition.virt_addr[node->proc_edge_struct.r]) {
-									next_task = node->proc_edge_struct;
-									edge_buf->prefetch_priority_cnt[2] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 1);
-									if(found_cnt == 0){
-										edge_buf->prefetched_r = next_task.r;
-										edge_buf->prefetched_c = next_task.c;
-										edge_buf->prefetched_iter = next_task.iter;
-										edge_buf->prefetch_block_cnt_arr[2]++;
-										edge_buf->prefetched_priority = 2;
-									}
-									found_cnt++;
-									if(tmp_edge_proc_time <= 0)
-										break;
-								}
-							}
-						}
-						if(tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
-						{
-							bool pr_reverse = false;
-							if(get_queue_size(future_task_queue)){
-								get_queue_front(normal_task_queue, &next_task);
-								// Already calculated edge_proc_time (passed)
-								if(!hmb_dev.done_partition.virt_addr[next_task.r]){
-									if(edge_buf->ema_aggr > 0 && (
-										ktime_get_ns() + task.nsecs_target * ratio > 
-										edge_buf->aggr_start_time[next_task.r] + edge_buf->ema_aggr))
-									{
-										// Priority 4 > 3
-										pr_reverse = true;
-										edge_buf->pr_reverse = true;
-									}
-								}
-							}
-							if(!pr_reverse){
-								// Normal tasks
-								get_queue_front(normal_task_queue, &next_task);
-
-								if(!(task.is_fvc && !next_task.is_fvc)){
-									edge_buf->prefetch_priority_cnt[3] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 2);
-									if(found_cnt == 0){
-										edge_buf->prefetched_r = next_task.r;
-										edge_buf->prefetched_c = next_task.c;
-										edge_buf->prefetched_iter = next_task.iter;
-										edge_buf->prefetch_block_cnt_arr[3]++;
-										edge_buf->prefetched_priority = 3;
-										found_cnt++;
-									}
-								}
-							}
-						}
-						if(tmp_edge_proc_time > 0 && get_queue_size(future_task_queue))
-						{
-							// Unexecutable future tasks
-							get_queue_front(future_task_queue, &next_task);
-							edge_buf->prefetch_priority_cnt[4] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 1);
-							if(found_cnt == 0){
-								edge_buf->prefetched_r = next_task.r;
-								edge_buf->prefetched_c = next_task.c;
-								edge_buf->prefetched_iter = next_task.iter;
-								edge_buf->prefetch_block_cnt_arr[4]++;
-								edge_buf->prefetched_priority = 4;
-								found_cnt++;
-							}
-						}
-
-						// Cost Model
-						edge_buf->pr_reverse = false;
-
-						if(tmp_edge_proc_time > 0 && get_queue_size(normal_task_queue))
-						{
-							// Next iteration Normal tasks
-							get_queue_front(normal_task_queue, &next_task);
-
-							if(task.is_fvc && !next_task.is_fvc){
-								edge_buf->prefetch_priority_cnt[5] += prefetch_edge_block(edge_buf, next_task, &tmp_edge_proc_time, 3);
-								if(found_cnt == 0){
-									edge_buf->prefetched_r = next_task.r;
-									edge_buf->prefetched_c = next_task.c;
-									edge_buf->prefetched_iter = next_task.iter;
-									edge_buf->prefetch_block_cnt_arr[5]++;
-									edge_buf->prefetched_priority = 5;
-									found_cnt++;
-								}
-							}
-						}
-					}
-				}
-			}
+			// Prefetch current edge block (Pipelining) and the next edge blocks
+			ratio = prefetch_planner_run(planner, edge_buf, normal_task_queue, future_task_queue, hmb_dev.done_partition.virt_addr,
+				task, edge_proc_time, size_not_in_cache, ratio);
 			
 			end_time = ktime_get_ns() + (long long) (task.nsecs_target * ratio);
 
-			NVMEV_INFO("[CSD %d, %s(), iter: %d]: Processing edge-block-%u-%u with time span %lld, Normal. EMA: %lld", task.csd_id, __func__, task.iter, task.r, task.c, (long long) (task.nsecs_target * ratio), edge_buf->ema_aggr);
+			NVMEV_INFO("[CSD %d, %s(), iter: %d]: Processing edge-block-%u-%u with time span %lld, Normal. EMA: %lld", task.csd_id, __func__, task.iter, task.r, task.c, (long long) (task.nsecs_target * ratio), edge_buf->aggr.ema);
 			while(ktime_get_ns() < end_time){
 				if (kthread_should_stop())
 					return;
 				// For cost model
-				if(task.cost_modeling){
-					int i;
-					for(i = 0; i < MAX_PARTITION; i++){
-						if(edge_buf->aggr_start_time[i] != -1 && hmb_dev.done_partition.virt_addr[i]){
-							long long aggr_time = ktime_get_ns() - edge_buf->aggr_start_time[i];
-							edge_buf->ema_aggr = (long long) ((edge_buf->alpha_aggr * aggr_time) + (1.0 - edge_buf->alpha_aggr) * edge_buf->ema_aggr);
-							edge_buf->aggr_start_time[i] = -1;
-							NVMEV_INFO("CSD %d, Partition %d, Aggregation time: %lld ns, EMA: %lld ns", task.csd_id, i, aggr_time, edge_buf->ema_aggr);
-						}
-					}
-				}
+				if(task.cost_modeling)
+					aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
 			}
 		EXEC_END_TIME = ktime_get_ns();
 		edge_buf->edge_internal_io_time += (EXEC_END_TIME - EXEC_START_TIME);
@@ -793,6 +523,8 @@ void __do_perform_edge_proc(void)
 				partition_size = 0;
 				NVMEV_INFO("Error: partition size is zero");
 			}
+			else if(task.block_placement == BLOCK_PLACEMENT_OWNED && task.edge_block_len == 0)
+				partition_size = 0;	// Block owned by another CSD, no source vertices to read
 			else
 				partition_size = (long long) num_vertices * VERTEX_SIZE / task.num_partitions;
 			size_not_in_cache = access_partition(vertex_buf, task.r, task.iter, partition_size);
@@ -806,32 +538,26 @@ void __do_perform_edge_proc(void)
 		edge_buf->edge_external_io_time += (EXEC_END_TIME - EXEC_START_TIME);
 			
 			// Insert to future task queue
-			if(task.iter != task.num_iters - 1 &&
-			((task.iter % 2 == 0 && task.r <= task.c) || (task.iter % 2 == 1 && task.r > task.c))){
+			if(task.iter != task.num_iters - 1 && traversal_is_future(trav, task.iter, task.r, task.c)){
 				task.iter++;
 				task.is_fvc = true;
 				queue_enqueue(future_task_queue, task);
 			}
 
-			// Fake E_00 task: for last iter end of iteration
-			if(task.iter == task.num_iters - 1){
-				// To wait for the aggregation of P[num_partitions - 1]
-				if(task.iter % 2 == 0 && task.r == task.num_partitions - 1 && task.c == task.num_partitions - 1){
-					task.r = task.c = task.num_partitions - 1;
-					task.iter++;
-					queue_enqueue(future_task_queue, task);
-				}
-				// To wait for the aggregation of P[0]
-				else if(task.iter % 2 == 1 && 
-					((task.row_overlap != 3 && task.r == task.num_partitions - 1 && task.c == 0)
-					|| (task.row_overlap == 3 && task.r == 1 && task.c == 0)))
-				{
-					task.r = task.c = 0;
-					task.iter++;
-					queue_enqueue(future_task_queue, task);
-				}
+			// Fake task: for last iter end of iteration, to wait for the aggregation of its last column
+			if(task.iter == task.num_iters - 1 && traversal_is_sentinel(trav, task.iter, task.r, task.c)){
+				task.r = task.c = traversal_last_column(trav, task.iter);
+				task.iter++;
+				queue_enqueue(future_task_queue, task);
 			}
 		}
+		else
+		{
+			// No executable task: the compute thread waits for aggregation
+			prefetch_stream_advance(stream, edge_buf, normal_task_queue, future_task_queue, hmb_dev.done_partition.virt_addr);
+			if(task.cost_modeling)
+				aggr_tracker_poll(&edge_buf->aggr, hmb_dev.done_partition.virt_addr, task.csd_id);
+		}
 	}
 }
 
@@ -1380,6 +1106,7 @@ static int nvmev_io_worker(void *data)
 
 		// Edge Processing: normal and future queue
 		__do_perform_edge_proc();
+		__reduce_scatter_poll();
 
 		while (curr != -1) {
 			struct nvmev_io_work *w = &worker->work_queue[curr];
@@ -1526,6 +1253,12 @@ void NVMEV_IO_WORKER_INIT(struct nvmev_dev *nvmev_vdev)
 		worker->task_struct = kthread_create(nvmev_io_worker, worker, "%s", worker->thread_name);
 
 		kthread_bind(worker->task_struct, nvmev_vdev->config.cpu_nr_io_workers[worker_id]);
+		if (nvmev_vdev->storage_node != NUMA_NO_NODE &&
+		    cpu_to_node(nvmev_vdev->config.cpu_nr_io_workers[worker_id]) != nvmev_vdev->storage_node)
+			NVMEV_INFO("%s on cpu %d (node %d) is remote to its storage (node %d)\n",
+				   worker->thread_name, nvmev_vdev->config.cpu_nr_io_workers[worker_id],
+				   cpu_to_node(nvmev_vdev->config.cpu_nr_io_workers[worker_id]),
+				   nvmev_vdev->storage_node);
 		wake_up_process(worker->task_struct);
 	}
 }
@@ -27,6 +27,7 @@
 #include "core/queue.h"
 #include "core/csd_edge_buffer.h"
 #include "core/params.h"
+#include <hmb.h>
 
 /****************************************************************
  * Memory Layout
@@ -87,6 +88,9 @@ int partial_edge_eviction = false;
 int invalidation_at_future_value = false;
 unsigned long edge_buffer_size = __LONG_MAX__;
 unsigned long vertex_buffer_size = __LONG_MAX__;
+int prefetch_lookahead = 1;
+unsigned long prefetch_budget = 0;
+int background_prefetch = false;
 
 int io_using_dma = false;
 
@@ -133,6 +137,12 @@ module_param(partial_edge_eviction, uint, 0444);
 module_param(invalidation_at_future_value, uint, 0444);
 module_param_cb(edge_buffer_size, &ops_parse_mem_param, &edge_buffer_size, 0444);
 module_param_cb(vertex_buffer_size, &ops_parse_mem_param, &vertex_buffer_size, 0444);
+module_param(prefetch_lookahead, int, 0444);
+MODULE_PARM_DESC(prefetch_lookahead, "Prefetch candidates per priority class (1: fixed priority ladder)");
+module_param_cb(prefetch_budget, &ops_parse_mem_param, &prefetch_budget, 0444);
+MODULE_PARM_DESC(prefetch_budget, "Prefetch bytes per edge task (0: bounded by the edge processing time only)");
+module_param(background_prefetch, uint, 0444);
+MODULE_PARM_DESC(background_prefetch, "Prefetch edge blocks in the background while waiting for aggregation");
 
 // Returns true if an event is processed
 static bool nvmev_proc_dbs(void)
@@ -216,8 +226,14 @@ static void NVMEV_DISPATCHER_INIT(struct nvmev_dev *nvmev_vdev)
 	// Graph  processing
 	queue_init(&(nvmev_vdev->normal_task_queue));
 	queue_init(&(nvmev_vdev->future_task_queue));
+	run_plan_init(&(nvmev_vdev->run_plan));
 	edge_buffer_init(&(nvmev_vdev->edge_buf));
 	vertex_buffer_init(&(nvmev_vdev->vertex_buf));
+	prefetch_planner_init(&(nvmev_vdev->prefetch_planner));
+	prefetch_stream_init(&(nvmev_vdev->prefetch_stream));
+	reduce_scatter_init(&(nvmev_vdev->reduce_scatter));
+	traversal_init(&(nvmev_vdev->traversal), TRAVERSAL_COLUMN, 1, 0);
+	nvmev_run_unregister();
 
 	nvmev_vdev->nvmev_dispatcher = kthread_create(nvmev_dispatcher, NULL, "nvmev_dispatcher");
 	if (nvmev_vdev->config.cpu_nr_dispatcher != -1)
@@ -230,6 +246,7 @@ static void NVMEV_DISPATCHER_FINAL(struct nvmev_dev *nvmev_vdev)
 	// Graph processing
 	queue_destroy(&(nvmev_vdev->normal_task_queue));
 	queue_destroy(&(nvmev_vdev->future_task_queue));
+	run_plan_destroy(&(nvmev_vdev->run_plan));
 	edge_buffer_destroy(&(nvmev_vdev->edge_buf));
 	vertex_buffer_destroy(&(nvmev_vdev->vertex_buf));
 
@@ -459,6 +476,33 @@ static const struct file_operations proc_file_fops = {
 };
 #endif
 
+// Home node of a physical address; memmap-reserved ranges are not in the memory map
+static int __phys_to_node(phys_addr_t addr)
+{
+#ifdef CONFIG_NUMA
+	if (pfn_valid(PHYS_PFN(addr)))
+		return pfn_to_nid(PHYS_PFN(addr));
+	return phys_to_target_node(addr);
+#else
+	return NUMA_NO_NODE;
+#endif
+}
+
+static void NVMEV_NUMA_INIT(struct nvmev_dev *nvmev_vdev)
+{
+	int dispatcher_node = cpu_to_node(nvmev_vdev->config.cpu_nr_dispatcher);
+
+	nvmev_vdev->storage_node = __phys_to_node(nvmev_vdev->config.storage_start);
+	nvmev_vdev->hmb_node = __phys_to_node(hmb_dev.buf0.phys_addr);
+	nvmev_vdev->numa_local_bytes = nvmev_vdev->numa_remote_bytes = 0;
+
+	NVMEV_INFO("NUMA: storage node %d, HMB node %d, dispatcher node %d\n",
+		   nvmev_vdev->storage_node, nvmev_vdev->hmb_node, dispatcher_node);
+	if (nvmev_vdev->storage_node != NUMA_NO_NODE && dispatcher_node != nvmev_vdev->storage_node)
+		NVMEV_INFO("Dispatcher cpu %d is remote to the storage, check the cpus parameter\n",
+			   nvmev_vdev->config.cpu_nr_dispatcher);
+}
+
 static void NVMEV_STORAGE_INIT(struct nvmev_dev *nvmev_vdev)
 {
 	NVMEV_INFO("Storage: %#010lx-%#010lx (%lu MiB)\n",
@@ -655,6 +699,7 @@ static int NVMeV_init(void)
 	}
 
 	NVMEV_STORAGE_INIT(nvmev_vdev);
+	NVMEV_NUMA_INIT(nvmev_vdev);
 
 	NVMEV_NAMESPACE_INIT(nvmev_vdev);
 
@@ -11,6 +11,11 @@
 #include "core/queue.h"
 #include "core/csd_edge_buffer.h"
 #include "core/csd_vertex_buffer.h"
+#include "core/run_plan.h"
+#include "core/prefetch_planner.h"
+#include "core/prefetch_stream.h"
+#include "core/reduce_scatter.h"
+#include "core/traversal.h"
 
 #define CONFIG_NVMEV_IO_WORKER_BY_SQ
 #undef CONFIG_NVMEV_FAST_X86_IRQ_HANDLING
@@ -230,6 +235,13 @@ struct nvmev_dev {
 
 	void *storage_mapped;
 
+	// NUMA placement: home node of the storage slice and the HMB, and the
+	// bytes the CSD threads moved from their own node vs. a remote node
+	int storage_node;
+	int hmb_node;
+	unsigned long long numa_local_bytes;
+	unsigned long long numa_remote_bytes;
+
 	struct nvmev_io_worker *io_workers;
 	unsigned int io_worker_turn;
 
@@ -255,10 +267,17 @@ struct nvmev_dev {
 	// Graph Processing: Task Queues (edge blocks)
 	struct queue normal_task_queue;
 	struct queue future_task_queue;
+	struct run_plan run_plan;
+	struct PROC_EDGE run_params;	// Static fields of the inline tasks, from REGISTER_RUN
+	bool run_registered;
 
 	// CSD DRAM
 	struct edge_buffer edge_buf;
 	struct vertex_buffer vertex_buf;
+	struct prefetch_planner prefetch_planner;
+	struct prefetch_stream prefetch_stream;
+	struct reduce_scatter reduce_scatter;
+	struct traversal traversal;	// Block order of the dual queue run
 
 	unsigned int mdts;
 
@@ -330,5 +349,7 @@ void NVMEV_IO_WORKER_INIT(struct nvmev_dev *nvmev_vdev);
 void NVMEV_IO_WORKER_FINAL(struct nvmev_dev *nvmev_vdev);
 int nvmev_proc_io_sq(int qid, int new_db, int old_db);
 void nvmev_proc_io_cq(int qid, int new_db, int old_db);
+void nvmev_account_numa(unsigned long long storage_bytes, unsigned long long hmb_bytes);
+void nvmev_run_unregister(void);
 
 #endif /* _LIB_NVMEV_H */
@@ -239,6 +239,7 @@ bool nvmev_proc_bars(void)
 			}
 		} else if (bar->cc.en == 0) {
 			bar->csts.rdy = 0;
+			nvmev_run_unregister();
 		}
 
 		/* Shutdown */
@@ -0,0 +1,123 @@
+#!/bin/bash
+
+# Runs the experiments of a spec file, reloading the modules only when their parameters change.
+#
+# Ex: bash run_experiments.sh experiments.spec
+#     bash run_experiments.sh experiments.spec experiments/row_overlap
+#
+# Spec: one experiment per line, "defaults" lines set keys for the lines below them, '#' starts a comment.
+# A comma separated value runs every value, several of them every combination:
+#     defaults dataset=LiveJournal.pl csds=8 algorithm=PR iters=10 reps=5 warmup=1
+#     run mode=dq prefetch=0,2 row_overlap=0,2 edge_buffer=100M,1G
+#
+# Keys:
+#   modules (init_csds.sh): csds, cache_policy, partial_edge_eviction, invalidation, edge_buffer, vertex_buffer,
+#                           hmb_size, hmb_huge_pages
+#   host (init_csd_edge):   dataset, algorithm, iters, mode (normal, grafu, balanced, dq, planned), prefetch,
+#                           row_overlap, reps, warmup, traversal, placement, sum_layout, reduce_scatter, cost_model,
+#                           aggregation_time, aggr_threads, spin, reload, verify (host reference threads)
+#
+# Results go to <output>.csv (a row per measured run, with its time breakdown), <output>.json (mean, p50
+# and p99 of every configuration) and <output>.log (the program output). The label of a row holds the
+# whole configuration, module parameters included.
+
+spec=$1
+if [ -z "$spec" ] || [ ! -f "$spec" ]; then
+    echo "usage: bash run_experiments.sh <spec> [output prefix]"
+    exit 1
+fi
+output=${2:-experiments/$(basename "${spec%.*}")}
+mkdir -p "$(dirname "$output")"
+
+module_keys="csds cache_policy partial_edge_eviction invalidation edge_buffer vertex_buffer hmb_size hmb_huge_pages"
+knob_keys="traversal placement sum_layout reduce_scatter cost_model aggregation_time aggr_threads spin reload verify"
+
+cd user
+make || exit
+cd ..
+
+loaded=""
+declare -A defaults
+
+# One configuration, "key=value ..." without lists
+run_config() {
+    declare -A cfg=([csds]=4 [algorithm]=PR [iters]=10 [mode]=dq [prefetch]=2 [row_overlap]=2 [reps]=1 [warmup]=0)
+    local kv key modules="" args=()
+
+    for kv in $1; do
+        cfg[${kv%%=*}]=${kv#*=}
+    done
+    if [ -z "${cfg[dataset]}" ]; then
+        echo "No dataset in: $1"
+        return 1
+    fi
+
+    for key in $module_keys; do
+        [ -n "${cfg[$key]}" ] && modules+=" $key=${cfg[$key]}"
+    done
+    if [ "$modules" != "$loaded" ]; then
+        local opts=(-n "${cfg[csds]}")
+        [ -n "${cfg[cache_policy]}" ] && opts+=(-c "${cfg[cache_policy]}")
+        [ -n "${cfg[partial_edge_eviction]}" ] && opts+=(-p "${cfg[partial_edge_eviction]}")
+        [ -n "${cfg[invalidation]}" ] && opts+=(-i "${cfg[invalidation]}")
+        [ -n "${cfg[edge_buffer]}" ] && opts+=(-e "${cfg[edge_buffer]}")
+        [ -n "${cfg[vertex_buffer]}" ] && opts+=(-v "${cfg[vertex_buffer]}")
+        [ -n "${cfg[hmb_size]}" ] && opts+=(-s "${cfg[hmb_size]}")
+        [ -n "${cfg[hmb_huge_pages]}" ] && opts+=(-H "${cfg[hmb_huge_pages]}")
+        echo "Loading modules:$modules"
+        bash init_csds.sh "${opts[@]}" < /dev/null >> "$output.log" 2>&1 || return 1
+        loaded=$modules
+    fi
+
+    for key in $knob_keys; do
+        [ -n "${cfg[$key]}" ] && args+=(-s "$key=${cfg[$key]}")
+    done
+    echo "Running: $1"
+    echo "=== $1" >> "$output.log"
+    sudo ./user/init_csd_edge -m "${cfg[mode]}" -f "${cfg[prefetch]}" -r "${cfg[row_overlap]}" \
+        -n "${cfg[reps]}" -w "${cfg[warmup]}" -o "$output" -l "$1" "${args[@]}" \
+        "${cfg[dataset]}" "${cfg[csds]}" "${cfg[algorithm]}" "${cfg[iters]}" < /dev/null >> "$output.log" 2>&1
+}
+
+# Every combination of the comma separated values, $1 the keys expanded so far
+expand() {
+    local done=$1 kv values v
+    shift
+    if [ $# -eq 0 ]; then
+        run_config "${done# }"
+        return
+    fi
+    kv=$1
+    shift
+    values=${kv#*=}
+    for v in ${values//,/ }; do
+        expand "$done ${kv%%=*}=$v" "$@"
+    done
+}
+
+while read -r kind rest; do
+    case "$kind" in
+        ""|\#*) continue;;
+        defaults)
+            for kv in $rest; do
+                defaults[${kv%%=*}]=${kv#*=}
+            done;;
+        run)
+            declare -A line=()
+            for kv in $rest; do
+                line[${kv%%=*}]=${kv#*=}
+            done
+            # Keys in sorted order, so a configuration always gets the same label
+            pairs=()
+            for key in $(printf '%s\n' "${!defaults[@]}" "${!line[@]}" | sort -u); do
+                pairs+=("$key=${line[$key]-${defaults[$key]}}")
+            done
+            unset line
+            expand "" "${pairs[@]}";;
+        *)
+            echo "Unknown spec line: $kind $rest"
+            exit 1;;
+    esac
+done < "$spec"
+
+bash clean_csds.sh
@@ -133,17 +133,18 @@ void __do_perform_edge_proc_grafu(struct PROC_EDGE task)
 	int* e_end = e + task.edge_block_len / VERTEX_SIZE;
 
 	// Initialize vertex source and destination addresses
-	int u = -1, v = -1, id;
+	int u = -1, v = -1;
 	float *dst, *src;
-	long long hmb_offset = (long long)(csd_id + 1) * num_vertices;
+	long long hmb_offset = partial_sum_base(task.sum_layout, num_vertices, csd_id);
+	long long sum_stride = partial_sum_stride(task.sum_layout, task.num_csds);
 
 	long long start_time, end_time, size_not_in_cache;
 	double ratio;
 	long long partition_size;
 
 EXEC_START_TIME = ktime_get_ns();
-	// Edge block read I/O
-	size_not_in_cache = access_edge_block(edge_buf, hmb_dev.done_partition.virt_addr, task.r, task.c, task.edge_block_len, false);
+	// Edge block read I/O, chunks of the same block are cached separately
+	size_not_in_cache = access_edge_block(edge_buf, hmb_dev.done_partition.virt_addr, task.r, task.c + task.chunk * task.num_partitions, task.edge_block_len, false);
 	ratio = task.edge_block_len == 0 ? 1 : (1.0 * size_not_in_cache / task.edge_block_len);
 	end_time = ktime_get_ns() + (long long) (task.nsecs_target * ratio);
 	// NVMEV_INFO("Edge-%d-%d I/O time: %lld", task.r, task.c, (long long) (task.nsecs_target * ratio));
@@ -171,12 +172,12 @@ edge_buf->edge_external_io_time += (EXEC_END_TIME - EXEC_START_TIME);
 
 	// Initialize vertex source and destination addresses
 	if(task.is_fvc == 0){
-		dst = hmb_dev.buf1.virt_addr;
-		src = hmb_dev.buf0.virt_addr;
+		dst = hmb_value_buf(HMB_ROLE_NEXT);
+		src = hmb_value_buf(HMB_ROLE_CURR);
 	}
 	else{
-		dst = hmb_dev.buf2.virt_addr;
-		src = hmb_dev.buf1.virt_addr;
+		dst = hmb_value_buf(HMB_ROLE_FUTURE);
+		src = hmb_value_buf(HMB_ROLE_NEXT);
 	}
 
 EXEC_START_TIME = ktime_get_ns();
@@ -186,7 +187,7 @@ EXEC_START_TIME = ktime_get_ns();
 		// Pagerank
 		for(; e < e_end; e += EDGE_SIZE / VERTEX_SIZE) {	
 			u = *e, v = *(e + 1);
-			dst[v + hmb_offset] += src[u] / outdegree[u];
+			dst[hmb_offset + v * sum_stride] += src[u] / outdegree[u];
 		}
 	}
 	else if(task.algorithm == 1){
@@ -197,8 +198,8 @@ EXEC_START_TIME = ktime_get_ns();
 			u = *e, v = *(e + 1);
 			freq_src[0] = (int)src[u] & 0xFFFF;
 			freq_src[1] = ((int)src[u] >> 16) & 0xFFFF;
-			freq_dst[0] = (int)dst[v + hmb_offset] & 0xFFFF;
-			freq_dst[1] = ((int)dst[v + hmb_offset] >> 16) & 0xFFFF;
+			freq_dst[0] = (int)dst[hmb_offset + v * sum_stride] & 0xFFFF;
+			freq_dst[1] = ((int)dst[hmb_offset + v * sum_stride] >> 16) & 0xFFFF;
 			if(freq_src[0] > freq_src[1]){
 				freq_dst[0]++;
 			}
@@ -211,7 +212,7 @@ EXEC_START_TIME = ktime_get_ns();
 				else
 					freq_dst[1]++;
 			}
-			dst[v + hmb_offset] = (float)(freq_dst[0] | (freq_dst[1] << 16));
+			dst[hmb_offset + v * sum_stride] = (float)(freq_dst[0] | (freq_dst[1] << 16));
 		}
 	}
 	else{
@@ -220,11 +221,14 @@ EXEC_START_TIME = ktime_get_ns();
 		for(; e < e_end; e += EDGE_SIZE / VERTEX_SIZE) {
 			u = *e, v = *(e + 1);
 			if(src[u] == 1 && fast_pseudo_rand1(&state) < hash_edge1(u, v))
-				dst[v + hmb_offset] = 1;
+				dst[hmb_offset + v * sum_stride] = 1;
 		}
 	}
 	end_time = ktime_get_ns();
 
+	nvmev_account_numa(task.edge_block_len + task.edge_block_len / EDGE_SIZE * VERTEX_SIZE,
+			   task.edge_block_len / EDGE_SIZE * VERTEX_SIZE * 3);
+
 	// Compensation for MCU lower frequency
 	end_time = end_time + (end_time - start_time) * (CPU_MCU_SPEED_RATIO - 1);
 	while(ktime_get_ns() < end_time){
@@ -236,11 +240,19 @@ EXEC_START_TIME = ktime_get_ns();
 EXEC_END_TIME = ktime_get_ns();
 edge_buf->edge_proc_time += (EXEC_END_TIME - EXEC_START_TIME);	
 
-	id = task.csd_id * task.num_partitions * task.num_partitions + task.r * task.num_partitions + task.c;
 	if(task.is_fvc == 0)
-		hmb_dev.done1.virt_addr[id] = true;
+		hmb_set_done(&hmb_dev.done1, task.csd_id, task.r, task.c, task.num_partitions);
 	else
-		hmb_dev.done2.virt_addr[id] = true;
+		hmb_set_done(&hmb_dev.done2, task.csd_id, task.r, task.c, task.num_partitions);
+}
+
+// Every task of a run carries the traversal, rebuild its tables when a run changes it
+static void __traversal_start(struct PROC_EDGE task)
+{
+	struct traversal *trav = &(nvmev_vdev->traversal);
+
+	if(trav->order != task.traversal || trav->num_partitions != task.num_partitions || trav->row_overlap != task.row_overlap)
+		traversal_init(trav, task.traversal, task.num_partitions, task.row_overlap);
 }
 
 bool simple_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req,
@@ -267,23 +279,59 @@ bool simple_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req,
 		break;
 	case nvme_cmd_csd_process_edge:
 		{
-			void *vaddr = phys_to_virt(cmd->rw.prp1);
 			struct PROC_EDGE proc_edge_struct;
 			__u64 current_time, finished_time;
-			int csd_flag;
+			int csd_flag = cmd->rw.apptag;
+			bool failed = false;	// Completed with an error status, nothing dispatched
 
-			// NVMEV_INFO("prp1: %llx\n, vaddr: %llx", cmd->rw.prp1, vaddr);
-			if (vaddr == NULL || !virt_addr_valid(vaddr)) {
-				NVMEV_ERROR("Invalid vaddr: %llx\n", (long long unsigned int)vaddr);
-				return -EFAULT;
+			// Dispatcher
+			if (csd_flag & PROC_EDGE_INLINE) {
+				// Per-task fields in the command dwords over the registered ones, no host memory access
+				__u32 dw[PROC_EDGE_INLINE_DWORDS];
+				int i;
+
+				for (i = 0; i < 2; i++)
+					dw[i] = le32_to_cpu(cmd->common.cdw2[i]);
+				for (i = 0; i < 6; i++)
+					dw[i + 2] = le32_to_cpu(cmd->common.cdw10[i]);
+				proc_edge_struct = nvmev_vdev->run_params;
+				csd_flag = proc_edge_decode(dw, &proc_edge_struct);
+
+				// Completed with an error, the host would hang on a dropped command
+				if (!nvmev_vdev->run_registered) {
+					NVMEV_ERROR("Inline edge task before REGISTER_RUN\n");
+					ret->status = NVME_SC_INVALID_FIELD;
+					failed = true;
+				}
 			}
+			else {
+				void *vaddr = phys_to_virt(cmd->rw.prp1);
 
-			// Dispatcher
-			memcpy(&proc_edge_struct, vaddr, sizeof(struct PROC_EDGE));
+				// NVMEV_INFO("prp1: %llx\n, vaddr: %llx", cmd->rw.prp1, vaddr);
+				if (vaddr == NULL || !virt_addr_valid(vaddr)) {
+					NVMEV_ERROR("Invalid vaddr: %llx\n", (long long unsigned int)vaddr);
+					return -EFAULT;
+				}
+				memcpy(&proc_edge_struct, vaddr, sizeof(struct PROC_EDGE));
+			}
 			proc_edge_struct.nsid = cmd->rw.nsid - 1;	// For io worker (do_perform_edge_proc) to know the namespace id
 			
 			// NVMEV_INFO("[CSD %d, %s()] [nvme_cmd_csd_proc_edge]\n", proc_edge_struct.csd_id, __func__);
 
+			// The block table is checked against the namespace before the completion is posted
+			if (csd_flag == RUN_PLAN) {
+				struct nvmev_ns *ns = &nvmev_vdev->ns[proc_edge_struct.nsid];
+
+				if (run_plan_load(&nvmev_vdev->run_plan, proc_edge_struct, ns->mapped, ns->size) < 0) {
+					ret->status = NVME_SC_INVALID_FIELD;
+					failed = true;
+				}
+			}
+			if (!failed && (csd_flag == REGISTER_RUN || csd_flag == RUN_PLAN)) {
+				nvmev_vdev->run_params = proc_edge_struct;
+				nvmev_vdev->run_registered = true;
+			}
+
 			// Schedule the I/O, get the target I/O complete time
 			current_time = __get_wallclock();
 			ret->nsecs_target = __schedule_io_units(cmd->common.opcode, proc_edge_struct.edge_block_slba, 
@@ -338,25 +386,45 @@ bool simple_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req,
 			}
 
 			// Synchronously process the edge processing command
-			csd_flag = cmd->rw.apptag;
-			if(csd_flag == SYNC){
+			if(failed){
+				NVMEV_ERROR("[CSD %d] Edge command %d failed\n", proc_edge_struct.csd_id, csd_flag);
+			}
+			else if(csd_flag == SYNC){
 				__do_perform_edge_proc_grafu(proc_edge_struct);
 			}
 			else if(csd_flag == ASYNC){
 				// Insert proc edge command into task queues; in case of duplicate task (aggregation for future task not done)
 				struct queue *normal_task_queue = &(nvmev_vdev->normal_task_queue);
+				reduce_scatter_start(&(nvmev_vdev->reduce_scatter), proc_edge_struct);
+				__traversal_start(proc_edge_struct);
 				if(!queue_find(normal_task_queue, proc_edge_struct))
 					queue_enqueue(normal_task_queue, proc_edge_struct);
 			}
+			else if(csd_flag == RUN_PLAN){
+				// Whole run in one command: the CSD generates the normal tasks of every iteration
+				struct run_plan *plan = &(nvmev_vdev->run_plan);
+				struct queue *normal_task_queue = &(nvmev_vdev->normal_task_queue);
+				int cnt;
+
+				plan->io_delay = nvmev_vdev->config.read_delay;
+				plan->io_time = nvmev_vdev->config.read_time;
+				plan->io_unit_size = 1ULL << nvmev_vdev->config.io_unit_shift;
+				reduce_scatter_start(&(nvmev_vdev->reduce_scatter), proc_edge_struct);
+				__traversal_start(proc_edge_struct);
+				// Iteration 0 runs in the current epoch, its blocks are tracked in done1
+				cnt = run_plan_enqueue_iter(plan, normal_task_queue, 0, &hmb_dev.done1);
+				NVMEV_INFO("[CSD %d] Run plan loaded: %u iters, %u partitions, %d tasks in iter 0",
+					proc_edge_struct.csd_id, proc_edge_struct.num_iters, proc_edge_struct.num_partitions, cnt);
+			}
 			else if(csd_flag == FLUSH_CSD_DRAM){
 
 				int csd_id = proc_edge_struct.csd_id;
-				int num_csds = proc_edge_struct.num_csds;
 				int ms_ns_ratio = 1000000;
 				int i;
 
 				NVMEV_INFO("Hit/Total (Edge buffer): %lld/%lld", nvmev_vdev->edge_buf.hit_cnt, nvmev_vdev->edge_buf.total_access_cnt);
-				NVMEV_INFO("Hit/Total (Vertex buffer): %lld/%lld", nvmev_vdev->vertex_buf.hit_cnt, nvmev_vdev->vertex_buf.total_access_cnt);
+				NVMEV_INFO("Hit/Total (Vertex buffer): %lld/%lld, traversal %u", nvmev_vdev->vertex_buf.hit_cnt, nvmev_vdev->vertex_buf.total_access_cnt,
+					nvmev_vdev->traversal.order);
 				NVMEV_INFO("Edge Processing time: %lld ms, Internal IO time: %lld ms, External IO time: %lld ms", nvmev_vdev->edge_buf.edge_proc_time / ms_ns_ratio, 
 					nvmev_vdev->edge_buf.edge_internal_io_time / ms_ns_ratio, nvmev_vdev->edge_buf.edge_external_io_time / ms_ns_ratio);
 				NVMEV_INFO("Prefetch Hit/Total Pages (Edge buffer): %lld/%lld", nvmev_vdev->edge_buf.prefetch_hit_cnt, nvmev_vdev->edge_buf.total_prefetch_cnt);
@@ -367,24 +435,46 @@ bool simple_proc_nvme_io_cmd(struct nvmev_ns *ns, struct nvmev_request *req,
 					nvmev_vdev->edge_buf.prefetch_block_hit_cnt_arr[3], nvmev_vdev->edge_buf.prefetch_block_cnt_arr[3],
 					nvmev_vdev->edge_buf.prefetch_block_hit_cnt_arr[4], nvmev_vdev->edge_buf.prefetch_block_cnt_arr[4],
 					nvmev_vdev->edge_buf.prefetch_block_hit_cnt_arr[5], nvmev_vdev->edge_buf.prefetch_block_cnt_arr[5]);
+				NVMEV_INFO("Prefetch Candidates Used/Wasted/Issued: 2: %lld/%lld/%lld, 3: %lld/%lld/%lld, 4: %lld/%lld/%lld, 5: %lld/%lld/%lld",
+					nvmev_vdev->prefetch_planner.used_cnt[2], nvmev_vdev->prefetch_planner.wasted_cnt[2], nvmev_vdev->prefetch_planner.issued_cnt[2],
+					nvmev_vdev->prefetch_planner.used_cnt[3], nvmev_vdev->prefetch_planner.wasted_cnt[3], nvmev_vdev->prefetch_planner.issued_cnt[3],
+					nvmev_vdev->prefetch_planner.used_cnt[4], nvmev_vdev->prefetch_planner.wasted_cnt[4], nvmev_vdev->prefetch_planner.issued_cnt[4],
+					nvmev_vdev->prefetch_planner.used_cnt[5], nvmev_vdev->prefetch_planner.wasted_cnt[5], nvmev_vdev->prefetch_planner.issued_cnt[5]);
+				NVMEV_INFO("Aggregation latency (ns) EMA: %lld, p50: %lld, p90: %lld, p99: %lld", nvmev_vdev->edge_buf.aggr.ema,
+					aggr_tracker_percentile(&nvmev_vdev->edge_buf.aggr, -1, 50),
+					aggr_tracker_percentile(&nvmev_vdev->edge_buf.aggr, -1, 90),
+					aggr_tracker_percentile(&nvmev_vdev->edge_buf.aggr, -1, 99));
+				NVMEV_INFO("Background Prefetch Completed/Cancelled/Issued: %lld/%lld/%lld, %lld KB",
+					nvmev_vdev->prefetch_stream.completed_cnt, nvmev_vdev->prefetch_stream.cancelled_cnt,
+					nvmev_vdev->prefetch_stream.issued_cnt, nvmev_vdev->prefetch_stream.prefetched_bytes / 1024);
+				NVMEV_INFO("Reduce-scatter Columns: %lld, %lld ms", nvmev_vdev->reduce_scatter.reduced_cnt,
+					nvmev_vdev->reduce_scatter.reduce_time / ms_ns_ratio);
+				NVMEV_INFO("NUMA Local/Remote: %llu/%llu MB (storage node %d, HMB node %d)",
+					nvmev_vdev->numa_local_bytes >> 20, nvmev_vdev->numa_remote_bytes >> 20,
+					nvmev_vdev->storage_node, nvmev_vdev->hmb_node);
 				
-				hmb_dev.buf2.virt_addr[csd_id] = 1.0f * nvmev_vdev->edge_buf.hit_cnt / nvmev_vdev->edge_buf.total_access_cnt;
-				hmb_dev.buf2.virt_addr[csd_id + num_csds] = nvmev_vdev->edge_buf.edge_proc_time / ms_ns_ratio;
-				hmb_dev.buf2.virt_addr[csd_id + num_csds * 2] = nvmev_vdev->edge_buf.edge_internal_io_time / ms_ns_ratio;
-				hmb_dev.buf2.virt_addr[csd_id + num_csds * 3] = nvmev_vdev->edge_buf.edge_external_io_time / ms_ns_ratio;
+				*hmb_stat(csd_id, 0) = 1.0f * nvmev_vdev->edge_buf.hit_cnt / nvmev_vdev->edge_buf.total_access_cnt;
+				*hmb_stat(csd_id, 1) = nvmev_vdev->edge_buf.edge_proc_time / ms_ns_ratio;
+				*hmb_stat(csd_id, 2) = nvmev_vdev->edge_buf.edge_internal_io_time / ms_ns_ratio;
+				*hmb_stat(csd_id, 3) = nvmev_vdev->edge_buf.edge_external_io_time / ms_ns_ratio;
 				for(i = 4; i <= 7; i++){
-					hmb_dev.buf2.virt_addr[csd_id + num_csds * i] = 1.0 * nvmev_vdev->edge_buf.prefetch_priority_cnt[i - 2];
+					*hmb_stat(csd_id, i) = 1.0 * nvmev_vdev->edge_buf.prefetch_priority_cnt[i - 2];
 				}
 				for(i = 8; i <= 11; i++){
-					hmb_dev.buf2.virt_addr[csd_id + num_csds * i] = 1.0 * nvmev_vdev->edge_buf.prefetch_block_hit_cnt_arr[i - 6];
+					*hmb_stat(csd_id, i) = 1.0 * nvmev_vdev->edge_buf.prefetch_block_hit_cnt_arr[i - 6];
 				}
 				for(i = 12; i <= 15; i++){
-					hmb_dev.buf2.virt_addr[csd_id + num_csds * i] = 1.0 * nvmev_vdev->edge_buf.prefetch_block_cnt_arr[i - 10];
+					*hmb_stat(csd_id, i) = 1.0 * nvmev_vdev->edge_buf.prefetch_block_cnt_arr[i - 10];
 				}
 
 				edge_buffer_destroy(&(nvmev_vdev->edge_buf));
 				vertex_buffer_destroy(&(nvmev_vdev->vertex_buf));
-				hmb_dev.done2.virt_addr[proc_edge_struct.csd_id] = true;
+				prefetch_planner_destroy(&(nvmev_vdev->prefetch_planner));
+				prefetch_stream_destroy(&(nvmev_vdev->prefetch_stream));
+				reduce_scatter_destroy(&(nvmev_vdev->reduce_scatter));
+				nvmev_vdev->numa_local_bytes = nvmev_vdev->numa_remote_bytes = 0;
+				nvmev_run_unregister();
+				hmb_set_flushed(proc_edge_struct.csd_id);
 			}
 
 		}
@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Host aggregation and reset throughput over 4KB and huge page HMB mappings
+# Unload the nvmev modules first, hmb.ko is reloaded for each mapping
+# Ex: bash test_hmb_pages.sh 100000000 8 10
+
+num_vertices=${1:-100000000}
+num_csds=${2:-8}
+rounds=${3:-10}
+
+output_path="experiments/hmb_pages_v${num_vertices}_n${num_csds}.txt"
+
+make ID=0 || exit
+cd user
+make
+cd ..
+
+for huge_pages in 0 1; do
+    if lsmod | grep -q "^hmb"; then
+        sudo rmmod hmb
+    fi
+    sudo insmod hmb/hmb.ko num_csds=$num_csds num_vertices=$num_vertices huge_pages=$huge_pages || exit
+    echo "huge_pages=$huge_pages" >> $output_path
+    result=$(sudo ./user/hmb_bench $num_vertices $num_csds $rounds) || exit
+    echo "$result" >> $output_path
+
+    # The huge mapping must really use PMD/PUD entries (THP always or madvise), not fall back to 4KB
+    huge_kb=$(echo "$result" | awk '/^huge_kb/ {print $2}')
+    if [ "$huge_pages" = 1 ] && ! [ "${huge_kb:-0}" -gt 0 ]; then
+        echo "huge_pages=1 but no FilePmdMapped/AnonHugePages in smaps, check /sys/kernel/mm/transparent_hugepage/enabled"
+        sudo rmmod hmb
+        exit 1
+    fi
+done
+sudo rmmod hmb
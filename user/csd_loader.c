@@ -0,0 +1,414 @@
+#define _GNU_SOURCE     // O_DIRECT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/nvme_ioctl.h>
+#include "csd_loader.h"
+
+#define CSD_LOAD_SECTOR 512
+
+struct load_stage {
+    char *buf;
+    long long dev_offset;
+    long long size;
+};
+
+// Staging buffers go reader -> writer -> reader
+struct csd_loader {
+    struct csd_load_job *job;
+    struct load_stage stages[CSD_LOAD_STAGES];
+    int head, count;            // Filled stages, in order
+    bool done;                  // The reader filled its last stage
+    int err;
+    long long mdts;
+    long long bytes;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t reader, writer;
+};
+
+// Dataset file, read through an aligned bounce buffer when opened with O_DIRECT
+struct load_src {
+    int fd;
+    bool direct;
+    char *bounce;
+};
+
+static long long load_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int csd_load_job_init(struct csd_load_job *job, int fd, const char *device)
+{
+    job->fd = fd;
+    job->device = device;
+    job->num_extents = 0;
+    job->max_extents = 64;
+    job->extents = malloc(job->max_extents * sizeof(struct csd_load_extent));
+    return job->extents ? 0 : -1;
+}
+
+void csd_load_job_free(struct csd_load_job *job)
+{
+    free(job->extents);
+    job->extents = NULL;
+    job->num_extents = job->max_extents = 0;
+}
+
+int csd_load_job_add(struct csd_load_job *job, const char *path, long long file_offset, long long len, long long dev_offset)
+{
+    struct csd_load_extent *e;
+
+    if(len <= 0)
+        return 0;
+    if(job->num_extents == job->max_extents){
+        struct csd_load_extent *extents = realloc(job->extents, 2 * job->max_extents * sizeof(*extents));
+        if(!extents)
+            return -1;
+        job->extents = extents;
+        job->max_extents *= 2;
+    }
+    e = &job->extents[job->num_extents++];
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->file_offset = file_offset;
+    e->len = len;
+    e->dev_offset = dev_offset;
+    return 0;
+}
+
+// Largest write the namespace takes, from /sys/block/<dev>/queue/max_hw_sectors_kb
+static long long load_mdts(const char *device)
+{
+    char path[128];
+    const char *name = strrchr(device, '/');
+    long long kb = 0;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/sys/block/%s/queue/max_hw_sectors_kb", name ? name + 1 : device);
+    file = fopen(path, "r");
+    if(file){
+        if(fscanf(file, "%lld", &kb) != 1)
+            kb = 0;
+        fclose(file);
+    }
+    if(kb <= 0)
+        return CSD_LOAD_DEFAULT_MDTS;
+    kb = kb * 1024 / CSD_LOAD_ALIGN * CSD_LOAD_ALIGN;
+    if(kb > CSD_LOAD_STAGE_SIZE)
+        return CSD_LOAD_STAGE_SIZE;
+    return kb > 0 ? kb : CSD_LOAD_ALIGN;
+}
+
+static int load_src_open(struct load_src *src, const char *path)
+{
+    src->direct = true;
+    src->fd = open(path, O_RDONLY | O_DIRECT);
+    if(src->fd < 0){
+        // tmpfs and some network file systems refuse O_DIRECT
+        src->direct = false;
+        src->fd = open(path, O_RDONLY);
+    }
+    if(src->fd < 0){
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// len bytes at offset into dst, O_DIRECT reads are widened to CSD_LOAD_ALIGN
+static int load_src_read(struct load_src *src, long long offset, char *dst, long long len)
+{
+    while(len > 0){
+        long long begin = offset, end = offset + len, n;
+        char *buf = dst;
+
+        if(src->direct){
+            begin = offset / CSD_LOAD_ALIGN * CSD_LOAD_ALIGN;
+            end = csd_load_padded(offset + len);
+            if(end - begin > CSD_LOAD_STAGE_SIZE)
+                end = begin + CSD_LOAD_STAGE_SIZE;
+            buf = src->bounce;
+        }
+        n = pread(src->fd, buf, end - begin, begin);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= offset - begin){
+            fprintf(stderr, "Short read at %lld: %s\n", offset, n < 0 ? strerror(errno) : "end of file");
+            return -1;
+        }
+        n -= offset - begin;
+        if(n > len)
+            n = len;
+        if(src->direct)
+            memcpy(dst, src->bounce + (offset - begin), n);
+        offset += n;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static struct load_stage *load_take_free(struct csd_loader *loader)
+{
+    struct load_stage *stage = NULL;
+
+    pthread_mutex_lock(&loader->lock);
+    while(!loader->err && loader->count == CSD_LOAD_STAGES)
+        pthread_cond_wait(&loader->cond, &loader->lock);
+    if(!loader->err)
+        stage = &loader->stages[(loader->head + loader->count) % CSD_LOAD_STAGES];
+    pthread_mutex_unlock(&loader->lock);
+    return stage;
+}
+
+static void load_publish(struct csd_loader *loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    loader->count++;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+static void load_fail(struct csd_loader *loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    loader->err = -1;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+// Build the device image in staging buffers: file data, then zeros up to the alignment
+static void *load_reader(void *arg)
+{
+    struct csd_loader *loader = arg;
+    struct csd_load_job *job = loader->job;
+    struct load_src src = {.fd = -1};
+    struct load_stage *stage = NULL;
+    int ret = 0;
+
+    if(posix_memalign((void **)&src.bounce, CSD_LOAD_ALIGN, CSD_LOAD_STAGE_SIZE)){
+        load_fail(loader);
+        return NULL;
+    }
+    for(int i = 0; i < job->num_extents && ret == 0; i++){
+        struct csd_load_extent *e = &job->extents[i];
+        long long padded = csd_load_padded(e->len), pos = 0;
+
+        if((ret = load_src_open(&src, e->path)) < 0)
+            break;
+        while(pos < padded){
+            long long n, data;
+
+            // A stage holds one contiguous range of the device
+            if(stage && (stage->size == CSD_LOAD_STAGE_SIZE || stage->dev_offset + stage->size != e->dev_offset + pos)){
+                load_publish(loader);
+                stage = NULL;
+            }
+            if(!stage){
+                if(!(stage = load_take_free(loader))){
+                    ret = -1;
+                    break;
+                }
+                stage->dev_offset = e->dev_offset + pos;
+                stage->size = 0;
+            }
+
+            n = padded - pos;
+            if(n > CSD_LOAD_STAGE_SIZE - stage->size)
+                n = CSD_LOAD_STAGE_SIZE - stage->size;
+            data = e->len - pos;
+            data = data < 0 ? 0 : (data > n ? n : data);
+            if(data > 0 && (ret = load_src_read(&src, e->file_offset + pos, stage->buf + stage->size, data)) < 0)
+                break;
+            memset(stage->buf + stage->size + data, 0, n - data);
+            stage->size += n;
+            pos += n;
+        }
+        close(src.fd);
+    }
+    free(src.bounce);
+
+    if(ret < 0){
+        load_fail(loader);
+        return NULL;
+    }
+    if(stage)
+        load_publish(loader);
+    pthread_mutex_lock(&loader->lock);
+    loader->done = true;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+static int load_write(struct csd_loader *loader, char *buf, long long dev_offset, long long size)
+{
+    struct nvme_user_io io;
+
+    memset(&io, 0, sizeof(io));
+    io.opcode = 0x01;  // Write
+    io.nblocks = size / CSD_LOAD_SECTOR - 1;  // 0-based count
+    io.addr = (unsigned long)buf;
+    io.slba = dev_offset / CSD_LOAD_SECTOR;
+    if(ioctl(loader->job->fd, NVME_IOCTL_SUBMIT_IO, &io) < 0){
+        perror("NVMe I/O ioctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Drain the filled stages in MDTS-sized writes
+static void *load_writer(void *arg)
+{
+    struct csd_loader *loader = arg;
+
+    while(true){
+        struct load_stage *stage;
+
+        pthread_mutex_lock(&loader->lock);
+        while(!loader->err && !loader->done && loader->count == 0)
+            pthread_cond_wait(&loader->cond, &loader->lock);
+        if(loader->err || loader->count == 0){
+            pthread_mutex_unlock(&loader->lock);
+            break;
+        }
+        stage = &loader->stages[loader->head];
+        pthread_mutex_unlock(&loader->lock);
+
+        for(long long off = 0; off < stage->size; off += loader->mdts){
+            long long n = stage->size - off < loader->mdts ? stage->size - off : loader->mdts;
+            if(load_write(loader, stage->buf + off, stage->dev_offset + off, n) < 0){
+                load_fail(loader);
+                return NULL;
+            }
+        }
+        loader->bytes += stage->size;
+
+        pthread_mutex_lock(&loader->lock);
+        loader->head = (loader->head + 1) % CSD_LOAD_STAGES;
+        loader->count--;
+        pthread_cond_broadcast(&loader->cond);
+        pthread_mutex_unlock(&loader->lock);
+    }
+    return NULL;
+}
+
+int csd_load(struct csd_load_job *jobs, int num_jobs)
+{
+    struct csd_loader *loaders = calloc(num_jobs, sizeof(struct csd_loader));
+    long long s, e, bytes = 0;
+    int ret = 0, started = 0;
+
+    if(!loaders)
+        return -1;
+    for(int i = 0; i < num_jobs; i++){
+        struct csd_loader *loader = &loaders[i];
+
+        loader->job = &jobs[i];
+        loader->mdts = load_mdts(jobs[i].device);
+        pthread_mutex_init(&loader->lock, NULL);
+        pthread_cond_init(&loader->cond, NULL);
+        for(int j = 0; j < CSD_LOAD_STAGES; j++){
+            if(posix_memalign((void **)&loader->stages[j].buf, CSD_LOAD_ALIGN, CSD_LOAD_STAGE_SIZE)){
+                loader->stages[j].buf = NULL;
+                ret = -1;
+            }
+        }
+    }
+
+    s = load_time_ns();
+    for(; ret == 0 && started < num_jobs; started++){
+        struct csd_loader *loader = &loaders[started];
+
+        if(pthread_create(&loader->reader, NULL, load_reader, loader) != 0){
+            ret = -1;
+            break;
+        }
+        if(pthread_create(&loader->writer, NULL, load_writer, loader) != 0){
+            load_fail(loader);
+            pthread_join(loader->reader, NULL);
+            ret = -1;
+            break;
+        }
+    }
+    for(int i = 0; i < started; i++){
+        pthread_join(loaders[i].reader, NULL);
+        pthread_join(loaders[i].writer, NULL);
+        if(loaders[i].err)
+            ret = -1;
+        bytes += loaders[i].bytes;
+    }
+    e = load_time_ns();
+
+    if(ret == 0)
+        printf("Loaded %.2f GB into %d CSDs in %lld ms (%.2f GB/s, %lld KB writes)\n", bytes / 1e9, num_jobs,
+            (e - s) / 1000000, 1.0 * bytes / (e - s), num_jobs > 0 ? loaders[0].mdts >> 10 : 0);
+
+    for(int i = 0; i < num_jobs; i++){
+        for(int j = 0; j < CSD_LOAD_STAGES; j++)
+            free(loaders[i].stages[j].buf);
+        pthread_mutex_destroy(&loaders[i].lock);
+        pthread_cond_destroy(&loaders[i].cond);
+    }
+    free(loaders);
+    return ret;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static unsigned long long fnv1a(unsigned long long hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    for(size_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    return hash;
+}
+
+static unsigned long long fnv1a_file_stat(unsigned long long hash, const char *path)
+{
+    struct stat st;
+    long long id[3] = {-1, 0, 0};
+
+    if(stat(path, &st) == 0){
+        id[0] = st.st_size;
+        id[1] = st.st_mtim.tv_sec;
+        id[2] = st.st_mtim.tv_nsec;
+    }
+    return fnv1a(hash, id, sizeof(id));
+}
+
+unsigned long long csd_dataset_fingerprint(const char *dataset_path, int num_partitions)
+{
+    unsigned long long hash = fnv1a(FNV_OFFSET, dataset_path, strlen(dataset_path));
+    char path[128], meta[256];
+    FILE *file;
+    size_t n = 0;
+
+    snprintf(path, sizeof(path), "%s/meta", dataset_path);
+    if((file = fopen(path, "r"))){
+        n = fread(meta, 1, sizeof(meta), file);
+        fclose(file);
+    }
+    hash = fnv1a(hash, meta, n);
+
+    snprintf(path, sizeof(path), "%s/outdegrees", dataset_path);
+    hash = fnv1a_file_stat(hash, path);
+    for(int i = 0; i < num_partitions; i++){
+        for(int j = 0; j < num_partitions; j++){
+            snprintf(path, sizeof(path), "%s/block-%d-%d", dataset_path, i, j);
+            hash = fnv1a_file_stat(hash, path);
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,76 @@
+#ifndef CSD_LOADER_H
+#define CSD_LOADER_H
+
+#include <stdbool.h>
+
+/*
+ * Parallel dataset loader: one writer thread per CSD issues MDTS-sized writes while a reader
+ * thread fills the next staging buffer from the dataset files (O_DIRECT when the file system
+ * allows it). The device image is the same as with 4KB writes: every extent starts on a
+ * CSD_LOAD_ALIGN boundary and is padded with zeros up to the next one.
+ */
+#define CSD_LOAD_ALIGN 4096LL
+#define CSD_LOAD_STAGES 2
+#define CSD_LOAD_STAGE_SIZE (4LL << 20)
+#define CSD_LOAD_DEFAULT_MDTS (128LL << 10)    /* Transfer size when sysfs does not tell */
+
+/* len bytes at file_offset of path, written at byte offset dev_offset of the namespace */
+struct csd_load_extent {
+    char path[64];
+    long long file_offset;
+    long long len;
+    long long dev_offset;
+};
+
+struct csd_load_job {
+    int fd;                     /* Namespace opened by the host */
+    const char *device;         /* /dev/nvmeXnY, for the transfer size */
+    struct csd_load_extent *extents;    /* Increasing dev_offset */
+    int num_extents;
+    int max_extents;
+};
+
+/* Padded size of an extent on the device */
+static inline long long csd_load_padded(long long len)
+{
+    return (len + CSD_LOAD_ALIGN - 1) / CSD_LOAD_ALIGN * CSD_LOAD_ALIGN;
+}
+
+int csd_load_job_init(struct csd_load_job *job, int fd, const char *device);
+void csd_load_job_free(struct csd_load_job *job);
+int csd_load_job_add(struct csd_load_job *job, const char *path, long long file_offset, long long len, long long dev_offset);
+
+/* Load every job in parallel, returns 0 once all the writes completed */
+int csd_load(struct csd_load_job *jobs, int num_jobs);
+
+/*
+ * Manifest of the dataset image, in the first CSD_MANIFEST_SIZE bytes of each namespace.
+ * The storage of the virtual CSDs is reserved memory, so an image survives the host program
+ * and module reloads. It is written last and cleared before a load, a matching manifest
+ * means the whole image is in place. The per-block table is the run plan table at plan_slba.
+ */
+#define CSD_MANIFEST_MAGIC 0x4d445343U    /* "CSDM" */
+#define CSD_MANIFEST_VERSION 1
+#define CSD_MANIFEST_SIZE CSD_LOAD_ALIGN
+
+struct csd_manifest {
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long fingerprint;     /* csd_dataset_fingerprint() of the dataset directory */
+    unsigned long long num_vertices;
+    unsigned int num_partitions;
+    unsigned int num_csds;
+    unsigned int csd_id;
+    unsigned int block_placement;      /* BLOCK_PLACEMENT_* */
+    unsigned long long outdegree_slba;
+    unsigned long long plan_slba;       /* struct run_plan_entry[P][P] */
+    unsigned long long num_edges;
+} __attribute__((packed));
+
+/*
+ * Hash of the dataset path, the meta file, and the size and mtime of the outdegrees and
+ * every block file. Hashing the contents would cost as much as loading them.
+ */
+unsigned long long csd_dataset_fingerprint(const char *dataset_path, int num_partitions);
+
+#endif // CSD_LOADER_H
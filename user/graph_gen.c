@@ -0,0 +1,393 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../core/proc_edge_struct.h"
+#include "../core/params.h"
+
+/*
+ * Synthetic graph generator: writes a dataset directory read by init_csd_edge, as graph_prep does
+ *   rmat       R-MAT with the initiator (a, b, c, 1 - a - b - c), 2^scale vertices
+ *   kronecker  R-MAT with the vertex ids scrambled by a bijection, as the Graph500 generator
+ *   uniform    source and destination uniform over the vertices
+ *
+ * The edges are generated in chunks, each from its own random stream of the seed. A first pass
+ * counts the edges of every chunk and block, so the second one writes each chunk at a fixed
+ * offset of the block files: the dataset depends on the seed only, not on the number of threads.
+ *
+ * Ex: ./graph_gen -g kronecker -s 29 -e 16 -p 16 -o ./RMAT29.pl -j 32
+ *     ./graph_gen -g uniform -v 1000000 -e 8 -p 4 -o ./Uniform-1M.pl -S 7
+ */
+
+#define GEN_RMAT 0
+#define GEN_KRONECKER 1
+#define GEN_UNIFORM 2
+
+#define GEN_MIN_CHUNK (1LL << 20)
+#define GEN_MAX_CHUNKS 4096
+
+struct edge {
+    int src, dst;
+};
+
+struct gen {
+    const char *output;
+    int type;
+    int scale;
+    long long num_vertices;
+    long long num_edges;
+    double edge_factor;
+    int num_partitions;
+    int threads;
+    unsigned long long seed;
+    double a, b, c;
+
+    unsigned int thresholds[3];     // a, a + b, a + b + c out of 2^32
+    long long chunk_edges;
+    long long num_chunks;
+    long long *chunk_offset;        // [num_chunks * P * P]: edges of each chunk and block, then their offsets
+    long long *block_edges;         // [P * P]
+    int *outdegree;
+    int *block_fd;
+    long long next_chunk;
+};
+
+enum gen_pass {
+    PASS_COUNT,
+    PASS_WRITE,
+};
+
+static struct gen gen = {
+    .type = GEN_KRONECKER,
+    .scale = 20,
+    .num_vertices = -1,
+    .num_edges = -1,
+    .edge_factor = 16,
+    .threads = 4,
+    .seed = 1,
+    .a = 0.57,
+    .b = 0.19,
+    .c = 0.19,
+};
+
+static long long get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline unsigned long long splitmix64(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Bijection of [0, 2^scale): odd multiplier, offset and xorshift, twice
+static inline unsigned long long scramble(unsigned long long x)
+{
+    const unsigned long long mask = (1ULL << gen.scale) - 1;
+    const int shift = gen.scale / 2 > 0 ? gen.scale / 2 : 1;
+    for(int round = 0; round < 2; round++){
+        x = (x * 0x9e3779b97f4a7c15ULL + gen.seed) & mask;
+        x ^= x >> shift;
+    }
+    return x;
+}
+
+// Probability p as a threshold on 32 random bits
+static unsigned int prob_threshold(double p)
+{
+    double t = p * 4294967296.0;
+    return t >= 4294967295.0 ? 4294967295U : (unsigned int)t;
+}
+
+// Quadrant of one R-MAT level from 32 random bits: 0 (a), 1 (b, right), 2 (c, down), 3 (d)
+static inline int rmat_quadrant(unsigned int bits)
+{
+    return (bits >= gen.thresholds[0]) + (bits >= gen.thresholds[1]) + (bits >= gen.thresholds[2]);
+}
+
+static inline struct edge next_edge(unsigned long long *state)
+{
+    unsigned long long u = 0, v = 0;
+
+    if(gen.type == GEN_UNIFORM){
+        // Multiply-shift, without the bias of a modulo
+        u = (unsigned long long)(((unsigned __int128)splitmix64(state) * gen.num_vertices) >> 64);
+        v = (unsigned long long)(((unsigned __int128)splitmix64(state) * gen.num_vertices) >> 64);
+        return (struct edge){.src = u, .dst = v};
+    }
+    for(int level = 0; level < gen.scale; level += 2){
+        unsigned long long bits = splitmix64(state);
+        for(int k = 0; k < 2 && level + k < gen.scale; k++){
+            int q = rmat_quadrant(bits >> (32 * k));
+            u = u << 1 | (q >> 1);
+            v = v << 1 | (q & 1);
+        }
+    }
+    if(gen.type == GEN_KRONECKER){
+        u = scramble(u);
+        v = scramble(v);
+    }
+    return (struct edge){.src = u, .dst = v};
+}
+
+static inline int block_of(struct edge e)
+{
+    return partition_of(gen.num_vertices, gen.num_partitions, e.src) * gen.num_partitions
+        + partition_of(gen.num_vertices, gen.num_partitions, e.dst);
+}
+
+static int write_all(int fd, const void *buf, long long len, long long offset)
+{
+    const char *p = buf;
+    while(len > 0){
+        ssize_t n = pwrite(fd, p, len, offset);
+        if(n < 0){
+            if(errno == EINTR)
+                continue;
+            perror("pwrite");
+            return -1;
+        }
+        p += n, offset += n, len -= n;
+    }
+    return 0;
+}
+
+// Edges of one chunk: counted, or ordered by block and written at the chunk's offsets
+static int gen_chunk(enum gen_pass pass, long long chunk, struct edge *buf, long long *cursor)
+{
+    const int B = gen.num_partitions * gen.num_partitions;
+    long long *offset = &gen.chunk_offset[chunk * B];
+    long long begin = chunk * gen.chunk_edges;
+    long long n = gen.num_edges - begin < gen.chunk_edges ? gen.num_edges - begin : gen.chunk_edges;
+    unsigned long long state = gen.seed * 0xd1b54a32d192ed03ULL + chunk;
+
+    if(pass == PASS_COUNT){
+        for(long long i = 0; i < n; i++){
+            struct edge e = next_edge(&state);
+            offset[block_of(e)]++;
+            __atomic_fetch_add(&gen.outdegree[e.src], 1, __ATOMIC_RELAXED);
+        }
+        return 0;
+    }
+
+    // The chunk's edges of block b go to buf[cursor[b]...], in generation order
+    cursor[0] = 0;
+    for(int b = 1; b < B; b++)
+        cursor[b] = cursor[b - 1] + (chunk + 1 < gen.num_chunks ? offset[B + b - 1] : gen.block_edges[b - 1]) - offset[b - 1];
+    for(long long i = 0; i < n; i++){
+        struct edge e = next_edge(&state);
+        buf[cursor[block_of(e)]++] = e;
+    }
+    for(int b = 0; b < B; b++){
+        long long end = cursor[b], start = end - ((chunk + 1 < gen.num_chunks ? offset[B + b] : gen.block_edges[b]) - offset[b]);
+        if(end > start && write_all(gen.block_fd[b], buf + start, (end - start) * sizeof(struct edge), offset[b] * sizeof(struct edge)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+struct gen_worker {
+    enum gen_pass pass;
+    int err;
+};
+
+static void *gen_worker(void *arg)
+{
+    struct gen_worker *w = arg;
+    struct edge *buf = NULL;
+    long long *cursor = malloc(gen.num_partitions * gen.num_partitions * sizeof(long long));
+    long long chunk;
+
+    if(w->pass == PASS_WRITE)
+        buf = malloc(gen.chunk_edges * sizeof(struct edge));
+    if(!cursor || (w->pass == PASS_WRITE && !buf)){
+        fprintf(stderr, "Out of memory\n");
+        w->err = -1;
+    }
+    while(!w->err && (chunk = __atomic_fetch_add(&gen.next_chunk, 1, __ATOMIC_RELAXED)) < gen.num_chunks)
+        w->err = gen_chunk(w->pass, chunk, buf, cursor);
+    free(buf);
+    free(cursor);
+    return NULL;
+}
+
+// Every chunk once, with gen.threads threads
+static int gen_pass(enum gen_pass pass)
+{
+    struct gen_worker workers[gen.threads];
+    pthread_t threads[gen.threads];
+    int ret = 0;
+
+    gen.next_chunk = 0;
+    for(int t = 0; t < gen.threads; t++){
+        workers[t] = (struct gen_worker){.pass = pass};
+        if(pthread_create(&threads[t], NULL, gen_worker, &workers[t]) != 0){
+            perror("pthread_create");
+            return -1;
+        }
+    }
+    for(int t = 0; t < gen.threads; t++){
+        pthread_join(threads[t], NULL);
+        if(workers[t].err)
+            ret = -1;
+    }
+    return ret;
+}
+
+static int write_meta()
+{
+    char path[512];
+    FILE *file;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/meta", gen.output);
+    if(!(file = fopen(path, "w"))){
+        perror("meta");
+        return -1;
+    }
+    fprintf(file, "0 %lld %lld %d 0\n", gen.num_vertices, gen.num_edges, gen.num_partitions);
+    fclose(file);
+
+    snprintf(path, sizeof(path), "%s/outdegrees", gen.output);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write_all(fd, gen.outdegree, gen.num_vertices * sizeof(int), 0) < 0){
+        perror("outdegrees");
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s -o <dataset dir> -p <partitions> [-g rmat|kronecker|uniform] [-s <scale>] [-v <vertices>]\n"
+        "       [-e <edges per vertex>] [-E <edges>] [-S <seed>] [-a <a>] [-b <b>] [-c <c>] [-j <threads>]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    long long s = get_time_ns();
+    int opt, B;
+
+    while((opt = getopt(argc, argv, "o:p:g:s:v:e:E:S:a:b:c:j:")) != -1){
+        switch(opt){
+        case 'o': gen.output = optarg; break;
+        case 'p': gen.num_partitions = atoi(optarg); break;
+        case 'g':
+            if(strcmp(optarg, "rmat") == 0)
+                gen.type = GEN_RMAT;
+            else if(strcmp(optarg, "kronecker") == 0)
+                gen.type = GEN_KRONECKER;
+            else if(strcmp(optarg, "uniform") == 0)
+                gen.type = GEN_UNIFORM;
+            else{
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's': gen.scale = atoi(optarg); break;
+        case 'v': gen.num_vertices = atoll(optarg); break;
+        case 'e': gen.edge_factor = atof(optarg); break;
+        case 'E': gen.num_edges = atoll(optarg); break;
+        case 'S': gen.seed = strtoull(optarg, NULL, 0); break;
+        case 'a': gen.a = atof(optarg); break;
+        case 'b': gen.b = atof(optarg); break;
+        case 'c': gen.c = atof(optarg); break;
+        case 'j': gen.threads = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if(!gen.output || gen.num_partitions <= 0 || gen.num_partitions > MAX_PARTITION || gen.threads <= 0){
+        usage(argv[0]);
+        return 1;
+    }
+
+    // R-MAT vertices are 2^scale, uniform ones -v or 2^scale
+    if(gen.type != GEN_UNIFORM && gen.num_vertices >= 0){
+        fprintf(stderr, "R-MAT graphs have 2^scale vertices, use -s\n");
+        return 1;
+    }
+    if(gen.num_vertices < 0){
+        if(gen.scale < 1 || gen.scale > 31){
+            fprintf(stderr, "Scale %d out of [1, 31]\n", gen.scale);
+            return 1;
+        }
+        gen.num_vertices = 1LL << gen.scale;
+    }
+    if(gen.num_vertices <= 0 || gen.num_vertices > 0x7fffffffLL){
+        fprintf(stderr, "%lld vertices do not fit the int32 vertex ids\n", gen.num_vertices);
+        return 1;
+    }
+    if(gen.num_edges < 0)
+        gen.num_edges = (long long)(gen.edge_factor * gen.num_vertices);
+    if(gen.a < 0 || gen.b < 0 || gen.c < 0 || gen.a + gen.b + gen.c > 1){
+        fprintf(stderr, "R-MAT probabilities a, b, c must be >= 0 with a + b + c <= 1\n");
+        return 1;
+    }
+    gen.thresholds[0] = prob_threshold(gen.a);
+    gen.thresholds[1] = prob_threshold(gen.a + gen.b);
+    gen.thresholds[2] = prob_threshold(gen.a + gen.b + gen.c);
+
+    // The chunking depends on the number of edges only, so does the output
+    gen.chunk_edges = (gen.num_edges + GEN_MAX_CHUNKS - 1) / GEN_MAX_CHUNKS;
+    if(gen.chunk_edges < GEN_MIN_CHUNK)
+        gen.chunk_edges = GEN_MIN_CHUNK;
+    gen.num_chunks = (gen.num_edges + gen.chunk_edges - 1) / gen.chunk_edges;
+
+    B = gen.num_partitions * gen.num_partitions;
+    gen.chunk_offset = calloc(gen.num_chunks * B + 1, sizeof(long long));
+    gen.block_edges = calloc(B, sizeof(long long));
+    gen.outdegree = calloc(gen.num_vertices, sizeof(int));
+    gen.block_fd = calloc(B, sizeof(int));
+    if(!gen.chunk_offset || !gen.block_edges || !gen.outdegree || !gen.block_fd){
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if(mkdir(gen.output, 0755) < 0 && errno != EEXIST){
+        perror(gen.output);
+        return 1;
+    }
+
+    // 1. Edges of every chunk and block, then the offsets of the chunks in the block files
+    if(gen_pass(PASS_COUNT) < 0)
+        return 1;
+    for(int b = 0; b < B; b++){
+        for(long long k = 0; k < gen.num_chunks; k++){
+            long long count = gen.chunk_offset[k * B + b];
+            gen.chunk_offset[k * B + b] = gen.block_edges[b];
+            gen.block_edges[b] += count;
+        }
+    }
+    printf("%lld vertices, %lld edges, %d x %d blocks, %lld chunks (%lld ms)\n", gen.num_vertices, gen.num_edges,
+        gen.num_partitions, gen.num_partitions, gen.num_chunks, (get_time_ns() - s) / 1000000);
+
+    // 2. The same edges again, every chunk into its ranges of the block files
+    for(int b = 0; b < B; b++){
+        char path[512];
+        snprintf(path, sizeof(path), "%s/block-%d-%d", gen.output, b / gen.num_partitions, b % gen.num_partitions);
+        gen.block_fd[b] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(gen.block_fd[b] < 0){
+            fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+    if(gen_pass(PASS_WRITE) < 0 || write_meta() < 0)
+        return 1;
+    for(int b = 0; b < B; b++)
+        close(gen.block_fd[b]);
+    printf("Wrote %s (%lld ms)\n", gen.output, (get_time_ns() - s) / 1000000);
+    return 0;
+}
@@ -0,0 +1,849 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../core/proc_edge_struct.h"
+#include "../core/params.h"
+#include "graph_reorder.h"
+
+/*
+ * Graph preprocessor: edge list -> dataset directory read by init_csd_edge
+ *   meta           "edge_type V E P 0", edge_type 0 is unweighted
+ *   outdegrees     int32 per vertex
+ *   block-i-j      (int32 src, int32 dst) pairs, src in partition i and dst in partition j
+ * Partitions follow partition_range(), the split of get_partition_range on the host.
+ *
+ * Optional per-block formats, edges ordered by (dst, src):
+ *   -s  block-i-j rewritten sorted
+ *   -c  block-i-j.csc: u64 offsets[dst_end - dst_begin + 1] (edges), then int32 src per edge
+ *   -z  block-i-j.z: u64 number of edges, then varint(dst - previous dst), varint(src) per edge
+ * Blocks larger than the memory budget of a thread are sorted externally (sorted runs, then a merge).
+ *
+ * -r degree|rcm|gorder relabels the vertices before partitioning (see graph_reorder.h): outdegrees and
+ * blocks use the new ids, and vertex_map holds the original id (int32) of every new one. The relabeling
+ * holds the out and in adjacency of the whole graph in memory.
+ *
+ * Ex: ./graph_prep -i twitter.bin -o ./Twitter-2010.pl -p 8 -j 16 -m 8192 -s
+ *     ./graph_prep -i soc-LiveJournal1.txt -t -o ./LiveJournal.pl -p 3
+ */
+
+#define PREP_READ_SIZE (8LL << 20)
+#define PREP_MIN_BLOCK_BUF (64LL << 10)
+#define PREP_MAX_RUNS 1024
+#define PREP_RUN_BUF (1LL << 20)
+
+struct edge {
+    int src, dst;
+};
+
+struct prep {
+    const char *input, *output;
+    int num_partitions;
+    long long num_vertices;
+    bool text;
+    int threads;
+    long long mem;          // Bytes of edge buffers over all threads
+    bool sorted, csc, compressed;
+    int reorder;
+
+    int in_fd;
+    long long input_size;
+    int *outdegree;
+    long long *block_edges;     // [P * P]
+    long long *block_cursor;    // Next free byte of each block file, shared by the writer threads
+    int *block_fd;
+    long long num_edges;
+    int next_block;             // Post-processing: next block to take
+
+    struct graph_csr csr;       // Relabeling input
+    long long *out_cursor, *in_cursor;
+    int *perm;                  // perm[original id] = new id, NULL without relabeling
+};
+
+enum prep_pass {
+    PASS_MAX_VERTEX,
+    PASS_DEGREE,
+    PASS_ADJ,
+    PASS_COUNT,
+    PASS_DISTRIBUTE,
+};
+
+struct prep_worker {
+    struct prep *prep;
+    enum prep_pass pass;
+    int id;
+    long long begin, end;       // Byte range of the input
+    long long max_vertex;
+    long long *block_edges;     // Thread-local counts
+    struct edge **buf;          // Thread-local block buffers
+    int *buf_len;
+    int buf_cap;
+    int err;
+};
+
+static struct prep prep = {
+    .num_partitions = 0,
+    .num_vertices = -1,
+    .threads = 4,
+    .mem = 1LL << 30,
+};
+
+static long long get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *buf, long long len, long long offset)
+{
+    const char *p = buf;
+    while(len > 0){
+        ssize_t n = pwrite(fd, p, len, offset);
+        if(n < 0){
+            if(errno == EINTR)
+                continue;
+            perror("pwrite");
+            return -1;
+        }
+        p += n, offset += n, len -= n;
+    }
+    return 0;
+}
+
+static int flush_block(struct prep_worker *w, int b)
+{
+    long long bytes = (long long)w->buf_len[b] * sizeof(struct edge);
+    long long offset = __atomic_fetch_add(&prep.block_cursor[b], bytes, __ATOMIC_RELAXED);
+
+    if(w->buf_len[b] == 0)
+        return 0;
+    w->buf_len[b] = 0;
+    return write_all(prep.block_fd[b], w->buf[b], bytes, offset);
+}
+
+static inline void handle_edge(struct prep_worker *w, long long u, long long v)
+{
+    int b;
+
+    if(w->pass == PASS_MAX_VERTEX){
+        if(u > w->max_vertex)
+            w->max_vertex = u;
+        if(v > w->max_vertex)
+            w->max_vertex = v;
+        return;
+    }
+    if(u < 0 || v < 0 || u >= prep.num_vertices || v >= prep.num_vertices){
+        // Counted in no pass, so every pass drops the same edges
+        return;
+    }
+    if(w->pass == PASS_DEGREE){
+        __atomic_fetch_add(&prep.csr.out_off[u + 1], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&prep.csr.in_off[v + 1], 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if(w->pass == PASS_ADJ){
+        prep.csr.out_adj[__atomic_fetch_add(&prep.out_cursor[u], 1, __ATOMIC_RELAXED)] = v;
+        prep.csr.in_adj[__atomic_fetch_add(&prep.in_cursor[v], 1, __ATOMIC_RELAXED)] = u;
+        return;
+    }
+    if(prep.perm){
+        u = prep.perm[u];
+        v = prep.perm[v];
+    }
+    b = partition_of(prep.num_vertices, prep.num_partitions, u) * prep.num_partitions
+        + partition_of(prep.num_vertices, prep.num_partitions, v);
+    if(w->pass == PASS_COUNT){
+        __atomic_fetch_add(&prep.outdegree[u], 1, __ATOMIC_RELAXED);
+        w->block_edges[b]++;
+        return;
+    }
+    w->buf[b][w->buf_len[b]++] = (struct edge){.src = u, .dst = v};
+    if(w->buf_len[b] == w->buf_cap && flush_block(w, b) < 0)
+        w->err = -1;
+}
+
+// Binary input: (int32 src, int32 dst) pairs
+static void scan_binary(struct prep_worker *w, char *buf)
+{
+    for(long long off = w->begin; off < w->end && !w->err; ){
+        long long len = w->end - off < PREP_READ_SIZE ? w->end - off : PREP_READ_SIZE;
+        ssize_t n = pread(prep.in_fd, buf, len, off);
+        if(n <= 0){
+            perror("pread");
+            w->err = -1;
+            return;
+        }
+        n -= n % sizeof(struct edge);
+        for(struct edge *e = (struct edge*)buf; (char*)e < buf + n; e++)
+            handle_edge(w, (unsigned int)e->src, (unsigned int)e->dst);
+        off += n;
+    }
+}
+
+// Text input: "src dst" per line, lines starting with '#' or '%' are comments.
+// A line belongs to the thread whose range holds its first byte.
+static void scan_text(struct prep_worker *w, char *buf)
+{
+    long long off = w->begin, carry = 0;
+    bool skip = false;
+
+    if(w->begin > 0){
+        char c;
+        if(pread(prep.in_fd, &c, 1, w->begin - 1) == 1 && c != '\n')
+            skip = true;
+    }
+    while(!w->err){
+        ssize_t n = pread(prep.in_fd, buf + carry, PREP_READ_SIZE - carry, off);
+        long long line_off, avail;
+        char *p, *end;
+
+        if(n < 0){
+            perror("pread");
+            w->err = -1;
+            return;
+        }
+        avail = carry + n;
+        // Line start in file offsets: off - carry
+        line_off = off - carry;
+        p = buf, end = buf + avail;
+        while(p < end){
+            char *nl = memchr(p, '\n', end - p);
+            if(!nl && n > 0)
+                break;      // Incomplete line, read more
+            if(!nl)
+                nl = end;   // Last line without a newline
+            if(line_off >= w->end)
+                return;
+            if(skip)
+                skip = false;
+            else if(*p != '#' && *p != '%'){
+                char *q;
+                long long u = strtoll(p, &q, 10);
+                if(q != p){
+                    char *r;
+                    long long v = strtoll(q, &r, 10);
+                    if(r != q)
+                        handle_edge(w, u, v);
+                }
+            }
+            line_off += nl - p + 1;
+            p = nl + 1;
+        }
+        if(n == 0)
+            return;
+        carry = end - p;
+        if(carry >= PREP_READ_SIZE){
+            fprintf(stderr, "Line longer than %lld bytes\n", PREP_READ_SIZE);
+            w->err = -1;
+            return;
+        }
+        memmove(buf, p, carry);
+        off += n;
+    }
+}
+
+static void *scan_worker(void *arg)
+{
+    struct prep_worker *w = arg;
+    char *buf = malloc(PREP_READ_SIZE + 1);
+
+    if(!buf){
+        w->err = -1;
+        return NULL;
+    }
+    if(prep.text)
+        scan_text(w, buf);
+    else
+        scan_binary(w, buf);
+    if(w->pass == PASS_DISTRIBUTE){
+        for(int b = 0; b < prep.num_partitions * prep.num_partitions && !w->err; b++){
+            if(flush_block(w, b) < 0)
+                w->err = -1;
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+// One pass over the input with prep.threads threads
+static int scan_input(enum prep_pass pass)
+{
+    int T = prep.threads, B = prep.num_partitions * prep.num_partitions, ret = 0;
+    struct prep_worker workers[T];
+    pthread_t threads[T];
+    long long slice = (prep.input_size + T - 1) / T;
+
+    // Binary slices hold whole edges
+    if(!prep.text)
+        slice = (slice + sizeof(struct edge) - 1) / sizeof(struct edge) * sizeof(struct edge);
+
+    for(int t = 0; t < T; t++){
+        struct prep_worker *w = &workers[t];
+        memset(w, 0, sizeof(*w));
+        w->prep = &prep;
+        w->pass = pass;
+        w->id = t;
+        w->begin = slice * t < prep.input_size ? slice * t : prep.input_size;
+        w->end = slice * (t + 1) < prep.input_size ? slice * (t + 1) : prep.input_size;
+        w->max_vertex = -1;
+        if(pass == PASS_COUNT)
+            w->block_edges = calloc(B, sizeof(long long));
+        if(pass == PASS_DISTRIBUTE){
+            // The edge buffers of all threads fit in the memory budget
+            long long cap = prep.mem / T / B;
+            if(cap < PREP_MIN_BLOCK_BUF)
+                cap = PREP_MIN_BLOCK_BUF;
+            w->buf_cap = cap / sizeof(struct edge);
+            w->buf = calloc(B, sizeof(struct edge*));
+            w->buf_len = calloc(B, sizeof(int));
+            for(int b = 0; b < B; b++)
+                w->buf[b] = malloc(w->buf_cap * sizeof(struct edge));
+        }
+        if(pthread_create(&threads[t], NULL, scan_worker, w) != 0){
+            perror("pthread_create");
+            return -1;
+        }
+    }
+    for(int t = 0; t < T; t++){
+        struct prep_worker *w = &workers[t];
+        pthread_join(threads[t], NULL);
+        if(w->err)
+            ret = -1;
+        if(pass == PASS_MAX_VERTEX && w->max_vertex + 1 > prep.num_vertices)
+            prep.num_vertices = w->max_vertex + 1;
+        if(pass == PASS_COUNT){
+            for(int b = 0; b < B; b++)
+                prep.block_edges[b] += w->block_edges[b];
+            free(w->block_edges);
+        }
+        if(pass == PASS_DISTRIBUTE){
+            for(int b = 0; b < B; b++)
+                free(w->buf[b]);
+            free(w->buf);
+            free(w->buf_len);
+        }
+    }
+    return ret;
+}
+
+static int edge_cmp(const void *a, const void *b)
+{
+    const struct edge *x = a, *y = b;
+    if(x->dst != y->dst)
+        return x->dst < y->dst ? -1 : 1;
+    if(x->src != y->src)
+        return x->src < y->src ? -1 : 1;
+    return 0;
+}
+
+// Sorted edges of a block go to every requested format
+struct block_out {
+    int r, c;
+    long long dst_begin, dst_end;
+    int sorted_fd, csc_fd, z_fd;
+    long long *csc_count;
+    struct edge *sorted_buf;
+    int sorted_len, sorted_cap;
+    long long sorted_off;
+    int *csc_buf;
+    int csc_len;
+    long long csc_off;
+    unsigned char *z_buf;
+    int z_len;
+    long long z_off;
+    long long prev_dst;
+    int err;
+};
+
+static int open_out(const char *suffix, int r, int c)
+{
+    char path[512];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/block-%d-%d%s", prep.output, r, c, suffix);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+    return fd;
+}
+
+static int block_out_open(struct block_out *o, int r, int c)
+{
+    __u64 begin, end;
+
+    memset(o, 0, sizeof(*o));
+    o->r = r, o->c = c;
+    o->sorted_fd = o->csc_fd = o->z_fd = -1;
+    partition_range(prep.num_vertices, prep.num_partitions, c, &begin, &end);
+    o->dst_begin = begin, o->dst_end = end;
+    o->sorted_cap = o->csc_len = 0;
+    if(prep.sorted){
+        if((o->sorted_fd = open_out(".sorted", r, c)) < 0)
+            return -1;
+        o->sorted_cap = PREP_RUN_BUF / sizeof(struct edge);
+        o->sorted_buf = malloc(PREP_RUN_BUF);
+    }
+    if(prep.csc){
+        if((o->csc_fd = open_out(".csc", r, c)) < 0)
+            return -1;
+        o->csc_count = calloc(end - begin + 1, sizeof(long long));
+        o->csc_buf = malloc(PREP_RUN_BUF);
+        o->csc_off = (end - begin + 1) * sizeof(long long);
+    }
+    if(prep.compressed){
+        if((o->z_fd = open_out(".z", r, c)) < 0)
+            return -1;
+        o->z_buf = malloc(PREP_RUN_BUF + 16);
+        o->z_off = sizeof(long long);
+        o->prev_dst = o->dst_begin;
+    }
+    return 0;
+}
+
+static void put_varint(struct block_out *o, unsigned long long x)
+{
+    while(x >= 0x80){
+        o->z_buf[o->z_len++] = (x & 0x7f) | 0x80;
+        x >>= 7;
+    }
+    o->z_buf[o->z_len++] = x;
+}
+
+static void block_out_flush(struct block_out *o)
+{
+    if(o->sorted_len){
+        o->err |= write_all(o->sorted_fd, o->sorted_buf, o->sorted_len * sizeof(struct edge), o->sorted_off);
+        o->sorted_off += o->sorted_len * sizeof(struct edge);
+        o->sorted_len = 0;
+    }
+    if(o->csc_len){
+        o->err |= write_all(o->csc_fd, o->csc_buf, o->csc_len * sizeof(int), o->csc_off);
+        o->csc_off += o->csc_len * sizeof(int);
+        o->csc_len = 0;
+    }
+    if(o->z_len){
+        o->err |= write_all(o->z_fd, o->z_buf, o->z_len, o->z_off);
+        o->z_off += o->z_len;
+        o->z_len = 0;
+    }
+}
+
+static void block_out_edge(struct block_out *o, struct edge e)
+{
+    if(prep.sorted){
+        o->sorted_buf[o->sorted_len++] = e;
+        if(o->sorted_len == o->sorted_cap)
+            block_out_flush(o);
+    }
+    if(prep.csc){
+        o->csc_count[e.dst - o->dst_begin + 1]++;
+        o->csc_buf[o->csc_len++] = e.src;
+        if(o->csc_len == PREP_RUN_BUF / (long long)sizeof(int))
+            block_out_flush(o);
+    }
+    if(prep.compressed){
+        put_varint(o, e.dst - o->prev_dst);
+        put_varint(o, (unsigned int)e.src);
+        o->prev_dst = e.dst;
+        if(o->z_len >= PREP_RUN_BUF)
+            block_out_flush(o);
+    }
+}
+
+static int block_out_close(struct block_out *o, long long num_edges)
+{
+    char from[512], to[512];
+
+    block_out_flush(o);
+    if(prep.csc){
+        long long n = o->dst_end - o->dst_begin;
+        for(long long i = 0; i < n; i++)
+            o->csc_count[i + 1] += o->csc_count[i];
+        o->err |= write_all(o->csc_fd, o->csc_count, (n + 1) * sizeof(long long), 0);
+        free(o->csc_count);
+        free(o->csc_buf);
+        close(o->csc_fd);
+    }
+    if(prep.compressed){
+        o->err |= write_all(o->z_fd, &num_edges, sizeof(num_edges), 0);
+        free(o->z_buf);
+        close(o->z_fd);
+    }
+    if(prep.sorted){
+        free(o->sorted_buf);
+        close(o->sorted_fd);
+        snprintf(from, sizeof(from), "%s/block-%d-%d.sorted", prep.output, o->r, o->c);
+        snprintf(to, sizeof(to), "%s/block-%d-%d", prep.output, o->r, o->c);
+        if(!o->err && rename(from, to) < 0){
+            perror("rename");
+            o->err = -1;
+        }
+    }
+    return o->err ? -1 : 0;
+}
+
+// Buffered reader of a sorted run
+struct run_reader {
+    int fd;
+    long long off, end;
+    struct edge *buf;
+    int len, pos;
+};
+
+static bool run_next(struct run_reader *rr, struct edge *e)
+{
+    if(rr->pos == rr->len){
+        long long bytes = rr->end - rr->off;
+        ssize_t n;
+        if(bytes <= 0)
+            return false;
+        if(bytes > PREP_RUN_BUF / 16)
+            bytes = PREP_RUN_BUF / 16;
+        n = pread(rr->fd, rr->buf, bytes, rr->off);
+        if(n <= 0)
+            return false;
+        rr->off += n;
+        rr->len = n / sizeof(struct edge);
+        rr->pos = 0;
+    }
+    *e = rr->buf[rr->pos++];
+    return true;
+}
+
+// Sort one block within budget bytes, streaming it to the requested formats
+static int sort_block(int r, int c, long long budget, struct edge *mem)
+{
+    int b = r * prep.num_partitions + c;
+    long long num_edges = prep.block_edges[b];
+    long long cap = budget / sizeof(struct edge);
+    struct block_out out;
+    int ret = 0;
+
+    if(block_out_open(&out, r, c) < 0)
+        return -1;
+
+    if(num_edges <= cap){
+        if(num_edges > 0 && pread(prep.block_fd[b], mem, num_edges * sizeof(struct edge), 0) != (ssize_t)(num_edges * sizeof(struct edge))){
+            perror("pread");
+            return -1;
+        }
+        qsort(mem, num_edges, sizeof(struct edge), edge_cmp);
+        for(long long i = 0; i < num_edges; i++)
+            block_out_edge(&out, mem[i]);
+        return block_out_close(&out, num_edges);
+    }
+
+    // External sort: sorted runs of cap edges in a temporary file, then a k-way merge
+    {
+        char path[512];
+        long long num_runs = (num_edges + cap - 1) / cap;
+        struct run_reader *runs;
+        int tmp_fd;
+
+        if(num_runs > PREP_MAX_RUNS){
+            fprintf(stderr, "Block %d-%d needs %lld runs, raise the memory budget\n", r, c, num_runs);
+            return -1;
+        }
+        snprintf(path, sizeof(path), "%s/block-%d-%d.runs", prep.output, r, c);
+        tmp_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(tmp_fd < 0){
+            perror("open runs");
+            return -1;
+        }
+        unlink(path);
+
+        runs = calloc(num_runs, sizeof(struct run_reader));
+        for(long long k = 0; k < num_runs && ret == 0; k++){
+            long long n = num_edges - k * cap < cap ? num_edges - k * cap : cap;
+            long long bytes = n * sizeof(struct edge), off = k * cap * sizeof(struct edge);
+            if(pread(prep.block_fd[b], mem, bytes, off) != bytes){
+                perror("pread");
+                ret = -1;
+                break;
+            }
+            qsort(mem, n, sizeof(struct edge), edge_cmp);
+            ret = write_all(tmp_fd, mem, bytes, off);
+            runs[k] = (struct run_reader){.fd = tmp_fd, .off = off, .end = off + bytes};
+        }
+
+        // The merge reuses the sort memory for the run buffers
+        if(ret == 0){
+            long long per_run = budget / num_runs / sizeof(struct edge) * sizeof(struct edge);
+            struct edge head[num_runs];
+            bool live[num_runs];
+            if(per_run > PREP_RUN_BUF / 16)
+                per_run = PREP_RUN_BUF / 16;
+            for(long long k = 0; k < num_runs; k++){
+                runs[k].buf = (struct edge*)((char*)mem + k * per_run);
+                live[k] = run_next(&runs[k], &head[k]);
+            }
+            while(true){
+                long long best = -1;
+                for(long long k = 0; k < num_runs; k++){
+                    if(live[k] && (best < 0 || edge_cmp(&head[k], &head[best]) < 0))
+                        best = k;
+                }
+                if(best < 0)
+                    break;
+                block_out_edge(&out, head[best]);
+                live[best] = run_next(&runs[best], &head[best]);
+            }
+        }
+        free(runs);
+        close(tmp_fd);
+    }
+    if(block_out_close(&out, num_edges) < 0)
+        ret = -1;
+    return ret;
+}
+
+static void *sort_worker(void *arg)
+{
+    long long budget = prep.mem / prep.threads;
+    struct edge *mem = malloc(budget);
+    int B = prep.num_partitions * prep.num_partitions;
+    long ret = 0;
+
+    (void)arg;
+    if(!mem)
+        return (void*)-1L;
+    while(ret == 0){
+        int b = __atomic_fetch_add(&prep.next_block, 1, __ATOMIC_RELAXED);
+        if(b >= B)
+            break;
+        ret = sort_block(b / prep.num_partitions, b % prep.num_partitions, budget, mem);
+    }
+    free(mem);
+    return (void*)ret;
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    return x < y ? -1 : x > y;
+}
+
+// New ids of the vertices, from the adjacency of the input graph
+static int relabel_vertices()
+{
+    const long long V = prep.num_vertices;
+    struct graph_csr *g = &prep.csr;
+    int *map;
+    char path[512];
+    int fd, ret;
+
+    g->num_vertices = V;
+    g->out_off = calloc(V + 1, sizeof(long long));
+    g->in_off = calloc(V + 1, sizeof(long long));
+    prep.perm = malloc((V ? V : 1) * sizeof(int));
+    if(!g->out_off || !g->in_off || !prep.perm){
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    if(scan_input(PASS_DEGREE) < 0)
+        return -1;
+    for(long long v = 0; v < V; v++){
+        g->out_off[v + 1] += g->out_off[v];
+        g->in_off[v + 1] += g->in_off[v];
+    }
+    g->out_adj = malloc((g->out_off[V] ? g->out_off[V] : 1) * sizeof(int));
+    g->in_adj = malloc((g->in_off[V] ? g->in_off[V] : 1) * sizeof(int));
+    prep.out_cursor = malloc((V ? V : 1) * sizeof(long long));
+    prep.in_cursor = malloc((V ? V : 1) * sizeof(long long));
+    if(!g->out_adj || !g->in_adj || !prep.out_cursor || !prep.in_cursor){
+        fprintf(stderr, "Out of memory for the adjacency of %lld edges\n", g->out_off[V]);
+        return -1;
+    }
+    memcpy(prep.out_cursor, g->out_off, V * sizeof(long long));
+    memcpy(prep.in_cursor, g->in_off, V * sizeof(long long));
+    if(scan_input(PASS_ADJ) < 0)
+        return -1;
+    free(prep.out_cursor);
+    free(prep.in_cursor);
+
+    // The threads filled the lists in any order
+    for(long long v = 0; v < V; v++){
+        qsort(g->out_adj + g->out_off[v], g->out_off[v + 1] - g->out_off[v], sizeof(int), int_cmp);
+        qsort(g->in_adj + g->in_off[v], g->in_off[v + 1] - g->in_off[v], sizeof(int), int_cmp);
+    }
+    ret = graph_reorder(prep.reorder, g, prep.perm);
+    free(g->out_off), free(g->in_off), free(g->out_adj), free(g->in_adj);
+    if(ret < 0){
+        fprintf(stderr, "Out of memory for the %s order\n", graph_reorder_name(prep.reorder));
+        return -1;
+    }
+
+    map = malloc((V ? V : 1) * sizeof(int));
+    if(!map)
+        return -1;
+    for(long long v = 0; v < V; v++)
+        map[prep.perm[v]] = v;
+    snprintf(path, sizeof(path), "%s/vertex_map", prep.output);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ret = fd < 0 ? -1 : write_all(fd, map, V * sizeof(int), 0);
+    if(ret < 0)
+        perror("vertex_map");
+    if(fd >= 0)
+        close(fd);
+    free(map);
+    return ret;
+}
+
+static int write_meta()
+{
+    char path[512];
+    FILE *file;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/meta", prep.output);
+    if(!(file = fopen(path, "w"))){
+        perror("meta");
+        return -1;
+    }
+    fprintf(file, "0 %lld %lld %d 0\n", prep.num_vertices, prep.num_edges, prep.num_partitions);
+    fclose(file);
+
+    snprintf(path, sizeof(path), "%s/outdegrees", prep.output);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write_all(fd, prep.outdegree, prep.num_vertices * sizeof(int), 0) < 0){
+        perror("outdegrees");
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s -i <edge list> -o <dataset dir> -p <partitions> [-t: text input] [-v <vertices>]\n"
+        "       [-j <threads>] [-m <memory MB>] [-s: sorted blocks] [-c: CSC blocks] [-z: compressed blocks]\n"
+        "       [-r degree|rcm|gorder: vertex relabeling]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    long long s = get_time_ns(), t;
+    int opt, B;
+
+    while((opt = getopt(argc, argv, "i:o:p:tv:j:m:sczr:")) != -1){
+        switch(opt){
+        case 'i': prep.input = optarg; break;
+        case 'o': prep.output = optarg; break;
+        case 'p': prep.num_partitions = atoi(optarg); break;
+        case 't': prep.text = true; break;
+        case 'v': prep.num_vertices = atoll(optarg); break;
+        case 'j': prep.threads = atoi(optarg); break;
+        case 'm': prep.mem = atoll(optarg) << 20; break;
+        case 's': prep.sorted = true; break;
+        case 'c': prep.csc = true; break;
+        case 'z': prep.compressed = true; break;
+        case 'r':
+            if((prep.reorder = graph_reorder_method(optarg)) < 0){
+                fprintf(stderr, "Unknown relabeling %s\n", optarg);
+                return 1;
+            }
+            break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if(!prep.input || !prep.output || prep.num_partitions <= 0 || prep.num_partitions > MAX_PARTITION || prep.threads <= 0){
+        usage(argv[0]);
+        return 1;
+    }
+
+    prep.in_fd = open(prep.input, O_RDONLY);
+    if(prep.in_fd < 0 || fstat(prep.in_fd, &st) < 0){
+        perror(prep.input);
+        return 1;
+    }
+    prep.input_size = st.st_size;
+    if(mkdir(prep.output, 0755) < 0 && errno != EEXIST){
+        perror(prep.output);
+        return 1;
+    }
+
+    // 1. Number of vertices, unless given
+    if(prep.num_vertices < 0){
+        prep.num_vertices = 0;
+        if(scan_input(PASS_MAX_VERTEX) < 0)
+            return 1;
+    }
+    if(prep.num_vertices > 0x7fffffffLL){
+        fprintf(stderr, "%lld vertices do not fit the int32 vertex ids\n", prep.num_vertices);
+        return 1;
+    }
+
+    // Optional relabeling, the later passes map every edge to the new ids
+    if(prep.reorder != REORDER_NONE){
+        if(relabel_vertices() < 0)
+            return 1;
+        t = get_time_ns();
+        printf("Relabeled %lld vertices by %s (%lld ms)\n", prep.num_vertices, graph_reorder_name(prep.reorder),
+            (t - s) / 1000000);
+    }
+
+    // 2. Outdegrees and block sizes
+    B = prep.num_partitions * prep.num_partitions;
+    prep.outdegree = calloc(prep.num_vertices ? prep.num_vertices : 1, sizeof(int));
+    prep.block_edges = calloc(B, sizeof(long long));
+    prep.block_cursor = calloc(B, sizeof(long long));
+    prep.block_fd = calloc(B, sizeof(int));
+    if(!prep.outdegree || !prep.block_edges || !prep.block_cursor || !prep.block_fd){
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if(scan_input(PASS_COUNT) < 0)
+        return 1;
+    for(int b = 0; b < B; b++)
+        prep.num_edges += prep.block_edges[b];
+    t = get_time_ns();
+    printf("%lld vertices, %lld edges, %d x %d blocks (%lld ms)\n", prep.num_vertices, prep.num_edges,
+        prep.num_partitions, prep.num_partitions, (t - s) / 1000000);
+
+    // 3. Edges into the block files, every thread appends to a reserved range of the block
+    for(int b = 0; b < B; b++){
+        char path[512];
+        snprintf(path, sizeof(path), "%s/block-%d-%d", prep.output, b / prep.num_partitions, b % prep.num_partitions);
+        prep.block_fd[b] = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(prep.block_fd[b] < 0){
+            fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+    if(scan_input(PASS_DISTRIBUTE) < 0 || write_meta() < 0)
+        return 1;
+    printf("Wrote %s (%lld ms)\n", prep.output, (get_time_ns() - s) / 1000000);
+
+    // 4. Optional sorted, CSC and compressed blocks
+    if(prep.sorted || prep.csc || prep.compressed){
+        pthread_t threads[prep.threads];
+        int ret = 0;
+        for(int i = 0; i < prep.threads; i++)
+            pthread_create(&threads[i], NULL, sort_worker, NULL);
+        for(int i = 0; i < prep.threads; i++){
+            void *r;
+            pthread_join(threads[i], &r);
+            if(r)
+                ret = -1;
+        }
+        if(ret < 0)
+            return 1;
+        printf("Wrote the%s%s%s blocks (%lld ms)\n", prep.sorted ? " sorted" : "", prep.csc ? " CSC" : "",
+            prep.compressed ? " compressed" : "", (get_time_ns() - s) / 1000000);
+    }
+
+    for(int b = 0; b < B; b++)
+        close(prep.block_fd[b]);
+    close(prep.in_fd);
+    return 0;
+}
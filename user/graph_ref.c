@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../core/proc_edge_struct.h"
+#include "../core/params.h"
+#include "graph_ref.h"
+
+// Same as the CSDs, see io.c
+static unsigned short ref_hash_edge(unsigned int u, unsigned int v)
+{
+    unsigned int h = u;
+    h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return (unsigned short)(h & 1023);
+}
+
+static unsigned short ref_rand(unsigned int *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state & 1023u;
+}
+
+// Label of u from its neighbor label counts, ties broken by the vertex id
+static inline int ref_label(float value, long long u)
+{
+    int freq0 = (int)value & 0xFFFF, freq1 = ((int)value >> 16) & 0xFFFF;
+    if(freq0 != freq1)
+        return freq1 > freq0;
+    return u % 2;
+}
+
+static long long ref_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int *read_file(const char *path, long long *bytes)
+{
+    struct stat st;
+    FILE *file;
+    int *data;
+
+    if(stat(path, &st) < 0 || !(file = fopen(path, "rb"))){
+        perror(path);
+        return NULL;
+    }
+    data = malloc(st.st_size > 0 ? st.st_size : 1);
+    if(!data || (long long)fread(data, 1, st.st_size, file) != (long long)st.st_size){
+        fprintf(stderr, "Failed to read %s\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *bytes = st.st_size;
+    return data;
+}
+
+int graph_ref_load(struct graph_ref *g, const char *dataset_path, int algorithm, int threads)
+{
+    char path[512];
+    long tmp[3];
+    long long bytes;
+    FILE *file;
+
+    memset(g, 0, sizeof(*g));
+    g->algorithm = algorithm;
+    g->threads = threads > 0 ? threads : 1;
+
+    snprintf(path, sizeof(path), "%s/meta", dataset_path);
+    if(!(file = fopen(path, "r"))){
+        perror(path);
+        return -1;
+    }
+    if(fscanf(file, "%ld %lld %ld %d %ld", &tmp[0], &g->num_vertices, &tmp[1], &g->num_partitions, &tmp[2]) != 5
+        || g->num_partitions <= 0 || g->num_partitions > MAX_PARTITION){
+        fprintf(stderr, "Bad %s\n", path);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    snprintf(path, sizeof(path), "%s/outdegrees", dataset_path);
+    if(!(g->outdegree = read_file(path, &bytes)))
+        return -1;
+    g->curr = malloc((g->num_vertices ? g->num_vertices : 1) * sizeof(float));
+    g->next = malloc((g->num_vertices ? g->num_vertices : 1) * sizeof(float));
+    g->blocks = calloc(g->num_partitions * g->num_partitions, sizeof(struct graph_ref_block));
+    if(!g->curr || !g->next || !g->blocks)
+        return -1;
+    for(int b = 0; b < g->num_partitions * g->num_partitions; b++){
+        struct graph_ref_block *block = &g->blocks[b];
+        snprintf(path, sizeof(path), "%s/block-%d-%d", dataset_path, b / g->num_partitions, b % g->num_partitions);
+        if(!(block->edges = read_file(path, &bytes)))
+            return -1;
+        block->num_edges = bytes / EDGE_SIZE;
+        if(graph_ref_set_chunks(g, b / g->num_partitions, b % g->num_partitions, 1, &block->num_edges) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void graph_ref_free(struct graph_ref *g)
+{
+    if(g->blocks){
+        for(int b = 0; b < g->num_partitions * g->num_partitions; b++){
+            free(g->blocks[b].edges);
+            free(g->blocks[b].chunk_edges);
+        }
+    }
+    free(g->blocks);
+    free(g->outdegree);
+    free(g->curr);
+    free(g->next);
+    memset(g, 0, sizeof(*g));
+}
+
+int graph_ref_set_chunks(struct graph_ref *g, int r, int c, int num_chunks, const long long *chunk_edges)
+{
+    struct graph_ref_block *block = &g->blocks[r * g->num_partitions + c];
+    long long total = 0;
+    long long *copy;
+
+    if(num_chunks <= 0 || num_chunks > GRAPH_REF_MAX_CHUNKS)
+        return -1;
+    for(int k = 0; k < num_chunks; k++)
+        total += chunk_edges[k];
+    if(total != block->num_edges){
+        fprintf(stderr, "Chunks of block %d-%d hold %lld of its %lld edges\n", r, c, total, block->num_edges);
+        return -1;
+    }
+    if(!(copy = malloc(num_chunks * sizeof(long long))))
+        return -1;
+    memcpy(copy, chunk_edges, num_chunks * sizeof(long long));
+    free(block->chunk_edges);
+    block->chunk_edges = copy;
+    block->num_chunks = num_chunks;
+    return 0;
+}
+
+// Column c of an iteration: every row block into the partition of c
+static void ref_column(struct graph_ref *g, int c, double *sum, int *freq)
+{
+    const int P = g->num_partitions;
+    __u64 begin, end;
+
+    partition_range(g->num_vertices, P, c, &begin, &end);
+    if(g->algorithm == 0){
+        memset(sum, 0, (end - begin) * sizeof(double));
+        for(int r = 0; r < P; r++){
+            const struct graph_ref_block *block = &g->blocks[r * P + c];
+            for(const int *e = block->edges; e < block->edges + 2 * block->num_edges; e += 2)
+                sum[e[1] - begin] += g->curr[e[0]] / g->outdegree[e[0]];
+        }
+        for(__u64 v = begin; v < end; v++)
+            g->next[v] = 0.15f + 0.85f * (float)sum[v - begin];
+    }
+    else if(g->algorithm == 1){
+        memset(freq, 0, 2 * (end - begin) * sizeof(int));
+        for(int r = 0; r < P; r++){
+            const struct graph_ref_block *block = &g->blocks[r * P + c];
+            for(const int *e = block->edges; e < block->edges + 2 * block->num_edges; e += 2)
+                freq[2 * (e[1] - begin) + ref_label(g->curr[e[0]], e[0])]++;
+        }
+        for(__u64 v = begin; v < end; v++)
+            g->next[v] = (float)(freq[2 * (v - begin)] | (freq[2 * (v - begin) + 1] << 16));
+    }
+    else{
+        for(__u64 v = begin; v < end; v++)
+            g->next[v] = 0.0f;
+        for(int r = 0; r < P; r++){
+            const struct graph_ref_block *block = &g->blocks[r * P + c];
+            const int *e = block->edges;
+            for(int k = 0; k < block->num_chunks; k++){
+                const int *e_end = e + 2 * block->chunk_edges[k];
+                unsigned int state = 0;
+                for(; e < e_end; e += 2){
+                    if(g->curr[e[0]] == 1 && ref_rand(&state) < ref_hash_edge(e[0], e[1]))
+                        g->next[e[1]] = 1;
+                }
+            }
+        }
+    }
+}
+
+static void *ref_worker(void *arg)
+{
+    struct graph_ref *g = arg;
+    long long max_size = g->num_vertices / g->num_partitions + 1;
+    double *sum = malloc(max_size * sizeof(double));
+    int *freq = malloc(2 * max_size * sizeof(int));
+    int c;
+
+    if(!sum || !freq){
+        free(sum), free(freq);
+        return (void*)-1L;
+    }
+    while((c = __atomic_fetch_add(&g->next_column, 1, __ATOMIC_RELAXED)) < g->num_partitions)
+        ref_column(g, c, sum, freq);
+    free(sum), free(freq);
+    return NULL;
+}
+
+long long graph_ref_run(struct graph_ref *g, int num_iters)
+{
+    pthread_t threads[g->threads];
+    long long s = ref_time_ns();
+
+    // Initial values of init_hmb_values()
+    for(long long v = 0; v < g->num_vertices; v++){
+        if(g->algorithm == 0)
+            g->curr[v] = 1.0f;
+        else if(g->algorithm == 1)
+            g->curr[v] = 0.0f;
+        else
+            g->curr[v] = v % 100000 == 0 ? 1.0f : 0.0f;
+    }
+    for(int iter = 0; iter < num_iters; iter++){
+        float *tmp;
+        int err = 0;
+
+        g->next_column = 0;
+        for(int t = 0; t < g->threads; t++)
+            pthread_create(&threads[t], NULL, ref_worker, g);
+        for(int t = 0; t < g->threads; t++){
+            void *ret;
+            pthread_join(threads[t], &ret);
+            if(ret)
+                err = 1;
+        }
+        if(err){
+            fprintf(stderr, "Reference run out of memory\n");
+            return -1;
+        }
+        tmp = g->curr, g->curr = g->next, g->next = tmp;
+    }
+    return ref_time_ns() - s;
+}
+
+double graph_ref_compare(const struct graph_ref *g, const volatile float *values)
+{
+    double error = 0;
+
+    for(long long v = 0; v < g->num_vertices; v++){
+        if(g->algorithm == 0)
+            error += values[v] > g->curr[v] ? values[v] - g->curr[v] : g->curr[v] - values[v];
+        else if(g->algorithm == 1)
+            error += ref_label(values[v], v) != ref_label(g->curr[v], v);
+        else
+            error += values[v] != g->curr[v];
+    }
+    return error;
+}
@@ -0,0 +1,47 @@
+#ifndef GRAPH_REF_H
+#define GRAPH_REF_H
+
+/*
+ * Host-only reference engine: the CSD algorithms over the same block files, in host memory.
+ * It checks the values the CSDs leave in the HMB and gives the baseline of the offload speedup.
+ * Every thread takes whole columns, so the destination partitions need no locking.
+ *
+ * PageRank is compared by L1 error, the partial sums being added up in another order.
+ * Label propagation by the labels: the CSDs count the neighbor labels in floats, exact up to 2^24.
+ * Dispersion exactly: its random sequence restarts with every CSD task, the chunks of a block are
+ * replayed as the CSDs hold them (graph_ref_set_chunks()).
+ */
+#define GRAPH_REF_MAX_CHUNKS 1024
+
+struct graph_ref_block {
+    int *edges;                 /* (src, dst) pairs, in file order */
+    long long num_edges;
+    int num_chunks;             /* Tasks the block is processed in, one by default */
+    long long *chunk_edges;
+};
+
+struct graph_ref {
+    long long num_vertices;
+    int num_partitions;
+    int algorithm;              /* 0: Pagerank, 1: Label Propagation, 2: Dispersion */
+    int threads;
+    int *outdegree;
+    struct graph_ref_block *blocks;     /* [num_partitions * num_partitions] */
+    float *curr, *next;         /* Values after graph_ref_run() in curr */
+    int next_column;            /* Next column to take in an iteration */
+};
+
+/* Read meta, outdegrees and every block of the dataset */
+int graph_ref_load(struct graph_ref *g, const char *dataset_path, int algorithm, int threads);
+void graph_ref_free(struct graph_ref *g);
+
+/* Block (r, c) as CSD tasks of chunk_edges[i] edges each, in file order */
+int graph_ref_set_chunks(struct graph_ref *g, int r, int c, int num_chunks, const long long *chunk_edges);
+
+/* num_iters iterations from the initial values of the host, returns the time in ns */
+long long graph_ref_run(struct graph_ref *g, int num_iters);
+
+/* L1 error for Pagerank, number of differing vertices otherwise */
+double graph_ref_compare(const struct graph_ref *g, const volatile float *values);
+
+#endif // GRAPH_REF_H
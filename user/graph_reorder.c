@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graph_reorder.h"
+
+static const char *reorder_names[] = {"none", "degree", "rcm", "gorder"};
+
+int graph_reorder_method(const char *name)
+{
+    for(int i = 0; i < (int)(sizeof(reorder_names) / sizeof(reorder_names[0])); i++){
+        if(strcmp(name, reorder_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char *graph_reorder_name(int method)
+{
+    if(method < 0 || method > REORDER_GORDER)
+        return "unknown";
+    return reorder_names[method];
+}
+
+static inline long long degree(const struct graph_csr *g, long long v)
+{
+    return g->out_off[v + 1] - g->out_off[v] + g->in_off[v + 1] - g->in_off[v];
+}
+
+// qsort() has no context argument
+static const struct graph_csr *sort_graph;
+
+static int cmp_degree_desc(const void *a, const void *b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    long long dx = degree(sort_graph, x), dy = degree(sort_graph, y);
+    if(dx != dy)
+        return dx > dy ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_degree_asc(const void *a, const void *b)
+{
+    return -cmp_degree_desc(a, b);
+}
+
+static int *vertices_by_degree(const struct graph_csr *g, int (*cmp)(const void*, const void*))
+{
+    int *order = malloc(g->num_vertices * sizeof(int));
+
+    if(!order)
+        return NULL;
+    for(long long v = 0; v < g->num_vertices; v++)
+        order[v] = v;
+    sort_graph = g;
+    qsort(order, g->num_vertices, sizeof(int), cmp);
+    return order;
+}
+
+// Hub sorting: the high-degree vertices, touched by most edges, share the first pages
+static int reorder_degree(const struct graph_csr *g, int *perm)
+{
+    int *order = vertices_by_degree(g, cmp_degree_desc);
+
+    if(!order)
+        return -1;
+    for(long long i = 0; i < g->num_vertices; i++)
+        perm[order[i]] = i;
+    free(order);
+    return 0;
+}
+
+// Breadth-first from a low-degree vertex of every component, neighbors by increasing degree, then reversed
+static int reorder_rcm(const struct graph_csr *g, int *perm)
+{
+    const long long V = g->num_vertices;
+    int *starts = vertices_by_degree(g, cmp_degree_asc);
+    int *order = malloc(V * sizeof(int));
+    char *visited = calloc(V, 1);
+    long long head = 0, tail = 0;
+
+    if(!starts || !order || !visited){
+        free(starts), free(order), free(visited);
+        return -1;
+    }
+    sort_graph = g;
+    for(long long i = 0; i < V; i++){
+        if(visited[starts[i]])
+            continue;
+        visited[starts[i]] = 1;
+        order[tail++] = starts[i];
+        while(head < tail){
+            int v = order[head++];
+            long long first = tail;
+            for(long long e = g->out_off[v]; e < g->out_off[v + 1]; e++){
+                if(!visited[g->out_adj[e]]){
+                    visited[g->out_adj[e]] = 1;
+                    order[tail++] = g->out_adj[e];
+                }
+            }
+            for(long long e = g->in_off[v]; e < g->in_off[v + 1]; e++){
+                if(!visited[g->in_adj[e]]){
+                    visited[g->in_adj[e]] = 1;
+                    order[tail++] = g->in_adj[e];
+                }
+            }
+            qsort(order + first, tail - first, sizeof(int), cmp_degree_asc);
+        }
+    }
+    for(long long i = 0; i < V; i++)
+        perm[order[i]] = V - 1 - i;
+    free(starts), free(order), free(visited);
+    return 0;
+}
+
+// Gorder's priority queue: every score change is +1 or -1, so the vertices are kept in lists per score
+struct unit_heap {
+    int *key, *prev, *next;
+    int *head;          // First vertex of each score, -1 if none
+    int num_keys;
+    int top;            // No vertex has a higher score
+    char *removed;
+};
+
+static void unit_heap_link(struct unit_heap *h, int v)
+{
+    int k = h->key[v];
+    h->prev[v] = -1;
+    h->next[v] = h->head[k];
+    if(h->head[k] >= 0)
+        h->prev[h->head[k]] = v;
+    h->head[k] = v;
+}
+
+static void unit_heap_unlink(struct unit_heap *h, int v)
+{
+    if(h->prev[v] >= 0)
+        h->next[h->prev[v]] = h->next[v];
+    else
+        h->head[h->key[v]] = h->next[v];
+    if(h->next[v] >= 0)
+        h->prev[h->next[v]] = h->prev[v];
+}
+
+static int unit_heap_init(struct unit_heap *h, long long n)
+{
+    h->key = calloc(n, sizeof(int));
+    h->prev = malloc(n * sizeof(int));
+    h->next = malloc(n * sizeof(int));
+    h->removed = calloc(n, 1);
+    h->num_keys = 1024;
+    h->head = malloc(h->num_keys * sizeof(int));
+    if(!h->key || !h->prev || !h->next || !h->removed || !h->head)
+        return -1;
+    for(int k = 0; k < h->num_keys; k++)
+        h->head[k] = -1;
+    h->top = 0;
+    // Ties go to the lowest id
+    for(long long v = n - 1; v >= 0; v--)
+        unit_heap_link(h, v);
+    return 0;
+}
+
+static void unit_heap_free(struct unit_heap *h)
+{
+    free(h->key), free(h->prev), free(h->next), free(h->removed), free(h->head);
+}
+
+static int unit_heap_inc(struct unit_heap *h, int v)
+{
+    if(h->removed[v])
+        return 0;
+    if(h->key[v] + 1 >= h->num_keys){
+        int *head = realloc(h->head, 2 * h->num_keys * sizeof(int));
+        if(!head)
+            return -1;
+        for(int k = h->num_keys; k < 2 * h->num_keys; k++)
+            head[k] = -1;
+        h->head = head;
+        h->num_keys *= 2;
+    }
+    unit_heap_unlink(h, v);
+    h->key[v]++;
+    unit_heap_link(h, v);
+    if(h->key[v] > h->top)
+        h->top = h->key[v];
+    return 0;
+}
+
+static void unit_heap_dec(struct unit_heap *h, int v)
+{
+    if(h->removed[v])
+        return;
+    unit_heap_unlink(h, v);
+    h->key[v]--;
+    unit_heap_link(h, v);
+}
+
+static void unit_heap_remove(struct unit_heap *h, int v)
+{
+    unit_heap_unlink(h, v);
+    h->removed[v] = 1;
+}
+
+static int unit_heap_pop(struct unit_heap *h)
+{
+    int v;
+    while(h->top > 0 && h->head[h->top] < 0)
+        h->top--;
+    v = h->head[h->top];
+    unit_heap_remove(h, v);
+    return v;
+}
+
+/*
+ * Score of the vertices still to place against v: +1 per edge between them and per in-neighbor they
+ * share (siblings). In-neighbors of a degree above hub are not expanded, as in the Gorder paper's
+ * implementation, otherwise a hub makes every step cost its degree squared.
+ */
+static int gorder_update(struct unit_heap *h, const struct graph_csr *g, int v, long long hub, int delta)
+{
+    for(long long e = g->out_off[v]; e < g->out_off[v + 1]; e++){
+        if(delta > 0 && unit_heap_inc(h, g->out_adj[e]) < 0)
+            return -1;
+        if(delta < 0)
+            unit_heap_dec(h, g->out_adj[e]);
+    }
+    for(long long e = g->in_off[v]; e < g->in_off[v + 1]; e++){
+        int u = g->in_adj[e];
+        if(delta > 0 && unit_heap_inc(h, u) < 0)
+            return -1;
+        if(delta < 0)
+            unit_heap_dec(h, u);
+        if(g->out_off[u + 1] - g->out_off[u] > hub)
+            continue;
+        for(long long f = g->out_off[u]; f < g->out_off[u + 1]; f++){
+            if(g->out_adj[f] == v)
+                continue;
+            if(delta > 0 && unit_heap_inc(h, g->out_adj[f]) < 0)
+                return -1;
+            if(delta < 0)
+                unit_heap_dec(h, g->out_adj[f]);
+        }
+    }
+    return 0;
+}
+
+static int reorder_gorder(const struct graph_csr *g, int *perm)
+{
+    const long long V = g->num_vertices;
+    struct unit_heap h;
+    int *order = malloc(V * sizeof(int));
+    long long hub = 64, start = 0;
+
+    if(!order || unit_heap_init(&h, V) < 0){
+        free(order);
+        unit_heap_free(&h);
+        return -1;
+    }
+    while(hub * hub < V)
+        hub++;
+
+    // The vertex with the most in-neighbors goes first
+    for(long long v = 1; v < V; v++){
+        if(g->in_off[v + 1] - g->in_off[v] > g->in_off[start + 1] - g->in_off[start])
+            start = v;
+    }
+    order[0] = start;
+    unit_heap_remove(&h, start);
+    for(long long i = 1; i < V; i++){
+        if(gorder_update(&h, g, order[i - 1], hub, 1) < 0){
+            free(order);
+            unit_heap_free(&h);
+            return -1;
+        }
+        // The vertex leaving the window no longer counts
+        if(i > GORDER_WINDOW)
+            gorder_update(&h, g, order[i - GORDER_WINDOW - 1], hub, -1);
+        order[i] = unit_heap_pop(&h);
+        if(i % 10000000 == 0)
+            printf("Gorder: %lld/%lld vertices\n", i, V);
+    }
+    for(long long i = 0; i < V; i++)
+        perm[order[i]] = i;
+    free(order);
+    unit_heap_free(&h);
+    return 0;
+}
+
+int graph_reorder(int method, const struct graph_csr *g, int *perm)
+{
+    switch(method){
+    case REORDER_DEGREE:
+        return reorder_degree(g, perm);
+    case REORDER_RCM:
+        return reorder_rcm(g, perm);
+    case REORDER_GORDER:
+        return reorder_gorder(g, perm);
+    default:
+        for(long long v = 0; v < g->num_vertices; v++)
+            perm[v] = v;
+        return 0;
+    }
+}
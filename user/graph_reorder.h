@@ -0,0 +1,30 @@
+#ifndef GRAPH_REORDER_H
+#define GRAPH_REORDER_H
+
+/*
+ * Vertex relabeling for locality, run by graph_prep before the edges are partitioned.
+ * The new ids put vertices used together next to each other, so the src[u] and dst[v]
+ * accesses of an edge block stay within fewer cache lines and pages.
+ */
+#define REORDER_NONE 0
+#define REORDER_DEGREE 1    /* Hub sorting: decreasing in + out degree */
+#define REORDER_RCM 2       /* Reverse Cuthill-McKee over the undirected graph */
+#define REORDER_GORDER 3    /* Gorder: greedy window of GORDER_WINDOW vertices sharing neighbors */
+
+#define GORDER_WINDOW 5
+
+/* Out and in adjacency, lists sorted by vertex id */
+struct graph_csr {
+    long long num_vertices;
+    long long *out_off, *in_off;    /* [num_vertices + 1] */
+    int *out_adj, *in_adj;
+};
+
+/* Method from its name, -1 if unknown */
+int graph_reorder_method(const char *name);
+const char *graph_reorder_name(int method);
+
+/* perm[old id] = new id */
+int graph_reorder(int method, const struct graph_csr *g, int *perm);
+
+#endif // GRAPH_REORDER_H
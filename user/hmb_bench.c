@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hmb_mmap.h"
+
+/*
+ * HMB mapping microbenchmark: the PageRank aggregation of conv_partition and the value reset
+ * of init_hmb_values over the mapped value buffers. Run once with hmb.ko loaded with
+ * huge_pages=0 and once with huge_pages=1 to compare 4KB and huge page mappings.
+ * Ex: sudo ./hmb_bench 100000000 8 10
+ */
+
+struct hmb_device hmb_dev;
+
+static long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Same accesses as conv_partition for PageRank with the CSD-major partial sums
+static void conv_values(volatile float *buf, long long num_vertices, int num_csds)
+{
+    for(long long v = 0; v < num_vertices; v++){
+        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+            buf[v] += buf[(csd_id + 1) * num_vertices + v];
+            buf[(csd_id + 1) * num_vertices + v] = 0.0;
+        }
+        buf[v] = 0.15f + 0.85f * buf[v];
+    }
+}
+
+static void reset_values(volatile float *buf, long long num_vertices, int num_csds)
+{
+    for(long long i = 0; i < num_vertices * (num_csds + 1); i++)
+        buf[i] = 0.0f;
+}
+
+// kB of the /dev/hmb_mem mappings backed by huge entries, from /proc/self/smaps
+static long long huge_mapped_kb()
+{
+    FILE *file = fopen("/proc/self/smaps", "r");
+    char line[512];
+    unsigned long long start, end;
+    long long kb, total = 0;
+    int hmb = 0;
+
+    if(!file){
+        perror("/proc/self/smaps");
+        return -1;
+    }
+    while(fgets(line, sizeof(line), file)){
+        // A vma header starts with its address range, then come its fields
+        if(sscanf(line, "%llx-%llx", &start, &end) == 2)
+            hmb = strstr(line, "/dev/hmb_mem") != NULL;
+        else if(hmb && (sscanf(line, "FilePmdMapped: %lld kB", &kb) == 1 || sscanf(line, "AnonHugePages: %lld kB", &kb) == 1))
+            total += kb;
+    }
+    fclose(file);
+    return total;
+}
+
+static void report(const char *name, long long ns, long long bytes, int rounds)
+{
+    printf("%-8s %10.3f ms/round %8.2f GB/s\n", name, ns / 1e6 / rounds, 1.0 * bytes * rounds / ns);
+}
+
+int main(int argc, char* argv[])
+{
+    long long num_vertices, s, e, conv_bytes, reset_bytes;
+    int num_csds, rounds = 10;
+    volatile float *buf;
+
+    if(argc < 3){
+        printf("Usage: %s <num_vertices> <num_csds> [rounds]\n", argv[0]);
+        return 1;
+    }
+    num_vertices = atoll(argv[1]);
+    num_csds = atoi(argv[2]);
+    if(argc >= 4)
+        rounds = atoi(argv[3]);
+
+    if(hmb_init(&hmb_dev) < 0)
+        return 1;
+    if(hmb_check_layout(&hmb_dev, num_vertices, num_csds, hmb_dev.layout.num_partitions) < 0){
+        hmb_cleanup(&hmb_dev);
+        return 1;
+    }
+    buf = hmb_dev.buf0.virt_addr;
+
+    // Every value and partial sum is read and written once per round
+    conv_bytes = 2LL * (num_csds + 1) * num_vertices * sizeof(float);
+    reset_bytes = (num_csds + 1) * num_vertices * sizeof(float);
+
+    // First touch populates the page tables
+    s = get_time_ns();
+    reset_values(buf, num_vertices, num_csds);
+    e = get_time_ns();
+    report("fault", e - s, reset_bytes, 1);
+    printf("huge_kb %lld\n", huge_mapped_kb());
+
+    s = get_time_ns();
+    for(int i = 0; i < rounds; i++)
+        reset_values(buf, num_vertices, num_csds);
+    e = get_time_ns();
+    report("reset", e - s, reset_bytes, rounds);
+
+    s = get_time_ns();
+    for(int i = 0; i < rounds; i++)
+        conv_values(buf, num_vertices, num_csds);
+    e = get_time_ns();
+    report("conv", e - s, conv_bytes, rounds);
+
+    hmb_cleanup(&hmb_dev);
+    return 0;
+}
@@ -5,10 +5,26 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include "hmb_mmap.h"
 
+static void *hmb_map_region(struct hmb_device *dev, int id, const char *name)
+{
+    struct hmb_region_desc *region = &dev->layout.regions[id];
+    void *addr = mmap(NULL, region->size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED, dev->fd, region->offset);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "mmap %s failed: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    return addr;
+}
+
 int hmb_init(struct hmb_device *dev)
 {
+    struct hmb_layout *header;
+
     /* Open the device */
     dev->fd = open("/dev/hmb_mem", O_RDWR);
     if (dev->fd < 0) {
@@ -16,106 +32,176 @@ int hmb_init(struct hmb_device *dev)
         return -1;
     }
 
-    /* Map v_t+1 */
-    dev->buf1.size = HMB_SIZE;
-    dev->buf1.virt_addr = mmap(NULL, HMB_SIZE, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, 0);
-    if (dev->buf1.virt_addr == MAP_FAILED) {
-        perror("mmap buffer 1 (v_t+1)failed");
+    /* Read the layout header */
+    header = mmap(NULL, HMB_LAYOUT_HEADER_SIZE, PROT_READ, MAP_SHARED, dev->fd, 0);
+    if (header == MAP_FAILED) {
+        perror("mmap layout header failed");
         close(dev->fd);
+        dev->fd = -1;
         return -1;
     }
+    dev->layout = *header;
+    munmap(header, HMB_LAYOUT_HEADER_SIZE);
 
-    /* Map v_t+2 */
-    dev->buf2.size = HMB_SIZE;
-    dev->buf2.virt_addr = mmap(NULL, HMB_SIZE, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, HMB_SIZE);
-    if (dev->buf2.virt_addr == MAP_FAILED) {
-        perror("mmap buffer 2 (v_t+2) failed");
-        munmap((void*)dev->buf1.virt_addr, HMB_SIZE);
+    if (dev->layout.magic != HMB_LAYOUT_MAGIC || dev->layout.version != HMB_LAYOUT_VERSION) {
+        fprintf(stderr, "HMB layout mismatch: magic 0x%x version %u, expected 0x%x version %u\n",
+            dev->layout.magic, dev->layout.version, HMB_LAYOUT_MAGIC, HMB_LAYOUT_VERSION);
         close(dev->fd);
+        dev->fd = -1;
         return -1;
     }
 
-    /* Map v_t between host and csds*/
-    dev->buf0.size = HMB_SIZE / 4;
-    dev->buf0.virt_addr = mmap(NULL, HMB_SIZE / 4, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, HMB_SIZE * 2);
-    if (dev->buf0.virt_addr == MAP_FAILED) {
-        perror("mmap buffer 0 (v_t) failed");
-        munmap((void*)dev->buf1.virt_addr, HMB_SIZE);
-        munmap((void*)dev->buf2.virt_addr, HMB_SIZE);
-        close(dev->fd);
+    dev->buf0.size = dev->layout.regions[HMB_REGION_BUF0].size;
+    dev->buf1.size = dev->layout.regions[HMB_REGION_BUF1].size;
+    dev->buf2.size = dev->layout.regions[HMB_REGION_BUF2].size;
+    dev->done.size = dev->layout.regions[HMB_REGION_DONE].size;
+    dev->done_partition.size = dev->layout.regions[HMB_REGION_DONE_PARTITION].size;
+    dev->completion.size = dev->layout.regions[HMB_REGION_COMPLETION].size;
+    dev->control.size = dev->layout.regions[HMB_REGION_CONTROL].size;
+
+    dev->buf0.virt_addr = hmb_map_region(dev, HMB_REGION_BUF0, "buffer 0 (v_t)");
+    dev->buf1.virt_addr = hmb_map_region(dev, HMB_REGION_BUF1, "buffer 1 (v_t+1)");
+    dev->buf2.virt_addr = hmb_map_region(dev, HMB_REGION_BUF2, "buffer 2 (v_t+2)");
+    dev->done.virt_addr = hmb_map_region(dev, HMB_REGION_DONE, "done");
+    dev->done_partition.virt_addr = hmb_map_region(dev, HMB_REGION_DONE_PARTITION, "done_partition");
+    dev->completion.virt_addr = hmb_map_region(dev, HMB_REGION_COMPLETION, "completion");
+    dev->control.virt_addr = hmb_map_region(dev, HMB_REGION_CONTROL, "control");
+
+    if (!dev->buf0.virt_addr || !dev->buf1.virt_addr || !dev->buf2.virt_addr ||
+        !dev->done.virt_addr || !dev->done_partition.virt_addr ||
+        !dev->completion.virt_addr || !dev->control.virt_addr) {
+        hmb_cleanup(dev);
         return -1;
     }
 
-    /* Map done for normal values for edge blocks */
-    dev->done1.size = HMB_SIZE / 4;
-    dev->done1.virt_addr = mmap(NULL, HMB_SIZE / 4, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, HMB_SIZE * 2 + HMB_SIZE / 4);
-    if (dev->done1.virt_addr == MAP_FAILED) {
-        perror("mmap buffer done failed");
-        munmap((void*)dev->buf0.virt_addr, HMB_SIZE / 4);
-        munmap((void*)dev->buf1.virt_addr, HMB_SIZE);
-        munmap((void*)dev->buf2.virt_addr, HMB_SIZE);
-        close(dev->fd);
+    /* done1 and done2 are the done region seen for v_t+1 and v_t+2 */
+    dev->done1.iters = dev->done2.iters = dev->done.virt_addr;
+    dev->done1.counters = dev->done2.counters = dev->completion.virt_addr;
+    dev->done1.epoch = dev->done2.epoch = &dev->control.virt_addr[HMB_CONTROL_EPOCH];
+    dev->done1.role = HMB_ROLE_NEXT;
+    dev->done2.role = HMB_ROLE_FUTURE;
+
+    dev->wait_mode = HMB_WAIT_ADAPTIVE;
+    dev->spin_limit = HMB_SPIN_MIN;
+
+    return 0;
+}
+
+int hmb_check_layout(struct hmb_device *dev, long long num_vertices, int num_csds, int num_partitions)
+{
+    struct hmb_layout *layout = &dev->layout;
+
+    if ((long long)layout->num_vertices < num_vertices || (int)layout->num_csds < num_csds ||
+        (int)layout->num_partitions < num_partitions) {
+        fprintf(stderr, "HMB sized for %llu vertices, %u CSDs, %u partitions; need %lld, %d, %d\n",
+            (unsigned long long)layout->num_vertices, layout->num_csds, layout->num_partitions,
+            num_vertices, num_csds, num_partitions);
         return -1;
     }
+    if ((int)layout->num_partitions != num_partitions || (int)layout->num_csds != num_csds) {
+        fprintf(stderr, "HMB sized for %u CSDs and %u partitions but running %d and %d\n",
+            layout->num_csds, layout->num_partitions, num_csds, num_partitions);
+    }
+    return 0;
+}
 
-    /* Map done for future values */
-    dev->done2.size = HMB_SIZE / 4;
-    dev->done2.virt_addr = mmap(NULL, HMB_SIZE / 4, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, HMB_SIZE * 2 + HMB_SIZE * 2 / 4);
-    if (dev->done2.virt_addr == MAP_FAILED) {
-        perror("mmap buffer done failed");
-        munmap((void*)dev->buf0.virt_addr, HMB_SIZE / 4);
-        munmap((void*)dev->buf1.virt_addr, HMB_SIZE);
-        munmap((void*)dev->buf2.virt_addr, HMB_SIZE);
-        munmap((void*)dev->done1.virt_addr, HMB_SIZE / 4);
-        close(dev->fd);
-        return -1;
+void hmb_reset_done(struct hmb_device *dev)
+{
+    memset((void*)dev->done.virt_addr, 0, dev->done.size);
+    memset((void*)dev->done_partition.virt_addr, 0, dev->done_partition.size);
+    memset((void*)dev->completion.virt_addr, 0, dev->completion.size);
+    memset((void*)&dev->control.virt_addr[hmb_control_reduced(dev->layout.num_csds, 0)], 0,
+        dev->layout.num_partitions * sizeof(__u32));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void hmb_reset_epoch(struct hmb_device *dev)
+{
+    __atomic_store_n(&dev->control.virt_addr[HMB_CONTROL_EPOCH], 0, __ATOMIC_RELEASE);
+}
+
+volatile float *hmb_rotate_values(struct hmb_device *dev)
+{
+    // The CSDs wait in the end of iteration handshake and pick up the new epoch on their next task
+    __atomic_fetch_add(&dev->control.virt_addr[HMB_CONTROL_EPOCH], 1, __ATOMIC_ACQ_REL);
+    return hmb_value_buf(dev, HMB_ROLE_FUTURE);
+}
+
+static inline void hmb_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+void hmb_wait_next(struct hmb_device *dev, struct hmb_waiter *w)
+{
+    struct hmb_wait hw;
+
+    if (dev->wait_mode == HMB_WAIT_SPIN || w->spins < dev->spin_limit) {
+        w->spins++;
+        hmb_cpu_relax();
+        return;
     }
 
-    /* Map done for a partition (v_t+1) */
-    dev->done_partition.size = HMB_SIZE / 4;
-    dev->done_partition.virt_addr = mmap(NULL, HMB_SIZE / 4, 
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED, dev->fd, HMB_SIZE * 2 + HMB_SIZE * 3 / 4);
-    if (dev->done_partition.virt_addr == MAP_FAILED) {
-        perror("mmap buffer done failed");
-        munmap((void*)dev->buf0.virt_addr, HMB_SIZE / 4);
-        munmap((void*)dev->buf1.virt_addr, HMB_SIZE);
-        munmap((void*)dev->buf2.virt_addr, HMB_SIZE);
-        munmap((void*)dev->done1.virt_addr, HMB_SIZE / 4);
-        munmap((void*)dev->done2.virt_addr, HMB_SIZE / 4);
-        close(dev->fd);
-        return -1;
+    // Take the event count first, the caller checks its condition again before the sleep
+    if (!w->armed) {
+        if (read(dev->fd, &w->seen, sizeof(w->seen)) != sizeof(w->seen)) {
+            fprintf(stderr, "HMB completion notification unavailable, spinning\n");
+            dev->wait_mode = HMB_WAIT_SPIN;
+            return;
+        }
+        w->armed = true;
+        return;
     }
+    // The returned count was taken before the caller's next check, so the waiter stays armed with it
+    hw.seen = w->seen;
+    hw.timeout_ms = HMB_WAIT_TIMEOUT_MS;
+    if (read(dev->fd, &hw, sizeof(hw)) == sizeof(hw))
+        w->seen = hw.seen;
+    else
+        w->armed = false;
+    w->slept = true;
+}
 
-    return 0;
+void hmb_wait_end(struct hmb_device *dev, struct hmb_waiter *w)
+{
+    // Conditions that already held say nothing about how long a completion takes
+    if (dev->wait_mode != HMB_WAIT_ADAPTIVE || w->spins == 0)
+        return;
+    if (w->slept)
+        dev->spin_limit = dev->spin_limit / 2;
+    else
+        dev->spin_limit += ((int)(2 * w->spins) - (int)dev->spin_limit) / 8;
+    if (dev->spin_limit < HMB_SPIN_MIN)
+        dev->spin_limit = HMB_SPIN_MIN;
+    if (dev->spin_limit > HMB_SPIN_MAX)
+        dev->spin_limit = HMB_SPIN_MAX;
 }
 
 void hmb_cleanup(struct hmb_device *dev)
 {
     if (dev->buf0.virt_addr)
-        munmap((void*)dev->buf1.virt_addr, dev->buf0.size);
+        munmap((void*)dev->buf0.virt_addr, dev->buf0.size);
     if (dev->buf1.virt_addr)
         munmap((void*)dev->buf1.virt_addr, dev->buf1.size);
     if (dev->buf2.virt_addr)
         munmap((void*)dev->buf2.virt_addr, dev->buf2.size);
-    if (dev->done1.virt_addr)
-        munmap((void*)dev->done1.virt_addr, dev->done1.size);
-    if (dev->done2.virt_addr)
-        munmap((void*)dev->done2.virt_addr, dev->done2.size);
+    if (dev->done.virt_addr)
+        munmap((void*)dev->done.virt_addr, dev->done.size);
     if (dev->done_partition.virt_addr)
         munmap((void*)dev->done_partition.virt_addr, dev->done_partition.size);
+    if (dev->completion.virt_addr)
+        munmap((void*)dev->completion.virt_addr, dev->completion.size);
+    if (dev->control.virt_addr)
+        munmap((void*)dev->control.virt_addr, dev->control.size);
     if (dev->fd >= 0)
         close(dev->fd);
+    dev->buf0.virt_addr = dev->buf1.virt_addr = dev->buf2.virt_addr = NULL;
+    dev->done.virt_addr = dev->done1.iters = dev->done2.iters = NULL;
+    dev->done_partition.virt_addr = NULL;
+    dev->completion.virt_addr = dev->control.virt_addr = NULL;
+    dev->fd = -1;
 }
 
 int test_hmb()
@@ -149,22 +235,25 @@ int test_hmb()
         dev.buf2.virt_addr[i] = (i + 200) * 1.0;
     }
 
-    /* Test write to done1 boolean buffer */
-    printf("Writing to done1 boolean buffer...\n");
+    /* Test write to done1 */
+    printf("Writing to done1...\n");
     for (i = 0; i < 10; i++) {
-        dev.done1.virt_addr[i] = i;
+        if (i % 2)
+            hmb_set_done(&dev.done1, 0, 0, i, dev.layout.num_partitions);
     }
 
-    /* Test write to done2 boolean buffer */
-    printf("Writing to done2 boolean buffer...\n");
+    /* Test write to done2 */
+    printf("Writing to done2...\n");
     for (i = 0; i < 10; i++) {
-        dev.done2.virt_addr[i] = i;
+        if (i % 2)
+            hmb_set_done(&dev.done2, 0, 1, i, dev.layout.num_partitions);
     }
 
-    /* Test write to done_partition boolean buffer */
-    printf("Writing to done_partition boolean buffer...\n");
+    /* Test write to done_partition bitmap */
+    printf("Writing to done_partition bitmap...\n");
     for (i = 0; i < 10; i++) {
-        dev.done_partition.virt_addr[i] = i;
+        if (i % 2)
+            hmb_set_bit(&dev.done_partition, i);
     }
 
 
@@ -184,39 +273,40 @@ int test_hmb()
         printf("buf2[%d] = %f\n", i, dev.buf2.virt_addr[i]);
     }
 
-    printf("\nReading from done1 boolean buffer:\n");
+    printf("\nReading from done1:\n");
     for (i = 0; i < 10; i++) {
-        printf("done1[%d] = %d\n", i, dev.done1.virt_addr[i]);
+        printf("done1[%d] = %d\n", i, hmb_test_done(&dev.done1, 0, 0, i, dev.layout.num_partitions));
     }
 
-    printf("\nReading from done2 boolean buffer:\n");
+    printf("\nReading from done2:\n");
     for (i = 0; i < 10; i++) {
-        printf("done2[%d] = %d\n", i, dev.done2.virt_addr[i]);
+        printf("done2[%d] = %d\n", i, hmb_test_done(&dev.done2, 0, 1, i, dev.layout.num_partitions));
     }
 
-    printf("\nReading from done_partition boolean buffer:\n");
+    printf("\nReading from done_partition bitmap:\n");
     for (i = 0; i < 10; i++) {
-        printf("done_partition[%d] = %d\n", i, dev.done_partition.virt_addr[i]);
+        printf("done_partition[%d] = %d\n", i, hmb_test_bit(&dev.done_partition, i));
     }
 
     /* Test large offset access */
     printf("\nTesting larger offsets...\n");
-    size_t large_offset1 = (MB_256/sizeof(float)) - 1;
-    size_t large_offset2 = (MB_256/4/sizeof(float)) - 1;
+    size_t large_offset1 = (dev.buf0.size / sizeof(float)) - 1;
+    int last_csd = dev.layout.num_csds - 1, last_p = dev.layout.num_partitions - 1;
+    size_t large_offset3 = dev.done_partition.size * 8 - 1;
 
     dev.buf0.virt_addr[large_offset1] = 0.97;
     dev.buf1.virt_addr[large_offset1] = 0.99;
     dev.buf2.virt_addr[large_offset1] = 1.98;
-    dev.done1.virt_addr[large_offset2] = 1;
-    dev.done2.virt_addr[large_offset2] = 1;
-    dev.done_partition.virt_addr[large_offset2] = 1;
+    hmb_set_done(&dev.done1, last_csd, last_p, last_p, dev.layout.num_partitions);
+    hmb_set_done(&dev.done2, last_csd, last_p, last_p, dev.layout.num_partitions);
+    hmb_set_bit(&dev.done_partition, large_offset3);
     
     printf("Last element buf0: %f\n", dev.buf0.virt_addr[large_offset1]);
     printf("Last element buf1: %f\n", dev.buf1.virt_addr[large_offset1]);
     printf("Last element buf2: %f\n", dev.buf2.virt_addr[large_offset1]);
-    printf("Last element done: %d\n", dev.done1.virt_addr[large_offset2]);
-    printf("Last element done: %d\n", dev.done2.virt_addr[large_offset2]);
-    printf("Last element done: %d\n", dev.done_partition.virt_addr[large_offset2]);
+    printf("Last element done: %d\n", hmb_test_done(&dev.done1, last_csd, last_p, last_p, dev.layout.num_partitions));
+    printf("Last element done: %d\n", hmb_test_done(&dev.done2, last_csd, last_p, last_p, dev.layout.num_partitions));
+    printf("Last element done: %d\n", hmb_test_bit(&dev.done_partition, large_offset3));
 
     /* Clean up */
     hmb_cleanup(&dev);
@@ -9,9 +9,7 @@
 #include <unistd.h>
 #include <errno.h>
 
-#define MB_256 (256 * 1024 * 1024UL)
-#define GB_80 (80LL * 1024 * 1024 * 1024)
-#define HMB_SIZE GB_80
+#include "../hmb/include/hmb_layout.h"
 
 struct hmb_buffer {
     volatile float *virt_addr;  /* Virtual address of mapped memory */
@@ -19,25 +17,186 @@ struct hmb_buffer {
 };
 
 struct hmb_bitmap_buffer {
-    volatile bool *virt_addr;  /* Virtual address of mapped memory */
+    volatile unsigned long *virt_addr;  /* Virtual address of mapped memory, one bit per flag */
     size_t size;             /* Size of memory region */
 };
 
+struct hmb_counter_buffer {
+    volatile __u32 *virt_addr;  /* Virtual address of mapped memory */
+    size_t size;             /* Size of memory region */
+};
+
+/* done1 or done2: the done region seen for the iteration of v_t+1 or v_t+2 */
+struct hmb_done_buffer {
+    volatile __u32 *iters;      /* Iteration each (csd, r, c) was last completed for, see hmb_done_index() */
+    volatile __u32 *counters;   /* Column counters in the completion area */
+    volatile __u32 *epoch;      /* Epoch word of the control area */
+    int role;                /* HMB_ROLE_NEXT or HMB_ROLE_FUTURE */
+};
+
+/*
+ * Host waits on completion flags: HMB_WAIT_SPIN spins on the flags, HMB_WAIT_ADAPTIVE spins
+ * up to spin_limit checks then sleeps in read() until hmb.ko signals a completion.
+ * spin_limit follows the waits that ended while spinning and halves after a sleep.
+ */
+#define HMB_WAIT_SPIN 0
+#define HMB_WAIT_ADAPTIVE 1
+#define HMB_SPIN_MIN 64
+#define HMB_SPIN_MAX (1U << 20)
+#define HMB_WAIT_TIMEOUT_MS 10  /* Recheck the flags even if a wakeup is missed */
+
+struct hmb_waiter {
+    unsigned int spins;
+    bool armed;     /* Event count taken, the next miss sleeps */
+    __u32 seen;     /* Event count of this waiter, the fd is shared by every thread */
+    bool slept;
+};
+
 struct hmb_device {
-    struct hmb_buffer buf0; // v_t
-    struct hmb_buffer buf1; // v_t+1
-    struct hmb_buffer buf2; // v_t+2
-    struct hmb_bitmap_buffer done1, done2;      // v_t+1, v_t+2 aggregation from CSDs
+    struct hmb_buffer buf0; // Value buffers, see hmb_value_buf() for v_t, v_t+1 and v_t+2
+    struct hmb_buffer buf1;
+    struct hmb_buffer buf2;
+    struct hmb_counter_buffer done;             // Aggregation from CSDs, seen through done1 and done2
+    struct hmb_done_buffer done1, done2;        // v_t+1, v_t+2 aggregation from CSDs
     struct hmb_bitmap_buffer done_partition;    // v_t+1 conv notification to CSDs
+    struct hmb_counter_buffer completion;       // Completed edge blocks per CSD and column
+    struct hmb_counter_buffer control;          // Epoch of the value buffer ring and flush counters
+    struct hmb_layout layout;   /* Published by hmb.ko at offset 0 */
+    int wait_mode;           /* HMB_WAIT_SPIN or HMB_WAIT_ADAPTIVE */
+    unsigned int spin_limit;    /* Checks before sleeping, adapted by hmb_wait_end() */
     int fd;                  /* Device file descriptor */
 };
 
 /* Initialize HMB device and map both buffers */
 int hmb_init(struct hmb_device *dev);
 
+/* Check that the layout was sized for at least this graph */
+int hmb_check_layout(struct hmb_device *dev, long long num_vertices, int num_csds, int num_partitions);
+
+/* Clear every completion flag and counter, together with hmb_reset_epoch() */
+void hmb_reset_done(struct hmb_device *dev);
+
+/* Restart the value buffer ring at buf0 = v_t */
+void hmb_reset_epoch(struct hmb_device *dev);
+
+/*
+ * End of iteration: v_t+1 becomes v_t and v_t+2 becomes v_t+1, returns the new v_t+2 to clear.
+ * done2 becomes done1 with it, the completions are never cleared.
+ */
+volatile float *hmb_rotate_values(struct hmb_device *dev);
+
+/* One more miss of a wait condition: spin, take the event count, or sleep */
+void hmb_wait_next(struct hmb_device *dev, struct hmb_waiter *w);
+
+/* The wait condition holds, adapt the spin limit */
+void hmb_wait_end(struct hmb_device *dev, struct hmb_waiter *w);
+
+/* Wait until cond holds */
+#define hmb_wait_until(dev, cond) do {          \
+        struct hmb_waiter __w = {0};            \
+        while (!(cond))                         \
+            hmb_wait_next((dev), &__w);         \
+        hmb_wait_end((dev), &__w);              \
+    } while (0)
+
 /* Clean up HMB device */
 void hmb_cleanup(struct hmb_device *dev);
 
 int test_hmb();
 
+/* Flags are shared with the CSDs bit by bit, so every update is atomic */
+static inline bool hmb_test_bit(struct hmb_bitmap_buffer *buf, __u64 bit)
+{
+    return (__atomic_load_n(&buf->virt_addr[bit / HMB_BITS_PER_WORD], __ATOMIC_ACQUIRE) >> (bit % HMB_BITS_PER_WORD)) & 1;
+}
+
+static inline bool hmb_set_bit(struct hmb_bitmap_buffer *buf, __u64 bit)
+{
+    unsigned long mask = 1UL << (bit % HMB_BITS_PER_WORD);
+    return __atomic_fetch_or(&buf->virt_addr[bit / HMB_BITS_PER_WORD], mask, __ATOMIC_ACQ_REL) & mask;
+}
+
+static inline bool hmb_clear_bit(struct hmb_bitmap_buffer *buf, __u64 bit)
+{
+    unsigned long mask = 1UL << (bit % HMB_BITS_PER_WORD);
+    return __atomic_fetch_and(&buf->virt_addr[bit / HMB_BITS_PER_WORD], ~mask, __ATOMIC_ACQ_REL) & mask;
+}
+
+/* Iteration that done1 or done2 stands for in the current epoch */
+static inline __u32 hmb_done_target(struct hmb_done_buffer *done)
+{
+    return __atomic_load_n(done->epoch, __ATOMIC_ACQUIRE) + done->role;
+}
+
+/* Completion of edge block (r, c) on a CSD, in done1 or done2 */
+static inline bool hmb_test_done(struct hmb_done_buffer *done, int csd_id, int r, int c, int num_partitions)
+{
+    return __atomic_load_n(&done->iters[hmb_done_index(csd_id, r, c, num_partitions)], __ATOMIC_ACQUIRE) >= hmb_done_target(done);
+}
+
+/* Column counters only count the first completion of a block for an iteration */
+static inline void hmb_set_done(struct hmb_done_buffer *done, int csd_id, int r, int c, int num_partitions)
+{
+    volatile __u32 *iter = &done->iters[hmb_done_index(csd_id, r, c, num_partitions)];
+    __u32 target = hmb_done_target(done);
+    __u32 old = __atomic_load_n(iter, __ATOMIC_ACQUIRE);
+
+    while (old < target) {
+        if (__atomic_compare_exchange_n(iter, &old, target, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&done->counters[hmb_completion_index(csd_id, target, c, num_partitions)], 1, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+/* Take back a completion of this iteration, so the block can be waited on again */
+static inline void hmb_clear_done(struct hmb_done_buffer *done, int csd_id, int r, int c, int num_partitions)
+{
+    volatile __u32 *iter = &done->iters[hmb_done_index(csd_id, r, c, num_partitions)];
+    __u32 target = hmb_done_target(done);
+    __u32 old = target;
+
+    if (__atomic_compare_exchange_n(iter, &old, target - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        __atomic_fetch_sub(&done->counters[hmb_completion_index(csd_id, target, c, num_partitions)], 1, __ATOMIC_RELEASE);
+}
+
+/* Every row of column c is done on a CSD, a single load */
+static inline bool hmb_column_complete(struct hmb_done_buffer *done, int csd_id, int c, int num_partitions)
+{
+    __u32 target = hmb_done_target(done);
+    return __atomic_load_n(&done->counters[hmb_completion_index(csd_id, target, c, num_partitions)], __ATOMIC_ACQUIRE)
+        >= hmb_column_expected(target, num_partitions);
+}
+
+/* Flushes completed by a CSD */
+static inline __u32 hmb_flushed(struct hmb_device *dev, int csd_id)
+{
+    return __atomic_load_n(&dev->control.virt_addr[HMB_CONTROL_FLUSH + csd_id], __ATOMIC_ACQUIRE);
+}
+
+/* Column c of v_t+1 was reduced and applied by its owner CSD (reduce-scatter) */
+static inline bool hmb_column_reduced(struct hmb_device *dev, int c)
+{
+    __u32 target = __atomic_load_n(&dev->control.virt_addr[HMB_CONTROL_EPOCH], __ATOMIC_ACQUIRE) + HMB_ROLE_NEXT;
+    return __atomic_load_n(&dev->control.virt_addr[hmb_control_reduced(dev->layout.num_csds, c)], __ATOMIC_ACQUIRE) >= target;
+}
+
+/* Stat i written by a CSD on flush, see hmb_stat_index() */
+static inline float hmb_stat(struct hmb_device *dev, int csd_id, int i)
+{
+    return dev->buf2.virt_addr[hmb_stat_index(dev->layout.num_csds, dev->layout.num_vertices, csd_id, i)];
+}
+
+/* Value buffer playing v_t + role in the current epoch */
+static inline volatile float *hmb_value_buf(struct hmb_device *dev, int role)
+{
+    __u32 epoch = __atomic_load_n(&dev->control.virt_addr[HMB_CONTROL_EPOCH], __ATOMIC_ACQUIRE);
+
+    switch (hmb_value_buf_index(epoch, role)) {
+    case 0: return dev->buf0.virt_addr;
+    case 1: return dev->buf1.virt_addr;
+    }
+    return dev->buf2.virt_addr;
+}
+
 #endif /* HMB_MMAP_H */
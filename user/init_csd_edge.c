@@ -12,11 +12,18 @@
 #include <time.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <pthread.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #include "../core/proc_edge_struct.h"
 #include "../core/params.h"
+#include "../core/traversal.h"
 #include "hmb_mmap.h"
+#include "csd_loader.h"
+#include "graph_ref.h"
 
 #define PAGE_SIZE  sysconf(_SC_PAGESIZE)
 
@@ -33,6 +40,7 @@ const char device[MAX_NUM_CSDS][20] = {
     "/dev/nvme21n1", "/dev/nvme22n1", "/dev/nvme23n1", "/dev/nvme24n1"
 };
 int fd[MAX_NUM_CSDS] = {0};
+int csd_nsid[MAX_NUM_CSDS];    // Namespace id of each CSD, for the passthru commands of the inline tasks
 
 // Graph Dataset: Ex, LiveJournal
 char dataset_path[30];
@@ -47,6 +55,20 @@ struct hmb_device hmb_dev = {0};
 long long outdegree_slba;
 long long*** edge_blocks_slba;     // edge_blocks_slba[num_partitions][num_partitions][num_csds]
 long long*** edge_blocks_length;   // edge_blocks_length[num_partitions][num_partitions][num_csds]
+long long plan_slba[MAX_NUM_CSDS];  // Run plan block table, written after the edge blocks of each CSD
+
+// Load balancing: edge blocks split into chunks, tail chunks replicated on the next CSD
+#define MAX_CHUNK_HOLDERS 2
+struct edge_chunk {
+    long long len;
+    int num_holders;
+    int csd_id[MAX_CHUNK_HOLDERS];      // csd_id[0] is the home CSD
+    long long slba[MAX_CHUNK_HOLDERS];
+};
+int chunks_per_csd = 4;
+int chunk_replicas = 1;             // Replicated chunks at the tail of each edge block
+struct edge_chunk* edge_chunks[MAX_PARTITION][MAX_PARTITION];
+int num_edge_chunks[MAX_PARTITION][MAX_PARTITION];
 
 // Aggregation latency
 long long aggregation_time = AGG_LATENCY;
@@ -62,6 +84,36 @@ bool cost_modeling = false;
 
 int algorithm = 0; // 0: Pagerank, 1: Label Propagation, 2: Dispersion
 
+// Partial sums per CSD, SUM_LAYOUT_INTERLEAVED streams the host aggregation of a partition
+int sum_layout = SUM_LAYOUT_CSD_MAJOR;
+int reduce_scatter = 0;    // 1: the owner CSD of each column reduces it (dual queue and run plan only)
+int block_placement = BLOCK_PLACEMENT_SPLIT;    // BLOCK_PLACEMENT_OWNED: every edge block on one CSD
+int traversal_order = TRAVERSAL_COLUMN;     // Block order of the dual queue loops, TRAVERSAL_*
+struct traversal trav;
+
+// Host aggregation pool: columns are reduced off the submitting thread, 0 threads aggregates inline
+#define MAX_AGGR_THREADS 64
+#define AGGR_JOB_CONV 0     // conv_partition(c)
+#define AGGR_JOB_FUTURE 1   // Future values of column c in buf2
+struct aggr_job {
+    int type;
+    int c;
+};
+struct aggr_pool {
+    pthread_t threads[MAX_AGGR_THREADS];
+    int num_threads;
+    struct aggr_job jobs[2 * MAX_PARTITION];
+    int head, tail, pending;
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t job_cond, idle_cond;
+};
+struct aggr_pool aggr_pool;
+int aggr_threads = 0;
+long long aggr_column_time[MAX_PARTITION];  // Per-column aggregation time (ns) over the run
+int reload_dataset = 0;    // 1: write the dataset even if the CSDs hold a matching image
+int spin_wait = 0;  // 1: spin on the HMB flags, 0: spin then sleep until hmb.ko signals a completion
+
 // Opens the NVMe device and returns file descriptor
 int open_nvme_device(const char *device_path) {
 
@@ -111,23 +163,34 @@ int nvme_io_submit(int fd, struct nvme_user_io *io) {
         perror("NVMe I/O ioctl failed");
         return -1;
     }
+    // NVMe status of the completion, ex: a run plan rejected by the CSD
+    if (ret > 0) {
+        fprintf(stderr, "NVMe command 0x%x failed, status 0x%x\n", io->opcode, ret);
+        return -1;
+    }
     return 0;
 }
 
-// Cleanup resources
-void cleanup(void *buffer) 
-{
-    if(buffer) free(buffer);
-    for(int i = 0; i < num_csds; i++){
-        if (fd[i] >= 0) {
-            close(fd[i]);
-        }
+int nvme_passthru_submit(int fd, struct nvme_passthru_cmd *cmd) {
+    int ret = ioctl(fd, NVME_IOCTL_IO_CMD, cmd);
+    if (ret < 0) {
+        perror("NVMe passthru ioctl failed");
+        return -1;
+    }
+    if (ret > 0) {
+        fprintf(stderr, "NVMe command 0x%x failed, status 0x%x\n", cmd->opcode, ret);
+        return -1;
     }
+    return 0;
+}
 
-    // Free the edge blocks metadata
+// Free the edge blocks metadata, allocated for edge_blocks_partitions partitions
+int edge_blocks_partitions = 0;
+void free_edge_blocks_info()
+{
     if(edge_blocks_slba){
-        for (int i = 0; i < num_partitions; i++) {
-            for (int j = 0; j < num_partitions; j++) {
+        for (int i = 0; i < edge_blocks_partitions; i++) {
+            for (int j = 0; j < edge_blocks_partitions; j++) {
                 free(edge_blocks_slba[i][j]);
             }
             free(edge_blocks_slba[i]);
@@ -135,14 +198,35 @@ void cleanup(void *buffer)
         free(edge_blocks_slba);
     }
     if(edge_blocks_length){
-        for (int i = 0; i < num_partitions; i++) {
-            for (int j = 0; j < num_partitions; j++) {
+        for (int i = 0; i < edge_blocks_partitions; i++) {
+            for (int j = 0; j < edge_blocks_partitions; j++) {
                 free(edge_blocks_length[i][j]);
             }
             free(edge_blocks_length[i]);
         }
         free(edge_blocks_length);
     }
+    edge_blocks_slba = edge_blocks_length = NULL;
+    edge_blocks_partitions = 0;
+}
+
+// Cleanup resources
+void cleanup(void *buffer) 
+{
+    if(buffer) free(buffer);
+    for(int i = 0; i < num_csds; i++){
+        if (fd[i] >= 0) {
+            close(fd[i]);
+        }
+    }
+
+    free_edge_blocks_info();
+    for (int i = 0; i < num_partitions; i++) {
+        for (int j = 0; j < num_partitions; j++) {
+            free(edge_chunks[i][j]);
+            edge_chunks[i][j] = NULL;
+        }
+    }
 
     hmb_cleanup(&hmb_dev);
     printf("HMB cleaned up\n");
@@ -167,7 +251,9 @@ int max(int x, int y){
 
 void malloc_edge_blocks_info()
 {
-    // Initialize 3d array for edge blocks metadata
+    // Initialize 3d array for edge blocks metadata, the tables of a previous load are dropped
+    free_edge_blocks_info();
+    edge_blocks_partitions = num_partitions;
     edge_blocks_slba = malloc(num_partitions * sizeof(long long**));
     for (int i = 0; i < num_partitions; i++) {
         edge_blocks_slba[i] = malloc(num_partitions * sizeof(long long*));
@@ -188,11 +274,10 @@ int __ceil(int x, int y){
     return (x + y - 1) / y;
 }
 
-int init_csds_data(int* fd, void *buffer)
+// Reset vertex values and completion flags in the HMB
+void init_hmb_values()
 {
-    int ret;
-    char filename[50];
-    struct nvme_user_io io;
+    volatile float *curr;
 
     // Initialize all v_t values
     for(long long i = 0; i < num_vertices * (num_csds + 1); i++){
@@ -200,11 +285,13 @@ int init_csds_data(int* fd, void *buffer)
         hmb_dev.buf1.virt_addr[i] = 0.0f;
         hmb_dev.buf2.virt_addr[i] = 0.0f;
     }
+    hmb_reset_epoch(&hmb_dev);
+    curr = hmb_value_buf(&hmb_dev, HMB_ROLE_CURR);
 
     if(algorithm == 0){
         // Pagerank
         for(long long i = 0; i < num_vertices; i++){
-            hmb_dev.buf0.virt_addr[i] = 1.0;
+            curr[i] = 1.0;
         }
     }
     else if(algorithm == 1){
@@ -215,30 +302,24 @@ int init_csds_data(int* fd, void *buffer)
         // dispersion
         for(long long i = 0; i < num_vertices; i++){
             if(i % 100000 == 0){
-                hmb_dev.buf0.virt_addr[i] = 1.0;
-            }
-        }
-    }
-    
-    for(int c = 0; c < num_partitions; c++){
-        for(int r = 0; r < num_partitions; r++){
-            for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                hmb_dev.done1.virt_addr[id] = false;
-                hmb_dev.done2.virt_addr[id] = false;
+                curr[i] = 1.0;
             }
         }
     }
-    for(int c = 0; c < num_partitions; c++)
-        hmb_dev.done_partition.virt_addr[c] = false;
     
-    // printf("HMB Reset done");
-    // fflush(stdout);
+    hmb_reset_done(&hmb_dev);
+}
+
+// Write the outdegrees to every CSD, edge blocks start right after them
+int init_csds_outdegrees(int* fd, void *buffer, long long* edge_block_base_slba)
+{
+    int ret;
+    char filename[50];
+    struct nvme_user_io io;
 
     // Read outdegree and write 4KB buffers into nvme virtual devices (csd_id)
-    outdegree_slba = 0;
+    outdegree_slba = CSD_MANIFEST_SIZE;
     sprintf(filename, "%s/outdegrees", dataset_path);
-    long long edge_block_base_slba[num_csds];
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
         FILE *file = fopen(filename, "rb");
         long long offset = 0;
@@ -258,61 +339,379 @@ int init_csds_data(int* fd, void *buffer)
         edge_block_base_slba[csd_id] = outdegree_slba + offset;
     }
 
-    // Read edge blocks and write 4KB buffer outdegree into nvme virtual device
+    return 0;
+}
+
+// Write the manifest of a CSD, or clear it when m is NULL
+int write_csd_manifest(int csd_id, void *buffer, struct csd_manifest *m)
+{
+    struct nvme_user_io io;
+
+    memset(buffer, 0, buffer_size);
+    if(m)
+        memcpy(buffer, m, sizeof(*m));
+    setup_nvme_command(&io, buffer, 0x01, 0);
+    return nvme_io_submit(fd[csd_id], &io);
+}
+
+// The CSDs hold this dataset already: take the block tables back from their run plan tables
+int restore_csds_data(void *buffer, unsigned long long fingerprint)
+{
+    struct nvme_user_io io;
+    struct csd_manifest m;
+    long long num_edges = 0;
+    int num_blocks = num_partitions * num_partitions;
+    int entries_per_buffer = buffer_size / sizeof(struct run_plan_entry);
+
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        setup_nvme_command(&io, buffer, 0x02, 0);
+        if(nvme_io_submit(fd[csd_id], &io) < 0)
+            return -1;
+        memcpy(&m, buffer, sizeof(m));
+        if(m.magic != CSD_MANIFEST_MAGIC || m.version != CSD_MANIFEST_VERSION || m.fingerprint != fingerprint
+            || m.num_vertices != (unsigned long long)num_vertices || m.num_partitions != (unsigned int)num_partitions
+            || m.num_csds != (unsigned int)num_csds || m.csd_id != (unsigned int)csd_id
+            || m.block_placement != (unsigned int)block_placement)
+            return -1;
+        if(csd_id == 0){
+            malloc_edge_blocks_info();
+            outdegree_slba = m.outdegree_slba;
+        }
+        plan_slba[csd_id] = m.plan_slba;
+        num_edges += m.num_edges;
+
+        for(int b = 0; b < num_blocks; b += entries_per_buffer){
+            struct run_plan_entry *entries = buffer;
+            setup_nvme_command(&io, buffer, 0x02, (m.plan_slba + 1LL * b * sizeof(struct run_plan_entry)) / SECTOR_SIZE);
+            if(nvme_io_submit(fd[csd_id], &io) < 0)
+                return -1;
+            for(int k = 0; k < entries_per_buffer && b + k < num_blocks; k++){
+                int r = (b + k) / num_partitions, c = (b + k) % num_partitions;
+                edge_blocks_slba[r][c][csd_id] = entries[k].slba;
+                edge_blocks_length[r][c][csd_id] = entries[k].len;
+            }
+        }
+    }
+    memset(buffer, 0, buffer_size);
+    printf("CSDs hold %lld edges of %s already, dataset load skipped\n", num_edges, dataset_path);
+    return 0;
+}
+
+/*
+ * Owner CSD of every edge block (BLOCK_PLACEMENT_OWNED), largest block first onto the CSD with the
+ * lowest cost after taking it. The cost of a CSD is the bytes it reads per iteration: its edges, plus
+ * every source partition it has to read into its vertex buffer, so a CSD that already reads
+ * partition r takes the other blocks of row r at the cost of their edges only.
+ */
+void assign_block_owners(long long block_edges[num_partitions][num_partitions], int owner[num_partitions][num_partitions])
+{
+    int num_blocks = num_partitions * num_partitions;
+    int order[num_blocks];
+    long long cost[num_csds];
+    long long max_cost = 0, total_cost = 0;
+    bool reads_row[num_csds][num_partitions];
+    int num_rows[num_csds];
+
+    for(int b = 0; b < num_blocks; b++)
+        order[b] = b;
+    // Insertion sort by decreasing edge count, stable so equal blocks stay row-major
+    for(int i = 1; i < num_blocks; i++){
+        int b = order[i], j = i;
+        while(j > 0 && block_edges[order[j - 1] / num_partitions][order[j - 1] % num_partitions] < block_edges[b / num_partitions][b % num_partitions]){
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = b;
+    }
+    memset(reads_row, 0, sizeof(reads_row));
+    for(int csd_id = 0; csd_id < num_csds; csd_id++)
+        cost[csd_id] = num_rows[csd_id] = 0;
+
+    for(int i = 0; i < num_blocks; i++){
+        int r = order[i] / num_partitions, c = order[i] % num_partitions, best = 0;
+        long long best_cost = -1;
+        __u64 begin, end;
+
+        partition_range(num_vertices, num_partitions, r, &begin, &end);
+        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+            long long after = cost[csd_id] + block_edges[r][c] * EDGE_SIZE;
+            if(!reads_row[csd_id][r])
+                after += (long long)(end - begin) * VERTEX_SIZE;
+            if(best_cost < 0 || after < best_cost){
+                best = csd_id;
+                best_cost = after;
+            }
+        }
+        owner[r][c] = best;
+        // Empty blocks are skipped by every CSD
+        if(block_edges[r][c] == 0)
+            continue;
+        cost[best] = best_cost;
+        if(!reads_row[best][r]){
+            reads_row[best][r] = true;
+            num_rows[best]++;
+        }
+    }
+
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        total_cost += cost[csd_id];
+        if(cost[csd_id] > max_cost)
+            max_cost = cost[csd_id];
+        printf("CSD %d owns blocks of %d source partitions, %lld MB per iteration\n", csd_id, num_rows[csd_id], cost[csd_id] >> 20);
+    }
+    if(total_cost > 0)
+        printf("Block placement imbalance (max / mean): %.3f\n", (double)max_cost * num_csds / total_cost);
+}
+
+int init_csds_data(int* fd, void *buffer)
+{
+    int ret;
+    char filename[PATH_MAX];
+    struct nvme_user_io io;
+    struct csd_load_job jobs[num_csds];
+    unsigned long long fingerprint = csd_dataset_fingerprint(dataset_path, num_partitions);
+    long long csd_num_edges_saved[num_csds];
+
+    init_hmb_values();
+
+    // printf("HMB Reset done");
+    // fflush(stdout);
+
+    // Only the vertex state is reset when the CSDs hold a matching image
+    if(!reload_dataset && restore_csds_data(buffer, fingerprint) == 0)
+        return 0;
+
+    // The manifests go first, a load cut short leaves no valid image behind
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        if(write_csd_manifest(csd_id, buffer, NULL) < 0){
+            cleanup(buffer);
+            return -1;
+        }
+        csd_num_edges_saved[csd_id] = 0;
+    }
+
+    // Outdegrees first on every CSD, edge blocks start right after them
+    outdegree_slba = CSD_MANIFEST_SIZE;
+    sprintf(filename, "%s/outdegrees", dataset_path);
+    long long outdegree_size = getFileSize(filename);
+    long long edge_block_base_slba[num_csds];
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        if(csd_load_job_init(&jobs[csd_id], fd[csd_id], device[csd_id]) < 0
+            || csd_load_job_add(&jobs[csd_id], filename, 0, outdegree_size, outdegree_slba) < 0){
+            cleanup(buffer);
+            return -1;
+        }
+        edge_block_base_slba[csd_id] = outdegree_slba + csd_load_padded(outdegree_size);
+    }
+
+    // Owned placement: pick the owner of every block from the block sizes
+    int block_owner[num_partitions][num_partitions];
+    if(block_placement == BLOCK_PLACEMENT_OWNED){
+        long long block_edges[num_partitions][num_partitions];
+        for(int i = 0; i < num_partitions; i++){
+            for(int j = 0; j < num_partitions; j++){
+                snprintf(filename, sizeof(filename), "%s/block-%d-%d", dataset_path, i, j);
+                block_edges[i][j] = getFileSize(filename) / EDGE_SIZE;
+            }
+        }
+        assign_block_owners(block_edges, block_owner);
+    }
+
+    // Divide each edge block "block-i-j" into num_csds portions, each one 4KB aligned on its CSD
+    // With owned placement the owner takes the whole block and the other portions are empty
     malloc_edge_blocks_info();
     long long total_edges_saved = 0;
     for(int i = 0; i < num_partitions; i++){
         for(int j = 0; j < num_partitions; j++)
         {
-            sprintf(filename, "%s/block-%d-%d", dataset_path, i, j);
+            snprintf(filename, sizeof(filename), "%s/block-%d-%d", dataset_path, i, j);
             long long edge_block_size = getFileSize(filename);
             long long num_edge = edge_block_size / EDGE_SIZE;
             total_edges_saved += num_edge;
             // printf("Edge block %d-%d Size: %d, Number of edges: %d\n", i, j, edge_block_size, num_edge);
 
-            // Divide an edge block into num_csds portions
             long long csd_num_edges = num_edge / num_csds;
             int csd_num_edges_remainder = num_edge % num_csds;
+            long long file_offset = 0;
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                edge_blocks_length[i][j][csd_id] = 1LL * EDGE_SIZE * (csd_num_edges + (csd_id < csd_num_edges_remainder));
+                if(block_placement == BLOCK_PLACEMENT_OWNED)
+                    edge_blocks_length[i][j][csd_id] = csd_id == block_owner[i][j] ? edge_block_size / EDGE_SIZE * EDGE_SIZE : 0;
+                else
+                    edge_blocks_length[i][j][csd_id] = 1LL * EDGE_SIZE * (csd_num_edges + (csd_id < csd_num_edges_remainder));
+                edge_blocks_slba[i][j][csd_id] = edge_block_base_slba[csd_id];
+                csd_num_edges_saved[csd_id] += edge_blocks_length[i][j][csd_id] / EDGE_SIZE;
+                if(edge_blocks_length[i][j][csd_id] > 0
+                    && csd_load_job_add(&jobs[csd_id], filename, file_offset, edge_blocks_length[i][j][csd_id], edge_block_base_slba[csd_id]) < 0){
+                    cleanup(buffer);
+                    return -1;
+                }
+                file_offset += edge_blocks_length[i][j][csd_id];
+                edge_block_base_slba[csd_id] += csd_load_padded(edge_blocks_length[i][j][csd_id]);
+
+                // printf("Edge block %d-%d for CSD %d: slba: %d, size: %d\n", i, j, csd_id, edge_blocks_slba[i][j][csd_id], edge_blocks_length[i][j][csd_id]);
+            }
+        }
+    }
+
+    // One writer per CSD, MDTS-sized writes
+    ret = csd_load(jobs, num_csds);
+    for(int csd_id = 0; csd_id < num_csds; csd_id++)
+        csd_load_job_free(&jobs[csd_id]);
+    if(ret < 0){
+        cleanup(buffer);
+        return -1;
+    }
+    printf("Wrote %lld edges to CSDs\n", total_edges_saved);
+
+    // Write the run plan block table (row-major [r][c]) after the edge blocks
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        struct run_plan_entry *entries = buffer;
+        int entries_per_buffer = buffer_size / sizeof(struct run_plan_entry);
+        int num_blocks = num_partitions * num_partitions;
+        long long offset = 0;
+
+        plan_slba[csd_id] = edge_block_base_slba[csd_id];
+        for(int b = 0; b < num_blocks; b += entries_per_buffer){
+            memset(buffer, 0, buffer_size);
+            for(int k = 0; k < entries_per_buffer && b + k < num_blocks; k++){
+                int r = (b + k) / num_partitions, c = (b + k) % num_partitions;
+                entries[k].slba = edge_blocks_slba[r][c][csd_id];
+                entries[k].len = edge_blocks_length[r][c][csd_id];
             }
-            
-            // Read edges from binary file "block-i-j", and write each portion to corresponding csds
+            setup_nvme_command(&io, buffer, 0x01, (plan_slba[csd_id] + offset) / SECTOR_SIZE);  // Setup write command
+            ret = nvme_io_submit(fd[csd_id], &io);
+            if (ret < 0) {
+                cleanup(buffer);
+                return -1;
+            }
+            offset += buffer_size;
+        }
+        memset(buffer, 0, buffer_size);
+    }
+
+    // The image is complete: publish the manifests
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        struct csd_manifest m = {
+            .magic = CSD_MANIFEST_MAGIC,
+            .version = CSD_MANIFEST_VERSION,
+            .fingerprint = fingerprint,
+            .num_vertices = num_vertices,
+            .num_partitions = num_partitions,
+            .num_csds = num_csds,
+            .csd_id = csd_id,
+            .block_placement = block_placement,
+            .outdegree_slba = outdegree_slba,
+            .plan_slba = plan_slba[csd_id],
+            .num_edges = csd_num_edges_saved[csd_id],
+        };
+        if(write_csd_manifest(csd_id, buffer, &m) < 0){
+            cleanup(buffer);
+            return -1;
+        }
+    }
+    memset(buffer, 0, buffer_size);
+
+    return 0;
+}
+
+// Write chunks of at most 4KB-padded edges from file offset to the CSD at slba
+long long write_edge_chunk(int csd_id, void *buffer, FILE *file, long long file_offset, long long len, long long slba)
+{
+    int ret;
+    struct nvme_user_io io;
+    long long offset = 0;
+    long long remaining = len;
+
+    if (fseeko(file, file_offset, SEEK_SET) < 0) {
+        perror("Failed to seek in the edge block");
+        return -1;
+    }
+    while (remaining > 0) {
+        long long bytes = remaining < (long long)buffer_size ? remaining : (long long)buffer_size;
+        memset(buffer, 0, buffer_size);
+        if ((long long)fread(buffer, 1, bytes, file) != bytes) {
+            fprintf(stderr, "Short read of the edge block at %lld\n", file_offset + offset);
+            return -1;
+        }
+        setup_nvme_command(&io, buffer, 0x01, (slba + offset) / SECTOR_SIZE);  // Setup write command
+        ret = nvme_io_submit(fd[csd_id], &io);
+        if (ret < 0)
+            return -1;
+        offset += buffer_size;
+        remaining -= buffer_size;
+    }
+    memset(buffer, 0, buffer_size);
+    return offset;
+}
+
+// Split each edge block into num_csds * chunks_per_csd chunks for dynamic load balancing
+int init_csds_data_chunked(int* fd, void *buffer)
+{
+    char filename[PATH_MAX];
+    long long edge_block_base_slba[num_csds];
+    long long total_edges_saved = 0, total_replicated = 0;
+
+    init_hmb_values();
+
+    // Chunked images are not kept across runs
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        if(write_csd_manifest(csd_id, buffer, NULL) < 0){
+            cleanup(buffer);
+            return -1;
+        }
+    }
+    if(init_csds_outdegrees(fd, buffer, edge_block_base_slba) < 0)
+        return -1;
+
+    for(int i = 0; i < num_partitions; i++){
+        for(int j = 0; j < num_partitions; j++)
+        {
+            snprintf(filename, sizeof(filename), "%s/block-%d-%d", dataset_path, i, j);
+            long long num_edge = getFileSize(filename) / EDGE_SIZE;
+            long long num_chunks = num_edge < 1LL * num_csds * chunks_per_csd ? num_edge : 1LL * num_csds * chunks_per_csd;
+            total_edges_saved += num_edge;
+
+            free(edge_chunks[i][j]);
+            edge_chunks[i][j] = calloc(num_chunks > 0 ? num_chunks : 1, sizeof(struct edge_chunk));
+            num_edge_chunks[i][j] = num_chunks;
+            if(num_chunks == 0)
+                continue;
+
             FILE *file = fopen(filename, "rb");
-            for(int csd_id = 0; csd_id < num_csds; csd_id++)
+            long long file_offset = 0;
+            if(!file){
+                perror(filename);
+                cleanup(buffer);
+                return -1;
+            }
+            for(int k = 0; k < num_chunks; k++)
             {
-                long long offset = 0;
-                long long remaining = edge_blocks_length[i][j][csd_id];
-                while (remaining > 0) {
-                    int bytes = min(buffer_size, remaining);
-                    fread(buffer, 1, bytes, file);
-
-                    // Print the edges for edge saving correctness
-                    // for(int* e = buffer; e < buffer + bytes; e += EDGE_SIZE / VERTEX_SIZE){
-                    //     int u = *e, v = *(e + 1);
-                    //     if(v == 4847562)
-                    //         printf("Dst[%d], Src[%d]\n", v, u);
-                    // }
-
-                    setup_nvme_command(&io, buffer, 0x01, (edge_block_base_slba[csd_id] + offset) / SECTOR_SIZE);  // Setup write command
-                    ret = nvme_io_submit(fd[csd_id], &io);
-                    if (ret < 0) {
+                struct edge_chunk *chunk = &edge_chunks[i][j][k];
+                chunk->len = 1LL * EDGE_SIZE * (num_edge / num_chunks + (k < num_edge % num_chunks));
+                chunk->num_holders = 1;
+                chunk->csd_id[0] = k % num_csds;
+                if(num_csds > 1 && k >= num_chunks - chunk_replicas){
+                    chunk->csd_id[chunk->num_holders++] = (k + 1) % num_csds;
+                    total_replicated++;
+                }
+
+                for(int h = 0; h < chunk->num_holders; h++){
+                    int csd_id = chunk->csd_id[h];
+                    long long written = write_edge_chunk(csd_id, buffer, file, file_offset, chunk->len, edge_block_base_slba[csd_id]);
+                    if(written < 0){
+                        fclose(file);
                         cleanup(buffer);
                         return -1;
                     }
-                    offset += buffer_size;
-                    remaining -= buffer_size;
-                    memset(buffer, 0, buffer_size);
+                    chunk->slba[h] = edge_block_base_slba[csd_id];
+                    edge_block_base_slba[csd_id] += written;
                 }
-                edge_blocks_slba[i][j][csd_id] = edge_block_base_slba[csd_id];
-                edge_block_base_slba[csd_id] += offset;
-
-                // printf("Wrote Edge block %d-%d for CSD %d: slba: %d, size: %d, aligned size: %d\n", i, j, csd_id, edge_blocks_slba[i][j][csd_id], edge_blocks_length[i][j][csd_id], offset);
+                file_offset += chunk->len;
             }
             fclose(file);
         }
     }
-    printf("Wrote %lld edges to CSDs\n", total_edges_saved);
+    printf("Wrote %lld edges to CSDs in chunks, %lld replicated chunks\n", total_edges_saved, total_replicated);
 
     return 0;
 }
@@ -325,6 +724,20 @@ int setup_nvme_csd_proc_edge_command(struct nvme_user_io *io, struct PROC_EDGE *
     return 0;
 }
 
+// Per-task fields inline in the command dwords, no buffer for the CSD to read, see proc_edge_encode()
+int setup_nvme_csd_inline_command(struct nvme_passthru_cmd *cmd, int csd_id, struct PROC_EDGE *proc_edge_struct, int csd_flag) {
+    __u32 dw[PROC_EDGE_INLINE_DWORDS];
+
+    proc_edge_encode(proc_edge_struct, csd_flag, dw);
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->opcode = 0x66;
+    cmd->nsid = csd_nsid[csd_id];
+    cmd->cdw2 = dw[0], cmd->cdw3 = dw[1];
+    cmd->cdw10 = dw[2], cmd->cdw11 = dw[3], cmd->cdw12 = dw[4];
+    cmd->cdw13 = dw[5], cmd->cdw14 = dw[6], cmd->cdw15 = dw[7];
+    return 0;
+}
+
 long long get_time_ns() {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -332,98 +745,275 @@ long long get_time_ns() {
 }
 
 // Graph processing utility functions
-int send_proc_edge(int r, int c, int csd_id, int iter, int num_iters, int is_sync, int is_fvc, int is_prefetching, int row_overlap)
+// Static fields of the run, once per CSD before its inline tasks (chunked: the fields of send_proc_edge_chunk)
+int register_run(int csd_id, int num_iters, int chunked)
 {
     struct nvme_user_io io;
-    int ret;
     struct PROC_EDGE proc_edge_struct = 
     {
         .outdegree_slba = outdegree_slba,
+        .num_iters = num_iters,
+        .cost_modeling = cost_modeling,
+        .algorithm = algorithm, // 0: Pagerank, 1: Label Propagation, 2: Dispersion
+        .csd_id = csd_id,
+        .num_partitions = num_partitions,
+        .num_csds = num_csds,
+        .num_vertices = num_vertices,
+        .sum_layout = sum_layout,
+        .reduce_scatter = chunked ? 0 : reduce_scatter,
+        .block_placement = chunked ? 0 : block_placement,
+        .traversal = chunked ? 0 : traversal_order,
+    };
+
+    setup_nvme_csd_proc_edge_command(&io, &proc_edge_struct, REGISTER_RUN);
+    return nvme_io_submit(fd[csd_id], &io);
+}
+
+int register_runs(void *buffer, int num_iters, int chunked)
+{
+    // Fields past the inline encoding would be silently truncated
+    if(num_iters > PROC_EDGE_INLINE_MAX_ITER){
+        fprintf(stderr, "%d iterations, inline tasks carry up to %d\n", num_iters, PROC_EDGE_INLINE_MAX_ITER);
+        cleanup(buffer);
+        return -1;
+    }
+    for(int r = 0; chunked && r < num_partitions; r++){
+        for(int c = 0; c < num_partitions; c++){
+            if(num_edge_chunks[r][c] > PROC_EDGE_INLINE_MAX_CHUNK + 1){
+                fprintf(stderr, "Block %d-%d in %d chunks, inline tasks carry up to %d\n",
+                    r, c, num_edge_chunks[r][c], PROC_EDGE_INLINE_MAX_CHUNK + 1);
+                cleanup(buffer);
+                return -1;
+            }
+        }
+    }
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        if(register_run(csd_id, num_iters, chunked) < 0){
+            cleanup(buffer);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int send_proc_edge(int r, int c, int csd_id, int iter, int num_iters, int is_sync, int is_fvc, int is_prefetching, int row_overlap)
+{
+    struct nvme_passthru_cmd cmd;
+    struct PROC_EDGE proc_edge_struct = 
+    {
         .edge_block_slba = edge_blocks_slba[r][c][csd_id],
         .edge_block_len = edge_blocks_length[r][c][csd_id],
         .iter = iter,
-        .num_iters = num_iters,
         .is_fvc = is_fvc,
         .is_prefetching = is_prefetching,
         .row_overlap = row_overlap,
+        .r = r, .c = c,
+    };
+
+    (void)num_iters;    // Registered with the run
+    setup_nvme_csd_inline_command(&cmd, csd_id, &proc_edge_struct, is_sync);
+    return nvme_passthru_submit(fd[csd_id], &cmd);
+}
+
+// Edge chunk k of block (r, c) on its h-th holder
+int send_proc_edge_chunk(int r, int c, int k, int h, int iter, int num_iters)
+{
+    struct nvme_passthru_cmd cmd;
+    struct edge_chunk *chunk = &edge_chunks[r][c][k];
+    int csd_id = chunk->csd_id[h];
+    struct PROC_EDGE proc_edge_struct = 
+    {
+        .edge_block_slba = chunk->slba[h],
+        .edge_block_len = chunk->len,
+        .iter = iter,
+        .r = r, .c = c,
+        .chunk = k,
+    };
+
+    (void)num_iters;
+    setup_nvme_csd_inline_command(&cmd, csd_id, &proc_edge_struct, SYNC);
+    return nvme_passthru_submit(fd[csd_id], &cmd);
+}
+
+// One command per CSD for the whole run, the CSD generates the normal tasks of every iteration
+int send_run_plan(int csd_id, int num_iters, int is_prefetching, int row_overlap)
+{
+    struct nvme_user_io io;
+    struct PROC_EDGE proc_edge_struct = 
+    {
+        .outdegree_slba = outdegree_slba,
+        .num_iters = num_iters,
+        .is_prefetching = is_prefetching,
+        .row_overlap = row_overlap,
         .cost_modeling = cost_modeling,
-        .algorithm = algorithm, // 0: Pagerank, 1: Label Propagation, 2: Dispersion
-        .r = r, .c = c, .csd_id = csd_id,
+        .algorithm = algorithm,
+        .csd_id = csd_id,
         .num_partitions = num_partitions,
         .num_csds = num_csds,
         .num_vertices = num_vertices,
+        .sum_layout = sum_layout,
+        .reduce_scatter = reduce_scatter,
+        .block_placement = block_placement,
+        .traversal = traversal_order,
+        .plan_slba = plan_slba[csd_id],
     };
 
-    setup_nvme_csd_proc_edge_command(&io, &proc_edge_struct, is_sync);
-    ret = nvme_io_submit(fd[csd_id], &io);
-    return ret;
+    setup_nvme_csd_proc_edge_command(&io, &proc_edge_struct, RUN_PLAN);
+    return nvme_io_submit(fd[csd_id], &io);
 }
 
 void get_partition_range(size_t partition_id, size_t *begin, size_t *end){
-    // LUMOS's get_partition_range in partition.hpp
-    const size_t split_partition = num_vertices % num_partitions;
-    const size_t partition_size = num_vertices / num_partitions + 1;
-    if (partition_id < split_partition) {
-        *begin = partition_id * partition_size;
-        *end = (partition_id + 1) * partition_size;
-    }
-    else{
-        const size_t split_point = split_partition * partition_size;
-        *begin = split_point + (partition_id - split_partition) * (partition_size - 1);
-        *end = split_point + (partition_id - split_partition + 1) * (partition_size - 1);
-    }
+    // Same split as the CSDs, which reduce whole partitions in reduce-scatter mode
+    __u64 b, e;
+    partition_range(num_vertices, num_partitions, partition_id, &b, &e);
+    *begin = b;
+    *end = e;
 }
 
 void aggr_partition(int c){
-    for(int r = 0; r < num_partitions; r++){
-        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-            int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-            while(!hmb_dev.done1.virt_addr[id]);
-        }
+    // Reduce-scatter: the owner CSD adds up the partial sums once every CSD completed the column
+    if(reduce_scatter){
+        hmb_wait_until(&hmb_dev, hmb_column_reduced(&hmb_dev, c));
+        return;
+    }
+    // Column c is aggregated once every CSD completed all of its rows
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        hmb_wait_until(&hmb_dev, hmb_column_complete(&hmb_dev.done1, csd_id, c, num_partitions));
     }
 }
 
 void aggr_edge_block(int r, int c, bool is_normal){
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
         if(is_normal){
-            while(!hmb_dev.done1.virt_addr[id]);
+            hmb_wait_until(&hmb_dev, hmb_test_done(&hmb_dev.done1, csd_id, r, c, num_partitions));
         }
         else{
-            while(!hmb_dev.done2.virt_addr[id]);
+            hmb_wait_until(&hmb_dev, hmb_test_done(&hmb_dev.done2, csd_id, r, c, num_partitions));
+        }
+    }
+}
+
+// Partial sum of vertex v from a CSD in buf1/buf2
+static inline long long partial_sum_index(int csd_id, long long v)
+{
+    return partial_sum_base(sum_layout, num_vertices, csd_id) + v * partial_sum_stride(sum_layout, num_csds);
+}
+
+#if defined(__x86_64__)
+// The same additions in the same order as the scalar loops, eight or sixteen vertices at a time
+__attribute__((target("avx2")))
+static size_t reduce_partial_sums_avx2(float *buf, size_t begin, size_t end)
+{
+    size_t v;
+    if(sum_layout == SUM_LAYOUT_INTERLEAVED){
+        __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(num_csds));
+        for(v = begin; v + 8 <= end; v += 8){
+            float *sum = buf + partial_sum_index(0, v);
+            __m256 acc = _mm256_loadu_ps(buf + v);
+            for(int csd_id = 0; csd_id < num_csds; csd_id++)
+                acc = _mm256_add_ps(acc, _mm256_i32gather_ps(sum + csd_id, idx, 4));
+            _mm256_storeu_ps(buf + v, acc);
+            for(int i = 0; i < 8 * num_csds; i += 8)
+                _mm256_storeu_ps(sum + i, _mm256_setzero_ps());
+        }
+        return v;
+    }
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        float *sum = buf + partial_sum_index(csd_id, 0);
+        for(v = begin; v + 8 <= end; v += 8){
+            _mm256_storeu_ps(buf + v, _mm256_add_ps(_mm256_loadu_ps(buf + v), _mm256_loadu_ps(sum + v)));
+            _mm256_storeu_ps(sum + v, _mm256_setzero_ps());
+        }
+    }
+    return begin + (end - begin) / 8 * 8;
+}
+
+__attribute__((target("avx512f")))
+static size_t reduce_partial_sums_avx512(float *buf, size_t begin, size_t end)
+{
+    size_t v;
+    if(sum_layout == SUM_LAYOUT_INTERLEAVED){
+        __m512i idx = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm512_set1_epi32(num_csds));
+        for(v = begin; v + 16 <= end; v += 16){
+            float *sum = buf + partial_sum_index(0, v);
+            __m512 acc = _mm512_loadu_ps(buf + v);
+            for(int csd_id = 0; csd_id < num_csds; csd_id++)
+                acc = _mm512_add_ps(acc, _mm512_i32gather_ps(idx, sum + csd_id, 4));
+            _mm512_storeu_ps(buf + v, acc);
+            for(int i = 0; i < 16 * num_csds; i += 16)
+                _mm512_storeu_ps(sum + i, _mm512_setzero_ps());
+        }
+        return v;
+    }
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        float *sum = buf + partial_sum_index(csd_id, 0);
+        for(v = begin; v + 16 <= end; v += 16){
+            _mm512_storeu_ps(buf + v, _mm512_add_ps(_mm512_loadu_ps(buf + v), _mm512_loadu_ps(sum + v)));
+            _mm512_storeu_ps(sum + v, _mm512_setzero_ps());
+        }
+    }
+    return begin + (end - begin) / 16 * 16;
+}
+#endif
+
+// Add the partial sums of [begin, end) into the values and clear them
+void reduce_partial_sums(volatile float *buf, size_t begin, size_t end)
+{
+#if defined(__x86_64__)
+    // The partition is owned by this thread once its column is aggregated
+    if(__builtin_cpu_supports("avx512f"))
+        begin = reduce_partial_sums_avx512((float*)buf, begin, end);
+    else if(__builtin_cpu_supports("avx2"))
+        begin = reduce_partial_sums_avx2((float*)buf, begin, end);
+#endif
+    if(sum_layout == SUM_LAYOUT_INTERLEAVED){
+        // The sums of v are the num_csds floats after those of v - 1
+        volatile float *sum = buf + partial_sum_index(0, begin);
+        for(size_t v = begin; v < end; v++){
+            float acc = buf[v];
+            for(int csd_id = 0; csd_id < num_csds; csd_id++){
+                acc += sum[csd_id];
+                sum[csd_id] = 0.0;
+            }
+            buf[v] = acc;
+            sum += num_csds;
+        }
+        return;
+    }
+    for(size_t v = begin; v < end; v++){
+        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+            buf[v] += buf[partial_sum_index(csd_id, v)];
+            buf[partial_sum_index(csd_id, v)] = 0.0;
         }
     }
 }
 
 void conv_partition(size_t partition_id){
+    volatile float *next = hmb_value_buf(&hmb_dev, HMB_ROLE_NEXT);
     size_t begin, end;
     get_partition_range(partition_id, &begin, &end);
 
     // Add up vertex values to Host DRAM
     if(algorithm == 0){
         // Pagerank
-        for(size_t v = begin; v < end; v++){
-            for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                hmb_dev.buf1.virt_addr[v] += hmb_dev.buf1.virt_addr[v + (csd_id + 1) * num_vertices];
-                hmb_dev.buf1.virt_addr[v + (csd_id + 1) * num_vertices] = 0.0;
-            }
-        }
+        reduce_partial_sums(next, begin, end);
         // Conv the values, for convergence
         for(size_t v = begin; v < end; v++)
-            hmb_dev.buf1.virt_addr[v] = 0.15f + 0.85f * hmb_dev.buf1.virt_addr[v];
+            next[v] = 0.15f + 0.85f * next[v];
     }
     else if(algorithm == 1){
         // Label Propagation
         int freq_src[2], freq_dst[2];
         for(size_t v = begin; v < end; v++){
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                long long hmb_offset = (long long)(csd_id + 1) * num_vertices;
-                freq_src[0] = (int)hmb_dev.buf1.virt_addr[v + hmb_offset] & 0xFFFF;
-			    freq_src[1] = ((int)hmb_dev.buf1.virt_addr[v + hmb_offset] >> 16) & 0xFFFF;
-                freq_dst[0] = (int)hmb_dev.buf1.virt_addr[v] & 0xFFFF;
-                freq_dst[1] = ((int)hmb_dev.buf1.virt_addr[v] >> 16) & 0xFFFF;
-                hmb_dev.buf1.virt_addr[v + (csd_id + 1) * num_vertices] = 0.0;
-                hmb_dev.buf1.virt_addr[v] = (float)((freq_dst[0] + freq_src[0]) | ((freq_dst[1] + freq_src[1]) << 16));
+                long long hmb_offset = partial_sum_index(csd_id, v);
+                freq_src[0] = (int)next[hmb_offset] & 0xFFFF;
+			    freq_src[1] = ((int)next[hmb_offset] >> 16) & 0xFFFF;
+                freq_dst[0] = (int)next[v] & 0xFFFF;
+                freq_dst[1] = ((int)next[v] >> 16) & 0xFFFF;
+                next[hmb_offset] = 0.0;
+                next[v] = (float)((freq_dst[0] + freq_src[0]) | ((freq_dst[1] + freq_src[1]) << 16));
             }
         }
     }
@@ -431,9 +1021,9 @@ void conv_partition(size_t partition_id){
         // Dispersion
         for(size_t v = begin; v < end; v++){
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                if(hmb_dev.buf1.virt_addr[v + (csd_id + 1) * num_vertices] == 1.0)
-                    hmb_dev.buf1.virt_addr[v] = 1.0;
-                hmb_dev.buf1.virt_addr[v + (csd_id + 1) * num_vertices] = 0.0;
+                if(next[partial_sum_index(csd_id, v)] == 1.0)
+                    next[v] = 1.0;
+                next[partial_sum_index(csd_id, v)] = 0.0;
             }
         }
     }
@@ -443,54 +1033,175 @@ void conv_partition(size_t partition_id){
     long long end_time = get_time_ns() + num_pages * (aggregation_time);
     // printf("Aggregation time span: %lld\n", num_pages * (aggregation_time));
     while(get_time_ns() < end_time);
-    hmb_dev.done_partition.virt_addr[partition_id] = true;
+    hmb_set_bit(&hmb_dev.done_partition, partition_id);
 }
 
-void end_of_iter_waiting(){
-    bool can_end_of_iter_update = false;
-    do {
-        can_end_of_iter_update = true;
-        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-            if(!hmb_dev.done_partition.virt_addr[num_partitions + csd_id + 1]){
-                can_end_of_iter_update = false;
-                break;
-            }
-        }
-    } while(!can_end_of_iter_update);
+static void aggr_run_job(struct aggr_job job)
+{
+    long long s = get_time_ns();
+    if(job.type == AGGR_JOB_CONV){
+        conv_partition(job.c);
+    }
+    else{
+        size_t begin, end;
+        get_partition_range(job.c, &begin, &end);
+        reduce_partial_sums(hmb_value_buf(&hmb_dev, HMB_ROLE_FUTURE), begin, end);
+    }
+    long long e = get_time_ns();
+    __atomic_fetch_add(&total_aggr_time, e - s, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&aggr_column_time[job.c], e - s, __ATOMIC_RELAXED);
 }
 
-void end_of_iter_replacing()
+static void* aggr_worker(void* arg)
 {
-    // Vertices update in Host DRAM (Mapped with CSD)
-    for(long long v = 0; v < num_vertices; v++){
-        hmb_dev.buf0.virt_addr[v] = hmb_dev.buf1.virt_addr[v];
-        hmb_dev.buf1.virt_addr[v] = hmb_dev.buf2.virt_addr[v];
-        hmb_dev.buf2.virt_addr[v] = 0.0;
+    struct aggr_pool *pool = arg;
+    struct aggr_job job;
+
+    pthread_mutex_lock(&pool->lock);
+    while(true){
+        while(!pool->stop && pool->head == pool->tail)
+            pthread_cond_wait(&pool->job_cond, &pool->lock);
+        if(pool->head == pool->tail)
+            break;
+        job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % (2 * MAX_PARTITION);
+        pthread_mutex_unlock(&pool->lock);
+
+        aggr_run_job(job);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->pending == 0)
+            pthread_cond_broadcast(&pool->idle_cond);
     }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
 
-    for(int c = 0; c < num_partitions; c++){
-        for(int r = 0; r < num_partitions; r++){
-            for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                hmb_dev.done1.virt_addr[id] = hmb_dev.done2.virt_addr[id];
-                hmb_dev.done2.virt_addr[id] = false;
-            }
+int aggr_pool_init(int num_threads)
+{
+    struct aggr_pool *pool = &aggr_pool;
+
+    memset(aggr_column_time, 0, sizeof(aggr_column_time));
+    pool->num_threads = 0;
+    pool->head = pool->tail = pool->pending = 0;
+    pool->stop = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_cond, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    for(int i = 0; i < min(num_threads, MAX_AGGR_THREADS); i++){
+        if(pthread_create(&pool->threads[i], NULL, aggr_worker, pool) != 0){
+            perror("Failed to create aggregation thread");
+            break;
         }
+        pool->num_threads++;
+    }
+    return pool->num_threads;
+}
+
+void aggr_pool_destroy()
+{
+    struct aggr_pool *pool = &aggr_pool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->job_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for(int i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+    pool->num_threads = 0;
+}
+
+static void aggr_pool_submit(int type, int c)
+{
+    struct aggr_pool *pool = &aggr_pool;
+    struct aggr_job job = {.type = type, .c = c};
+
+    if(pool->num_threads == 0){
+        aggr_run_job(job);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while(pool->pending == 2 * MAX_PARTITION - 1)
+        pthread_cond_wait(&pool->idle_cond, &pool->lock);
+    pool->jobs[pool->tail] = job;
+    pool->tail = (pool->tail + 1) % (2 * MAX_PARTITION);
+    pool->pending++;
+    pthread_cond_signal(&pool->job_cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Column c is aggregated by the CSDs: reduce it and notify the CSDs through done_partition
+void aggr_pool_conv(int c)
+{
+    // Already reduced and applied by its owner CSD, only the notification is left
+    if(reduce_scatter){
+        hmb_set_bit(&hmb_dev.done_partition, c);
+        return;
+    }
+    aggr_pool_submit(AGGR_JOB_CONV, c);
+}
+
+// Future values of column c, only read after the end of the iteration
+void aggr_pool_future(int c)
+{
+    aggr_pool_submit(AGGR_JOB_FUTURE, c);
+}
+
+void aggr_pool_wait()
+{
+    struct aggr_pool *pool = &aggr_pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->pending > 0)
+        pthread_cond_wait(&pool->idle_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void print_aggr_column_time()
+{
+    int ms_ns_ratio = 1000000;
+
+    printf("Aggregation time per column (ms):");
+    for(int c = 0; c < num_partitions; c++)
+        printf(" %lld", aggr_column_time[c] / ms_ns_ratio);
+    printf("\n");
+}
+
+void end_of_iter_waiting(){
+    // Every CSD is in the end of iteration handshake
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        hmb_wait_until(&hmb_dev, hmb_test_bit(&hmb_dev.done_partition, num_partitions + csd_id + 1));
     }
+}
+
+void end_of_iter_replacing()
+{
+    // Every column reduction of the iteration has to land before the rotation
+    aggr_pool_wait();
+
+    // Vertices update in Host DRAM (Mapped with CSD): rotate the buffers, the partial sums
+    // of the new v_t+2 were already cleared when it was aggregated as v_t+1.
+    // done2 becomes done1 with the epoch, the completions need no reset
+    volatile float *future = hmb_rotate_values(&hmb_dev);
+    for(long long v = 0; v < num_vertices; v++)
+        future[v] = 0.0;
+
     for(int c = 0; c < num_partitions; c++)
-        hmb_dev.done_partition.virt_addr[c] = false;
+        hmb_clear_bit(&hmb_dev.done_partition, c);
 
     // Notify end of iteration done in CSDs
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        hmb_dev.done_partition.virt_addr[num_partitions + csd_id + 1] = false;
+        hmb_clear_bit(&hmb_dev.done_partition, num_partitions + csd_id + 1);
     }
 }
 
 int flush_csd_dram(void* buffer)
 {
     int ret;
+    __u32 flushed[MAX_NUM_CSDS];
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        hmb_dev.done2.virt_addr[csd_id] = false;
+        // Each flush bumps the flush counter of the CSD
+        flushed[csd_id] = hmb_flushed(&hmb_dev, csd_id);
         ret = send_proc_edge(0, 0, csd_id, 0, 0, FLUSH_CSD_DRAM, false, false, false);
         if(ret < 0){
             cleanup(buffer);
@@ -498,7 +1209,7 @@ int flush_csd_dram(void* buffer)
         }
     }
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        while(!hmb_dev.done2.virt_addr[csd_id]);
+        hmb_wait_until(&hmb_dev, hmb_flushed(&hmb_dev, csd_id) != flushed[csd_id]);
     }
     return 0;
 }
@@ -506,6 +1217,9 @@ int flush_csd_dram(void* buffer)
 int csd_proc_edge_loop_normal(void* buffer, int num_iter)
 {
     int ret;
+
+    if(register_runs(buffer, num_iter, false) < 0)
+        return -1;
     for(int iter = 0; iter < num_iter; iter++){
         for(int c = 0; c < num_partitions; c++){
             for(int r = 0; r < num_partitions; r++){
@@ -518,7 +1232,7 @@ int csd_proc_edge_loop_normal(void* buffer, int num_iter)
                 }
                 aggr_edge_block(r, c, true);
             }
-            conv_partition(c);
+            aggr_pool_conv(c);
         }
         end_of_iter_replacing();
     }
@@ -534,7 +1248,9 @@ int csd_proc_edge_loop_normal(void* buffer, int num_iter)
 int csd_proc_edge_loop_grafu(void* buffer, int num_iter)
 {
     int ret;
-    
+
+    if(register_runs(buffer, num_iter, false) < 0)
+        return -1;
     for(int iter = 0; iter < num_iter; iter++)
     {
         if(iter % 2 == 0){
@@ -576,16 +1292,8 @@ int csd_proc_edge_loop_grafu(void* buffer, int num_iter)
                 }
 
                 // Aggregate future values
-                if(iter != num_iter - 1){
-                    size_t begin, end;
-                    get_partition_range(c, &begin, &end);
-                    for(size_t v = begin; v < end; v++){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            hmb_dev.buf2.virt_addr[v] += hmb_dev.buf2.virt_addr[v + (csd_id + 1) * num_vertices];
-                            hmb_dev.buf2.virt_addr[v + (csd_id + 1) * num_vertices] = 0.0;
-                        }
-                    }
-                }
+                if(iter != num_iter - 1)
+                    aggr_pool_future(c);
             }
         }
         else{
@@ -600,170 +1308,223 @@ int csd_proc_edge_loop_grafu(void* buffer, int num_iter)
                             return -1;
                         }
                     }
-                    aggr_edge_block(r, c, true);
-                    if(iter != num_iter - 1){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            ret = send_proc_edge(r, c, csd_id, iter + 1, num_iter, SYNC, true, false, false);
-                            if(ret < 0){
-                                cleanup(buffer);
-                                return -1;
+                    aggr_edge_block(r, c, true);
+                    if(iter != num_iter - 1){
+                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+                            ret = send_proc_edge(r, c, csd_id, iter + 1, num_iter, SYNC, true, false, false);
+                            if(ret < 0){
+                                cleanup(buffer);
+                                return -1;
+                            }
+                        }
+                        aggr_edge_block(r, c, false);
+                    }
+                }
+                conv_partition(c);
+
+                // Aggregate future values
+                if(iter != num_iter - 1)
+                    aggr_pool_future(c);
+            }
+        }
+        end_of_iter_replacing();
+    }
+    if(flush_csd_dram(buffer) == -1)
+        return -1;
+
+    // for(int i = max(0, num_vertices - 5); i < num_vertices; i++)
+    //     printf("Vertex[%d]: %f\n", i, hmb_dev.buf0.virt_addr[i]);
+
+    return 0;
+}
+
+int csd_proc_edge_loop_dual_queue(void *buffer, int num_iter, int is_prefetching, int row_overlap)
+{
+    int ret;
+
+    if(register_runs(buffer, num_iter, false) < 0)
+        return -1;
+
+    // For HMB size monitoring
+    curr_edge_column_normal = curr_edge_column_future = 0;
+
+    // Same block order as the CSDs, which end each iteration after its sentinel block
+    traversal_init(&trav, traversal_order, num_partitions, row_overlap);
+    
+    for(int iter = 0; iter < num_iter; iter++)
+    {
+        // For HMB size monitoring
+        curr_iter = iter;
+
+        // 1. Iter: Sending ioctl command for all edge blocks, the blocks done as future tasks are skipped
+        // (column-major, or row-major with row_overlap == 3, backward in odd iterations by default)
+        for(unsigned int k = 0; k < traversal_len(&trav); k++){
+            int r, c;
+            if(!traversal_block(&trav, iter, k, &r, &c))
+                continue;
+            for(int csd_id = 0; csd_id < num_csds; csd_id++){
+                if(edge_blocks_length[r][c][csd_id] == 0 && !traversal_is_sentinel(&trav, iter, r, c))
+                    hmb_set_done(&hmb_dev.done1, csd_id, r, c, num_partitions); // size = 0 && not the last task, mark as done
+                if(hmb_test_done(&hmb_dev.done1, csd_id, r, c, num_partitions))
+                    continue;
+                ret = send_proc_edge(r, c, csd_id, iter, num_iter, ASYNC, false, is_prefetching, row_overlap);
+                if(ret < 0){
+                    cleanup(buffer);
+                    return -1;
+                }
+            }
+        }
+
+        // 2. Aggregate for each columns, in the order the traversal completes them
+        for(int i = 0; i < num_partitions; i++){
+            int c = traversal_column(&trav, iter, i);
+            aggr_partition(c);
+            aggr_pool_conv(c);
+
+            // HMB size monitoring
+            curr_edge_column_normal = c;
+        }
+
+        // 3. End of the iter update
+        // Performed after last column aggregation end (e.g. Ensuring CSD are notified)
+        // long long end_start = get_time_ns();
+        end_of_iter_waiting();
+        end_of_iter_replacing();
+        // long long end_end = get_time_ns();
+        // printf("End-of-iter update time: %lld us\n", (end_end - end_start) / 1000);
+    }
+    if(flush_csd_dram(buffer) == -1)
+        return -1;
+
+    // for(int i = max(0, num_vertices - 5); i < num_vertices; i++)
+    //     printf("Vertex[%d]: %f\n", i, hmb_dev.buf0.virt_addr[i]);
+
+    return 0;
+}
+
+// Column-by-column like csd_proc_edge_loop_normal, but the chunks of a column go to whichever CSD is idle.
+// One chunk in flight per CSD, its completion is the done1 flag of (csd_id, r, c).
+int csd_proc_edge_loop_balanced(void* buffer, int num_iter)
+{
+    int ret;
+    int running_r[num_csds], running_k[num_csds];
+    long long chunk_cnt[num_csds];
+
+    if(register_runs(buffer, num_iter, true) < 0)
+        return -1;
+    for(int csd_id = 0; csd_id < num_csds; csd_id++)
+        chunk_cnt[csd_id] = 0;
+
+    for(int iter = 0; iter < num_iter; iter++){
+        for(int c = 0; c < num_partitions; c++){
+            int total = 0, finished = 0;
+            int next_k[num_partitions];
+            char *state[num_partitions];    // 0: pending, 1: running, 2: done
+
+            for(int r = 0; r < num_partitions; r++){
+                next_k[r] = 0;
+                state[r] = calloc(num_edge_chunks[r][c] > 0 ? num_edge_chunks[r][c] : 1, 1);
+                total += num_edge_chunks[r][c];
+            }
+            for(int csd_id = 0; csd_id < num_csds; csd_id++)
+                running_r[csd_id] = -1;
+
+            while(finished < total){
+                for(int csd_id = 0; csd_id < num_csds; csd_id++){
+                    // Completion of the chunk in flight
+                    if(running_r[csd_id] != -1){
+                        int r = running_r[csd_id];
+                        if(!hmb_test_done(&hmb_dev.done1, csd_id, r, c, num_partitions))
+                            continue;
+                        state[r][running_k[csd_id]] = 2;
+                        running_r[csd_id] = -1;
+                        finished++;
+                        chunk_cnt[csd_id]++;
+                    }
+
+                    // Next chunk: home chunks first, then replicas of pending chunks (tail stealing)
+                    int sel_r = -1, sel_k = -1, sel_h = -1;
+                    for(int h = 0; h < MAX_CHUNK_HOLDERS && sel_r == -1; h++){
+                        for(int r = 0; r < num_partitions && sel_r == -1; r++){
+                            for(int k = (h == 0 ? next_k[r] : 0); k < num_edge_chunks[r][c]; k++){
+                                struct edge_chunk *chunk = &edge_chunks[r][c][k];
+                                if(state[r][k] == 0 && h < chunk->num_holders && chunk->csd_id[h] == csd_id){
+                                    sel_r = r, sel_k = k, sel_h = h;
+                                    break;
+                                }
                             }
                         }
-                        aggr_edge_block(r, c, false);
                     }
-                }
-                conv_partition(c);
-
-                // Aggregate future values
-                if(iter != num_iter - 1){
-                    size_t begin, end;
-                    get_partition_range(c, &begin, &end);
-                    for(size_t v = begin; v < end; v++){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            hmb_dev.buf2.virt_addr[v] += hmb_dev.buf2.virt_addr[v + (csd_id + 1) * num_vertices];
-                            hmb_dev.buf2.virt_addr[v + (csd_id + 1) * num_vertices] = 0.0;
-                        }
+                    if(sel_r == -1)
+                        continue;
+                    if(sel_h == 0)
+                        next_k[sel_r] = sel_k + 1;
+
+                    hmb_clear_done(&hmb_dev.done1, csd_id, sel_r, c, num_partitions);
+                    state[sel_r][sel_k] = 1;
+                    running_r[csd_id] = sel_r;
+                    running_k[csd_id] = sel_k;
+                    ret = send_proc_edge_chunk(sel_r, c, sel_k, sel_h, iter, num_iter);
+                    if(ret < 0){
+                        cleanup(buffer);
+                        return -1;
                     }
                 }
             }
+            for(int r = 0; r < num_partitions; r++)
+                free(state[r]);
+            aggr_pool_conv(c);
         }
         end_of_iter_replacing();
     }
     if(flush_csd_dram(buffer) == -1)
         return -1;
 
-    // for(int i = max(0, num_vertices - 5); i < num_vertices; i++)
-    //     printf("Vertex[%d]: %f\n", i, hmb_dev.buf0.virt_addr[i]);
+    for(int csd_id = 0; csd_id < num_csds; csd_id++)
+        printf("CSD %d processed %lld chunks\n", csd_id, chunk_cnt[csd_id]);
 
     return 0;
 }
 
-int csd_proc_edge_loop_dual_queue(void *buffer, int num_iter, int is_prefetching, int row_overlap)
+// Same schedule as csd_proc_edge_loop_dual_queue, but the tasks are generated by the CSDs (run plan)
+int csd_proc_edge_loop_planned(void *buffer, int num_iter, int is_prefetching, int row_overlap)
 {
     int ret;
 
     // For HMB size monitoring
     curr_edge_column_normal = curr_edge_column_future = 0;
-    
+    traversal_init(&trav, traversal_order, num_partitions, row_overlap);
+
+    for(int csd_id = 0; csd_id < num_csds; csd_id++){
+        ret = send_run_plan(csd_id, num_iter, is_prefetching, row_overlap);
+        if(ret < 0){
+            cleanup(buffer);
+            return -1;
+        }
+    }
+
     for(int iter = 0; iter < num_iter; iter++)
     {
         // For HMB size monitoring
         curr_iter = iter;
-        if(iter % 2 == 0){
-            // 1. Iter: Sending ioctl command for all edge blocks
-            if(row_overlap == 3 && iter > 0){
-                // Send row of normal tasks instead of column of normal tasks (Row execution)
-                for(int r = 0; r < num_partitions; r++){
-                    for(int c = 0; c < num_partitions; c++){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                            if(edge_blocks_length[r][c][csd_id] == 0 && !(r == num_partitions - 1 && c == num_partitions - 1))
-                                hmb_dev.done1.virt_addr[id] = true; // size = 0 && not the last task, mark as done
-                            if(hmb_dev.done1.virt_addr[id])
-                                continue;
-                            ret = send_proc_edge(r, c, csd_id, iter, num_iter, ASYNC, false, is_prefetching, row_overlap);
-                            if(ret < 0){
-                                cleanup(buffer);
-                                return -1;
-                            }
-                        }
-                    }
-                }
-            }
-            else{
-                for(int c = 0; c < num_partitions; c++){
-                    for(int r = 0; r < num_partitions; r++){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                            if(edge_blocks_length[r][c][csd_id] == 0 && !(r == num_partitions - 1 && c == num_partitions - 1))
-                                hmb_dev.done1.virt_addr[id] = true; // size = 0 && not the last task, mark as done
-                            if(hmb_dev.done1.virt_addr[id])
-                                continue;
-                            ret = send_proc_edge(r, c, csd_id, iter, num_iter, ASYNC, false, is_prefetching, row_overlap);
-                            if(ret < 0){
-                                cleanup(buffer);
-                                return -1;
-                            }
-                        }
-                    }
-                }
-            }
-            // 2. Aggregate for each columns
-            for(int c = 0; c < num_partitions; c++){
-                aggr_partition(c);
-                long long end_start = get_time_ns();
-                conv_partition(c);
-                long long end_end = get_time_ns();
-                total_aggr_time += (end_end - end_start);
 
-                // HMB size monitoring
-                curr_edge_column_normal = c;
-            }
+        // 1. Aggregate for each columns (the CSDs mark their empty edge blocks as done from the plan)
+        for(int i = 0; i < num_partitions; i++){
+            int c = traversal_column(&trav, iter, i);
+            aggr_partition(c);
+            aggr_pool_conv(c);
 
+            // HMB size monitoring
+            curr_edge_column_normal = c;
         }
-        else{
-            if(row_overlap == 3 && iter > 0){
-                // Send row of normal tasks instead of column of normal tasks
-                for(int r = num_partitions - 1; r >= 0; r--){
-                    for(int c = num_partitions - 1; c >= 0; c--){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                            if(edge_blocks_length[r][c][csd_id] == 0 && !(r == 1 && c == 0))
-                                hmb_dev.done1.virt_addr[id] = true; // No edge block, mark as done
-                            if(hmb_dev.done1.virt_addr[id])
-                                continue;
-                            ret = send_proc_edge(r, c, csd_id, iter, num_iter, ASYNC, false, is_prefetching, row_overlap);
-                            if(ret < 0){
-                                cleanup(buffer);
-                                return -1;
-                            }
-                        }
-                    }
-                }
-            }
-            else{
-                for(int c = num_partitions - 1; c >= 0; c--){
-                    for(int r = 0; r < num_partitions; r++){
-                        for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                            int id = csd_id * num_partitions * num_partitions + r * num_partitions + c;
-                            if(edge_blocks_length[r][c][csd_id] == 0 && !(r == num_partitions - 1 && c == 0))
-                                hmb_dev.done1.virt_addr[id] = true; // No edge block, mark as done
-                            if(hmb_dev.done1.virt_addr[id])
-                                continue;
-                            ret = send_proc_edge(r, c, csd_id, iter, num_iter, ASYNC, false, is_prefetching, row_overlap);
-                            if(ret < 0){
-                                cleanup(buffer);
-                                return -1;
-                            }
-                        }
-                    }
-                }
-            }
-            for(int c = num_partitions - 1; c >= 0; c--){
-                aggr_partition(c);
-                long long end_start = get_time_ns();
-                conv_partition(c);
-                long long end_end = get_time_ns();
-                total_aggr_time += (end_end - end_start);
 
-                // HMB size monitoring
-                curr_edge_column_normal = c;
-            }
-        }
-        // 3. End of the iter update
-        // Performed after last column aggregation end (e.g. Ensuring CSD are notified)
-        // long long end_start = get_time_ns();
+        // 2. End of the iter update
         end_of_iter_waiting();
         end_of_iter_replacing();
-        // long long end_end = get_time_ns();
-        // printf("End-of-iter update time: %lld us\n", (end_end - end_start) / 1000);
     }
     if(flush_csd_dram(buffer) == -1)
         return -1;
 
-    // for(int i = max(0, num_vertices - 5); i < num_vertices; i++)
-    //     printf("Vertex[%d]: %f\n", i, hmb_dev.buf0.virt_addr[i]);
-
     return 0;
 }
 
@@ -801,6 +1562,128 @@ void run_normal_grafu_dq(void* buffer, int __num_iter){
     printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
 }
 
+void run_balanced(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+
+    printf("Normal----------");
+    init_csds_data(fd, buffer);
+    s = get_time_ns();
+    csd_proc_edge_loop_normal(buffer, __num_iter);
+    e = get_time_ns();
+    printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
+
+    printf("Balanced--------");
+    init_csds_data_chunked(fd, buffer);
+    s = get_time_ns();
+    csd_proc_edge_loop_balanced(buffer, __num_iter);
+    e = get_time_ns();
+    printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
+}
+
+void run_sum_layout(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+    const char *names[2] = {"CSD-major---", "Interleaved-"};
+    int layouts[2] = {SUM_LAYOUT_CSD_MAJOR, SUM_LAYOUT_INTERLEAVED};
+
+    for(int i = 0; i < 2; i++){
+        sum_layout = layouts[i];
+        total_aggr_time = 0;
+        printf("%s", names[i]);
+        init_csds_data(fd, buffer);
+        s = get_time_ns();
+        csd_proc_edge_loop_dual_queue(buffer, __num_iter, 0, 0);
+        e = get_time_ns();
+        printf("Execution time: %lld ms, Aggregation time: %lld ms\n", (e - s) / ms_ns_ratio, total_aggr_time / ms_ns_ratio);
+    }
+    sum_layout = SUM_LAYOUT_CSD_MAJOR;
+}
+
+void run_reduce_scatter(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+    const char *names[2] = {"Host-reduce-", "Reduce-scatter-"};
+
+    for(int i = 0; i < 2; i++){
+        reduce_scatter = i;
+        total_aggr_time = 0;
+        printf("%s", names[i]);
+        init_csds_data(fd, buffer);
+        s = get_time_ns();
+        csd_proc_edge_loop_dual_queue(buffer, __num_iter, 0, 0);
+        e = get_time_ns();
+        printf("Execution time: %lld ms, Aggregation time: %lld ms\n", (e - s) / ms_ns_ratio, total_aggr_time / ms_ns_ratio);
+    }
+    reduce_scatter = 0;
+}
+
+void run_block_placement(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+    const char *names[2] = {"Split-blocks-", "Owned-blocks-"};
+    int placements[2] = {BLOCK_PLACEMENT_SPLIT, BLOCK_PLACEMENT_OWNED};
+
+    for(int i = 0; i < 2; i++){
+        block_placement = placements[i];
+        total_aggr_time = 0;
+        printf("%s", names[i]);
+        init_csds_data(fd, buffer);
+        s = get_time_ns();
+        csd_proc_edge_loop_dual_queue(buffer, __num_iter, 2, 2);
+        e = get_time_ns();
+        printf("Execution time: %lld ms, Aggregation time: %lld ms\n", (e - s) / ms_ns_ratio, total_aggr_time / ms_ns_ratio);
+    }
+    block_placement = BLOCK_PLACEMENT_SPLIT;
+}
+
+void run_traversal(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+    const char *names[4] = {"Column--------", "Zig-zag-------", "Hilbert-------", "Tiled---------"};
+    int orders[4] = {TRAVERSAL_COLUMN, TRAVERSAL_ZIGZAG, TRAVERSAL_HILBERT, TRAVERSAL_TILED};
+
+    // Vertex buffer hit rates are in the CSD logs
+    for(int i = 0; i < 4; i++){
+        long long external_io_time = 0;
+        traversal_order = orders[i];
+        printf("%s", names[i]);
+        init_csds_data(fd, buffer);
+        s = get_time_ns();
+        csd_proc_edge_loop_dual_queue(buffer, __num_iter, 2, 2);
+        e = get_time_ns();
+        for(int csd_id = 0; csd_id < num_csds; csd_id++)
+            external_io_time += hmb_stat(&hmb_dev, csd_id, 3);
+        printf("Execution time: %lld ms, Avg. vertex IO time (External I/O): %lld ms\n", (e - s) / ms_ns_ratio, external_io_time / num_csds);
+    }
+    traversal_order = TRAVERSAL_COLUMN;
+}
+
+void run_dq_plan(void* buffer, int __num_iter)
+{
+    long long s, e;
+    int ms_ns_ratio = 1000000;
+
+    printf("DQ_PF-----------");
+    init_csds_data(fd, buffer);
+    s = get_time_ns();
+    csd_proc_edge_loop_dual_queue(buffer, __num_iter, 2, 2);
+    e = get_time_ns();
+    printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
+
+    printf("DQ_PF_PLAN------");
+    init_csds_data(fd, buffer);
+    s = get_time_ns();
+    csd_proc_edge_loop_planned(buffer, __num_iter, 2, 2);
+    e = get_time_ns();
+    printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
+}
+
 void run_dq_prefetch(void* buffer, int __num_iter)
 {
     float cache_hit_rate;
@@ -814,7 +1697,7 @@ void run_dq_prefetch(void* buffer, int __num_iter)
     e = get_time_ns();
     cache_hit_rate = 0.0;
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        cache_hit_rate += hmb_dev.buf2.virt_addr[csd_id];
+        cache_hit_rate += hmb_stat(&hmb_dev, csd_id, 0);
     }
     printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
     printf("Avg. cache hit rate: %f\n", cache_hit_rate / num_csds);
@@ -826,7 +1709,7 @@ void run_dq_prefetch(void* buffer, int __num_iter)
     e = get_time_ns();
     cache_hit_rate = 0.0;
     for(int csd_id = 0; csd_id < num_csds; csd_id++){
-        cache_hit_rate += hmb_dev.buf2.virt_addr[csd_id];
+        cache_hit_rate += hmb_stat(&hmb_dev, csd_id, 0);
     }
     printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
     printf("Avg. cache hit rate: %f\n", cache_hit_rate / num_csds);
@@ -848,7 +1731,7 @@ void run_dq_prefetch_priorities(void* buffer, int __num_iter)
         e = get_time_ns();
         cache_hit_rate = 0.0;
         for(int csd_id = 0; csd_id < num_csds; csd_id++){
-            cache_hit_rate += hmb_dev.buf2.virt_addr[csd_id];
+            cache_hit_rate += hmb_stat(&hmb_dev, csd_id, 0);
         }
         printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
         printf("Avg. cache hit rate: %f\n", cache_hit_rate / num_csds);
@@ -856,14 +1739,14 @@ void run_dq_prefetch_priorities(void* buffer, int __num_iter)
         for(int i = 4, j = 8; i <= 7, j <= 11; i++, j++){
             float cnt = 0.0;
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                cnt += hmb_dev.buf2.virt_addr[csd_id + num_csds * i];
+                cnt += hmb_stat(&hmb_dev, csd_id, i);
             }
             float acc = 0.0;
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                if(hmb_dev.buf2.virt_addr[csd_id + num_csds * (j + 4)] == 0.0f)
+                if(hmb_stat(&hmb_dev, csd_id, j + 4) == 0.0f)
                     acc += 1.0;
                 else
-                    acc += hmb_dev.buf2.virt_addr[csd_id + num_csds * j] / hmb_dev.buf2.virt_addr[csd_id + num_csds * (j + 4)];
+                    acc += hmb_stat(&hmb_dev, csd_id, j) / hmb_stat(&hmb_dev, csd_id, j + 4);
             }
             printf("Priority %d: %lld, accuracy: %f\n", i - 2, (long long)cnt / num_csds, acc / num_csds);
         }
@@ -894,7 +1777,7 @@ void run_dq_row_overlap(void* buffer, int __num_iter)
             e = get_time_ns();
             cache_hit_rate = 0.0;
             for(int csd_id = 0; csd_id < num_csds; csd_id++){
-                cache_hit_rate += hmb_dev.buf2.virt_addr[csd_id];
+                cache_hit_rate += hmb_stat(&hmb_dev, csd_id, 0);
             }
             printf("Execution time: %lld ms\n", (e - s) / ms_ns_ratio);
             printf("Avg. cache hit rate: %f\n", cache_hit_rate / num_csds);
@@ -926,8 +1809,8 @@ void run_dq_cache_hitrate(void* buffer, int __num_iter)
         total_time += (e - s) / ms_ns_ratio;
 
         for(int csd_id = 0; csd_id < num_csds; csd_id++){
-            cache_hit_rate += hmb_dev.buf2.virt_addr[csd_id];
-            printf("%f ", hmb_dev.buf2.virt_addr[csd_id]);
+            cache_hit_rate += hmb_stat(&hmb_dev, csd_id, 0);
+            printf("%f ", hmb_stat(&hmb_dev, csd_id, 0));
         }
         printf("\n");
     }
@@ -958,11 +1841,24 @@ void run_dq_composition(void* buffer, int __num_iter, int prefetching)
         long long edge_proc_time = 0, edge_internal_io_time = 0, edge_external_io_time = 0;
         for(int csd_id = 0; csd_id < num_csds; csd_id++){
             // Already being divided by ms_ns_ratio in kernel modules
-            edge_proc_time += hmb_dev.buf2.virt_addr[csd_id + num_csds];
-            edge_internal_io_time += hmb_dev.buf2.virt_addr[csd_id + num_csds * 2];
-            edge_external_io_time += hmb_dev.buf2.virt_addr[csd_id + num_csds * 3];
+            edge_proc_time += hmb_stat(&hmb_dev, csd_id, 1);
+            edge_internal_io_time += hmb_stat(&hmb_dev, csd_id, 2);
+            edge_external_io_time += hmb_stat(&hmb_dev, csd_id, 3);
         }
         printf("Avg. edge processing time: %lld ms\n", edge_proc_time / num_csds);
+
+        // Per edge, the processing time follows the cache misses of the vertex accesses (see graph_prep -r)
+        double ns_per_edge = 0;
+        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+            long long csd_edges = 0;
+            for(int r = 0; r < num_partitions; r++){
+                for(int c = 0; c < num_partitions; c++)
+                    csd_edges += edge_blocks_length[r][c][csd_id] / EDGE_SIZE;
+            }
+            if(csd_edges > 0)
+                ns_per_edge += (double)hmb_stat(&hmb_dev, csd_id, 1) * ms_ns_ratio / ((double)csd_edges * __num_iter);
+        }
+        printf("Avg. edge processing time per edge: %.2f ns\n", ns_per_edge / num_csds);
         printf("Avg. edge IO time (Internal I/O): %lld ms\n", edge_internal_io_time / num_csds);
         printf("Avg. vertex IO time (External I/O): %lld ms\n", edge_external_io_time / num_csds);
         printf("Total aggregation time: %lld ms\n", num_csds == 1 ? 0 : total_aggr_time / ms_ns_ratio);
@@ -1024,9 +1920,9 @@ void run_all_composition(void* buffer, int __num_iter)
         long long edge_proc_time = 0, edge_internal_io_time = 0, edge_external_io_time = 0;
         for(int csd_id = 0; csd_id < num_csds; csd_id++){
             // Already being divided by ms_ns_ratio in kernel modules
-            edge_proc_time += hmb_dev.buf2.virt_addr[csd_id + num_csds];
-            edge_internal_io_time += hmb_dev.buf2.virt_addr[csd_id + num_csds * 2];
-            edge_external_io_time += hmb_dev.buf2.virt_addr[csd_id + num_csds * 3];
+            edge_proc_time += hmb_stat(&hmb_dev, csd_id, 1);
+            edge_internal_io_time += hmb_stat(&hmb_dev, csd_id, 2);
+            edge_external_io_time += hmb_stat(&hmb_dev, csd_id, 3);
         }
         printf("Avg. edge processing time: %lld ms\n", edge_proc_time / num_csds);
         printf("Avg. edge IO time (Internal I/O): %lld ms\n", edge_internal_io_time / num_csds);
@@ -1039,13 +1935,14 @@ volatile atomic_bool monitor_running = true;
 void* monitor_window_size(void*) {
     while (atomic_load(&monitor_running)) {
         long long max_partition_offset = (long long)(num_csds + 2) * num_vertices;
+        volatile float *next = hmb_value_buf(&hmb_dev, HMB_ROLE_NEXT);
         int csd_column_normal, csd_column_future;
         csd_column_normal = curr_iter % 2 == 1 ? 0 : num_partitions - 1;
         for(int csd_id = 0; csd_id < num_csds; csd_id++){
             if(curr_iter % 2 == 0)
-                csd_column_normal = min(csd_column_normal, hmb_dev.buf1.virt_addr[max_partition_offset + csd_id]);
+                csd_column_normal = min(csd_column_normal, next[max_partition_offset + csd_id]);
             else
-                csd_column_normal = max(csd_column_normal, hmb_dev.buf1.virt_addr[max_partition_offset + csd_id]);
+                csd_column_normal = max(csd_column_normal, next[max_partition_offset + csd_id]);
             // max_csd_column_future = max(max_csd_column_future, hmb_dev.buf2.virt_addr[max_partition_offset + csd_id]);
         }
         printf("Host aggr: %d, CSD normal: %d\n", curr_edge_column_normal, csd_column_normal);
@@ -1072,10 +1969,290 @@ void run_dq_hmb_size(void* buffer, int __num_iter)
     pthread_join(monitor_thread, NULL);
 }
 
+// Declarative runs, set by the command line options (see run_experiments.sh)
+#define EXPERIMENT_MAX_REPS 1000
+#define EXPERIMENT_METRICS 8
+struct experiment {
+    const char *mode;       // normal, grafu, balanced, dq or planned, NULL runs run_normal_grafu_dq
+    int prefetching, row_overlap;
+    int repetitions, warmup;
+    const char *output;     // <output>.csv gets a row per measured run, <output>.json a summary line
+    const char *label;      // Configuration the runs belong to, module parameters included
+};
+struct experiment experiment = {
+    .mode = NULL,
+    .prefetching = 2,
+    .row_overlap = 2,
+    .repetitions = 1,
+    .warmup = 0,
+    .output = NULL,
+    .label = "",
+};
+const char *experiment_metrics[EXPERIMENT_METRICS] = {
+    "exec_ms", "edge_proc_ms", "internal_io_ms", "external_io_ms", "aggr_ms", "edge_hit_rate", "host_ms", "error",
+};
+
+// Host-only reference of the runs, verify=<threads> (see graph_ref.h)
+int verify_threads = 0;
+struct graph_ref ref;
+
+// Host knobs settable with -s name=value
+int set_knob(const char *arg)
+{
+    const char *eq = strchr(arg, '=');
+    int value;
+
+    if(!eq)
+        return -1;
+    value = atoi(eq + 1);
+    if(strncmp(arg, "traversal=", eq - arg + 1) == 0)
+        traversal_order = value;
+    else if(strncmp(arg, "placement=", eq - arg + 1) == 0)
+        block_placement = value;
+    else if(strncmp(arg, "sum_layout=", eq - arg + 1) == 0)
+        sum_layout = value;
+    else if(strncmp(arg, "reduce_scatter=", eq - arg + 1) == 0)
+        reduce_scatter = value;
+    else if(strncmp(arg, "cost_model=", eq - arg + 1) == 0)
+        cost_modeling = value;
+    else if(strncmp(arg, "aggregation_time=", eq - arg + 1) == 0)
+        aggregation_time = value;
+    else if(strncmp(arg, "aggr_threads=", eq - arg + 1) == 0)
+        aggr_threads = value;
+    else if(strncmp(arg, "spin=", eq - arg + 1) == 0)
+        spin_wait = value;
+    else if(strncmp(arg, "reload=", eq - arg + 1) == 0)
+        reload_dataset = value;
+    else if(strncmp(arg, "verify=", eq - arg + 1) == 0)
+        verify_threads = value;
+    else
+        return -1;
+    return 0;
+}
+
+int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of n sorted values
+double percentile(const double *sorted, int n, int p)
+{
+    int rank = (n * p + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Quoted string, escape is '"' for CSV and '\\' for JSON
+void print_quoted(FILE *f, const char *s, char escape)
+{
+    fputc('"', f);
+    for(; *s; s++){
+        if(*s == '"' || *s == escape)
+            fputc(escape, f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Load the dataset in host memory with the CSD tasks of every block, and run the reference once
+long long ref_init(int __num_iter, bool chunked)
+{
+    long long chunk_edges[GRAPH_REF_MAX_CHUNKS];
+    long long host_time;
+
+    if(graph_ref_load(&ref, dataset_path, algorithm, verify_threads) < 0)
+        return -1;
+    for(int r = 0; r < num_partitions; r++){
+        for(int c = 0; c < num_partitions; c++){
+            int n = 0;
+            if(chunked){
+                for(int k = 0; k < num_edge_chunks[r][c] && n < GRAPH_REF_MAX_CHUNKS; k++)
+                    chunk_edges[n++] = edge_chunks[r][c][k].len / EDGE_SIZE;
+            }
+            else{
+                // The CSDs hold consecutive slices of the block, by CSD id
+                for(int csd_id = 0; csd_id < num_csds; csd_id++){
+                    if(edge_blocks_length[r][c][csd_id] > 0)
+                        chunk_edges[n++] = edge_blocks_length[r][c][csd_id] / EDGE_SIZE;
+                }
+            }
+            if(n == 0)
+                chunk_edges[n++] = 0;
+            if(graph_ref_set_chunks(&ref, r, c, n, chunk_edges) < 0)
+                return -1;
+        }
+    }
+    host_time = graph_ref_run(&ref, __num_iter);
+    if(host_time >= 0)
+        printf("Host-only reference: %lld ms with %d threads\n", host_time / 1000000, ref.threads);
+    return host_time;
+}
+
+int run_experiment(void* buffer, int __num_iter)
+{
+    const char *algorithm_names[3] = {"PR", "LP", "DP"};
+    static double runs[EXPERIMENT_METRICS][EXPERIMENT_MAX_REPS];
+    bool balanced = strcmp(experiment.mode, "balanced") == 0;
+    int n = 0, ret;
+    long long s, e, host_time = 0;
+    char path[256];
+    FILE *csv = NULL, *json;
+
+    if(experiment.repetitions > EXPERIMENT_MAX_REPS)
+        experiment.repetitions = EXPERIMENT_MAX_REPS;
+    if(experiment.output){
+        snprintf(path, sizeof(path), "%s.csv", experiment.output);
+        if(!(csv = fopen(path, "a"))){
+            perror(path);
+            return -1;
+        }
+        // Header for a new file
+        fseek(csv, 0, SEEK_END);
+        if(ftell(csv) == 0){
+            fprintf(csv, "label,dataset,num_csds,algorithm,mode,prefetch,row_overlap,traversal,placement,sum_layout,reduce_scatter,iters,rep");
+            for(int k = 0; k < EXPERIMENT_METRICS; k++)
+                fprintf(csv, ",%s", experiment_metrics[k]);
+            fprintf(csv, "\n");
+        }
+    }
+
+    for(int rep = -experiment.warmup; rep < experiment.repetitions; rep++){
+        double m[EXPERIMENT_METRICS] = {0};
+
+        total_aggr_time = 0;
+        if((balanced ? init_csds_data_chunked(fd, buffer) : init_csds_data(fd, buffer)) == -1){
+            printf("Init CSD edge data failed\n");
+            return -1;
+        }
+        s = get_time_ns();
+        if(strcmp(experiment.mode, "normal") == 0)
+            ret = csd_proc_edge_loop_normal(buffer, __num_iter);
+        else if(strcmp(experiment.mode, "grafu") == 0)
+            ret = csd_proc_edge_loop_grafu(buffer, __num_iter);
+        else if(balanced)
+            ret = csd_proc_edge_loop_balanced(buffer, __num_iter);
+        else if(strcmp(experiment.mode, "planned") == 0)
+            ret = csd_proc_edge_loop_planned(buffer, __num_iter, experiment.prefetching, experiment.row_overlap);
+        else
+            ret = csd_proc_edge_loop_dual_queue(buffer, __num_iter, experiment.prefetching, experiment.row_overlap);
+        e = get_time_ns();
+        if(ret < 0){
+            printf("Run %d failed\n", rep);
+            return -1;
+        }
+
+        // Kernel modules report milliseconds
+        m[0] = (double)(e - s) / 1000000;
+        for(int csd_id = 0; csd_id < num_csds; csd_id++){
+            m[1] += hmb_stat(&hmb_dev, csd_id, 1);
+            m[2] += hmb_stat(&hmb_dev, csd_id, 2);
+            m[3] += hmb_stat(&hmb_dev, csd_id, 3);
+            m[5] += hmb_stat(&hmb_dev, csd_id, 0);
+        }
+        m[1] /= num_csds, m[2] /= num_csds, m[3] /= num_csds, m[5] /= num_csds;
+        m[4] = (double)total_aggr_time / 1000000;
+        printf("%s run %d%s: %.1f ms\n", experiment.mode, rep, rep < 0 ? " (warmup)" : "", m[0]);
+
+        // Correctness and speedup against the host alone, the block slices are known after the first load
+        if(verify_threads > 0){
+            if(host_time == 0 && (host_time = ref_init(__num_iter, balanced)) < 0){
+                graph_ref_free(&ref);
+                return -1;
+            }
+            m[6] = (double)host_time / 1000000;
+            m[7] = graph_ref_compare(&ref, hmb_value_buf(&hmb_dev, HMB_ROLE_CURR));
+            printf("%s: %g, speedup over the host: %.2fx\n", algorithm == 0 ? "L1 error" : "Mismatching vertices",
+                m[7], m[6] / m[0]);
+        }
+        if(rep < 0)
+            continue;
+
+        for(int k = 0; k < EXPERIMENT_METRICS; k++)
+            runs[k][n] = m[k];
+        n++;
+        if(csv){
+            print_quoted(csv, experiment.label, '"');
+            fprintf(csv, ",%s,%d,%s,%s,%d,%d,%d,%d,%d,%d,%d,%d", dataset_path, num_csds, algorithm_names[algorithm],
+                experiment.mode, experiment.prefetching, experiment.row_overlap, traversal_order, block_placement,
+                sum_layout, reduce_scatter, __num_iter, rep);
+            for(int k = 0; k < EXPERIMENT_METRICS; k++)
+                fprintf(csv, ",%f", m[k]);
+            fprintf(csv, "\n");
+            fflush(csv);
+        }
+    }
+    if(csv)
+        fclose(csv);
+    graph_ref_free(&ref);
+    if(n == 0)
+        return 0;
+
+    for(int k = 0; k < EXPERIMENT_METRICS; k++){
+        double sum = 0;
+        for(int i = 0; i < n; i++)
+            sum += runs[k][i];
+        qsort(runs[k], n, sizeof(double), cmp_double);
+        printf("%-16s mean %.3f, p50 %.3f, p99 %.3f\n", experiment_metrics[k], sum / n, percentile(runs[k], n, 50),
+            percentile(runs[k], n, 99));
+    }
+    if(!experiment.output)
+        return 0;
+
+    // One JSON object per line and configuration
+    snprintf(path, sizeof(path), "%s.json", experiment.output);
+    if(!(json = fopen(path, "a"))){
+        perror(path);
+        return -1;
+    }
+    fprintf(json, "{\"label\": ");
+    print_quoted(json, experiment.label, '\\');
+    fprintf(json, ", \"dataset\": \"%s\", \"num_csds\": %d, \"algorithm\": \"%s\", \"mode\": \"%s\", \"prefetch\": %d, "
+        "\"row_overlap\": %d, \"traversal\": %d, \"placement\": %d, \"sum_layout\": %d, \"reduce_scatter\": %d, "
+        "\"iters\": %d, \"runs\": %d, \"warmup\": %d", dataset_path, num_csds, algorithm_names[algorithm], experiment.mode,
+        experiment.prefetching, experiment.row_overlap, traversal_order, block_placement, sum_layout, reduce_scatter,
+        __num_iter, n, experiment.warmup);
+    for(int k = 0; k < EXPERIMENT_METRICS; k++){
+        double sum = 0;
+        for(int i = 0; i < n; i++)
+            sum += runs[k][i];
+        fprintf(json, ", \"%s\": {\"mean\": %f, \"p50\": %f, \"p99\": %f}", experiment_metrics[k], sum / n,
+            percentile(runs[k], n, 50), percentile(runs[k], n, 99));
+    }
+    fprintf(json, "}\n");
+    fclose(json);
+    return 0;
+}
+
 int main(int argc, char* argv[]) 
 {
+    int opt, ret = 0;
+
+    // Experiment options, any position: the positional arguments are unchanged
+    while((opt = getopt(argc, argv, "m:f:r:s:n:w:o:l:")) != -1){
+        switch(opt){
+        case 'm': experiment.mode = optarg; break;
+        case 'f': experiment.prefetching = atoi(optarg); break;
+        case 'r': experiment.row_overlap = atoi(optarg); break;
+        case 's':
+            if(set_knob(optarg) < 0){
+                fprintf(stderr, "Unknown knob %s\n", optarg);
+                exit(-1);
+            }
+            break;
+        case 'n': experiment.repetitions = atoi(optarg); break;
+        case 'w': experiment.warmup = atoi(optarg); break;
+        case 'o': experiment.output = optarg; break;
+        case 'l': experiment.label = optarg; break;
+        default: argc = 0; break;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
     if (argc<5) {
-		fprintf(stderr, "usage: ./init_csd_edge [dataset_path] [num_csds] [algorithm] [num_iters] [aggregation_time: optional]\n");
+		fprintf(stderr, "usage: ./init_csd_edge [dataset_path] [num_csds] [algorithm] [num_iters] [aggregation_time: optional] [aggregation_threads: optional] [spin: optional] [reload: optional]\n"
+            "       [-m normal|grafu|balanced|dq|planned] [-f prefetching] [-r row_overlap] [-s knob=value]\n"
+            "       [-n repetitions] [-w warmup runs] [-o output prefix] [-l label]\n");
 		exit(-1);
 	}
     strcpy(dataset_path, argv[1]);
@@ -1095,6 +2272,12 @@ int main(int argc, char* argv[])
     int __num_iter = atoi(argv[4]);
     if(argc >= 6)
         aggregation_time = atoi(argv[5]);
+    if(argc >= 7)
+        aggr_threads = atoi(argv[6]);
+    if(argc >= 8)
+        spin_wait = atoi(argv[7]);
+    if(argc >= 9)
+        reload_dataset = atoi(argv[8]);
 
 
     // Initialize graph dataset metadata
@@ -1116,6 +2299,11 @@ int main(int argc, char* argv[])
         if (fd[csd_id] < 0) {
             return -1;
         }
+        csd_nsid[csd_id] = ioctl(fd[csd_id], NVME_IOCTL_ID);
+        if (csd_nsid[csd_id] < 0) {
+            perror("Failed to get the namespace id");
+            return -1;
+        }
     }
 
     /* Initialize HMB */
@@ -1123,12 +2311,29 @@ int main(int argc, char* argv[])
         fprintf(stderr, "Failed to initialize HMB\n");
         return 1;
     }
-    printf("HMB initialized successfully\n");
+    if (hmb_check_layout(&hmb_dev, num_vertices, num_csds, num_partitions) < 0) {
+        hmb_cleanup(&hmb_dev);
+        return 1;
+    }
+    if(spin_wait)
+        hmb_dev.wait_mode = HMB_WAIT_SPIN;
+    printf("HMB initialized successfully, %s waits\n", spin_wait ? "spinning" : "adaptive");
 
     printf("num iter: %d, num csds: %d, num vertices: %lld\n", __num_iter, num_csds, num_vertices);
 
+    printf("Aggregation threads: %d\n", aggr_pool_init(aggr_threads));
+
     total_aggr_time = 0;
-    run_normal_grafu_dq(buffer, __num_iter);
+    if(experiment.mode)
+        ret = run_experiment(buffer, __num_iter);
+    else
+        run_normal_grafu_dq(buffer, __num_iter);
+    // run_dq_plan(buffer, __num_iter);
+    // run_balanced(buffer, __num_iter);
+    // run_sum_layout(buffer, __num_iter);
+    // run_reduce_scatter(buffer, __num_iter);
+    // run_block_placement(buffer, __num_iter);
+    // run_traversal(buffer, __num_iter);
     // run_dq_cache_hitrate(buffer, __num_iter);
     // run_dq_composition(buffer, __num_iter, 2);
     // run_dq_hmb_size(buffer, __num_iter);
@@ -1136,8 +2341,10 @@ int main(int argc, char* argv[])
     // run_dq_row_overlap(buffer, __num_iter);
     // run_dq_prefetch_priorities(buffer, __num_iter);
     // run_all_composition(buffer, __num_iter);
-    
+
+    print_aggr_column_time();
+    aggr_pool_destroy();
     cleanup(buffer);
     
-    return 0;
+    return ret < 0 ? 1 : 0;
 }
\ No newline at end of file